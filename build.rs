@@ -3,6 +3,7 @@ use std::path::PathBuf;
 
 fn main() {
     println!("cargo:rerun-if-changed=src/sys");
+    println!("cargo:rerun-if-changed=src/diarization");
     println!("cargo:rerun-if-changed=cpp");
     println!("cargo:rerun-if-changed=build.rs");
 
@@ -21,26 +22,63 @@ fn main() {
     println!("cargo:rustc-link-lib=c10_cuda");
     println!("cargo:rustc-link-lib=c10");
     
-    cxx_build::bridges([
+    // self-checks driven by the Rust tests; only test binaries reference
+    // anything in this archive, so the linker leaves it out of the others.
+    // It goes first so that its references into the library resolve.
+    let mut tests = cxx_build::bridge("src/sys/testing.rs");
+    tests
+        .file("src/sys/testing/input.cpp")
+        .file("src/sys/testing/logits.cpp")
+        .file("src/sys/testing/mel.cpp")
+        .file("src/sys/testing/mock.cpp")
+        .file("src/sys/testing/registry.cpp")
+        .file("src/sys/testing/ring.cpp")
+        .file("src/sys/testing/staging.cpp")
+        .file("src/sys/testing/timestamps.cpp")
+        .file("src/sys/testing/vad.cpp");
+
+    let mut lib = cxx_build::bridges([
         "src/sys/features.rs",
         "src/sys/mel.rs",
+        "src/sys/buffer.rs",
+        "src/sys/input.rs",
         "src/sys/whisper.rs",
-    ])
-    .file("cpp/cnpy/cnpy.cpp")
-    .file("src/sys/mel.cpp")
-    .file("src/sys/whisper.cpp")
-    .include("cpp/cnpy")
-    .include("/home/coder/whisper-trtllm-rs/cpp/TensorRT-LLM/cpp/include")
-    .include("/home/coder/whisper-trtllm-rs/cpp/TensorRT-LLM/cpp")    
-    .include("/usr/local/lib/python3.12/dist-packages/torch/include")
-    .include("/usr/local/lib/python3.12/dist-packages/torch/include/torch/csrc/api/include")
-    .include("/usr/local/tensorrt/include")
-    //.cpp(true)
-    .std("c++20")
-    .cuda(true)
-    //.static_flag(true)
-    //.static_crt(cfg!(target_os = "windows"))
-    .flag_if_supported("/EHsc")
-    .flag("-w")
-    .compile("whisper-trtllm");
+        "src/diarization/sys/kaldifeat.rs",
+    ]);
+    lib
+        .file("cpp/cnpy/cnpy.cpp")
+        .file("src/sys/filterbank.cpp")
+        .file("src/sys/staging.cpp")
+        .file("src/sys/mel.cpp")
+        .file("src/sys/stream.cpp")
+        .file("src/sys/tier.cpp")
+        .file("src/sys/vad.cpp")
+        .file("src/sys/ring.cpp")
+        .file("src/sys/slab.cpp")
+        .file("src/sys/buffer.cpp")
+        .file("src/sys/resample.cpp")
+        .file("src/sys/input.cpp")
+        .file("src/sys/logits.cpp")
+        .file("src/sys/timestamps.cpp")
+        .file("src/sys/whisper.cpp")
+        .file("src/diarization/sys/kaldifeat.cpp");
+
+    for build in [&mut tests, &mut lib] {
+        build
+            .include("cpp/cnpy")
+            .include("/home/coder/whisper-trtllm-rs/cpp/TensorRT-LLM/cpp/include")
+            .include("/home/coder/whisper-trtllm-rs/cpp/TensorRT-LLM/cpp")    
+            .include("/usr/local/lib/python3.12/dist-packages/torch/include")
+            .include("/usr/local/lib/python3.12/dist-packages/torch/include/torch/csrc/api/include")
+            .include("/usr/local/tensorrt/include")
+            //.cpp(true)
+            .std("c++20")
+            .cuda(true)
+            //.static_flag(true)
+            //.static_crt(cfg!(target_os = "windows"))
+            .flag_if_supported("/EHsc")
+            .flag("-w");
+    }
+    tests.compile("whisper-trtllm-testing");
+    lib.compile("whisper-trtllm");
 }
\ No newline at end of file
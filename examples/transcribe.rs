@@ -1,6 +1,6 @@
 use std::path::Path;
 use anyhow::{anyhow, Result};
-use whisper_trtllm_rs::{Whisper, Config};
+use whisper_trtllm_rs::{Whisper, Config, Resampler};
 use tokio::fs::File;
 use tokio::io::{self, AsyncReadExt, AsyncSeekExt, SeekFrom, BufReader};
 use futures::{Stream, StreamExt};
@@ -19,13 +19,13 @@ async fn main() -> Result<()> {
     
     whisper.log_mel();
     /*
-    let audio_stream = wav_to_stream("/home/coder/whisper-trtllm-rs/audio/fr.wav", CHUNK_SIZE).await?;
+    let (audio_stream, _) = wav_to_stream("/home/coder/whisper-trtllm-rs/audio/fr.wav", CHUNK_SIZE).await?;
     let start = std::time::Instant::now();
     //let (lang, segments) = whisper.transcribe(audio_stream, None).await?;
     //println!("Transcription took: {:?}", start.elapsed());
     //println!("Result: {:?}", result);
 
-    let audio_stream = wav_to_stream("/home/coder/whisper-trtllm-rs/audio/oppo-en-us.wav", CHUNK_SIZE).await?;
+    let (audio_stream, _) = wav_to_stream("/home/coder/whisper-trtllm-rs/audio/oppo-en-us.wav", CHUNK_SIZE).await?;
     let start = std::time::Instant::now();
     let mut stream = Box::pin(whisper.transcribe(audio_stream, Some("<|0.00|>Hi,<|0.36|>")));
     while let Some(segment) = stream.next().await {
@@ -36,6 +36,16 @@ async fn main() -> Result<()> {
     }
     println!("Transcription took: {:?}", start.elapsed());
     //println!("Lang: {:?}, Segments: {:?}", lang, segments.collect::<Vec<Segment>>());
+
+    // 立体声通话录音：两个声道作为同一个任务转写
+    let (audio_stream, channels) = wav_to_stream("/home/coder/whisper-trtllm-rs/audio/call-stereo.wav", CHUNK_SIZE).await?;
+    let mut stream = Box::pin(whisper.transcribe_channels(audio_stream, channels));
+    while let Some(segment) = stream.next().await {
+        match segment {
+            Ok((channel, lang, segment)) => println!("Channel: {}, Language: {:?}, {:?}", channel, lang, segment),
+            Err(e) => eprintln!("Error: {:?}", e),
+        }
+    }
     */
 
     Ok(())
@@ -75,19 +85,18 @@ impl Stream for WavStream {
     }
 }
 
-// 从WAV文件加载音频并创建流
-async fn wav_to_stream<P: AsRef<Path>>(path: P, chunk_size: usize) -> Result<impl Stream<Item = Vec<f32>>> {
+// 从WAV文件加载音频并创建流，多声道时样本保持交错，同时返回声道数
+async fn wav_to_stream<P: AsRef<Path>>(path: P, chunk_size: usize) -> Result<(impl Stream<Item = Vec<f32>>, usize)> {
     // 使用hound读取WAV文件
     let reader = WavReader::open(path.as_ref())?;
     let spec = reader.spec();
-    
-    // 检查采样率和通道数
-    if spec.channels != 1 {
-        return Err(anyhow!("Only mono WAV files are supported"));
+    let channels = spec.channels as usize;
+    if channels == 0 {
+        return Err(anyhow!("WAV file has no channels"));
     }
     
     // 将样本转换为f32
-    let samples: Vec<f32> = match spec.sample_format {
+    let mut samples: Vec<f32> = match spec.sample_format {
         SampleFormat::Float => reader.into_samples::<f32>().collect::<Result<Vec<f32>, _>>()?,
         SampleFormat::Int => {
             match spec.bits_per_sample {
@@ -105,12 +114,20 @@ async fn wav_to_stream<P: AsRef<Path>>(path: P, chunk_size: usize) -> Result<imp
         },
     };
     
-    // 如果采样率不是16kHz，需要进行重采样(简化起见，这里省略了重采样逻辑)
+    // 如果采样率不是16kHz，按声道分别重采样到16kHz，再交错回去
     if spec.sample_rate != 16000 {
-        println!("Warning: Sample rate is {}Hz, not 16kHz. Resampling needed.", spec.sample_rate);
-        // 这里应该添加重采样逻辑
+        let mut resampled = Vec::with_capacity(channels);
+        for channel in 0..channels {
+            let channel_samples: Vec<f32> = samples.iter().skip(channel).step_by(channels).copied().collect();
+            let mut resampler = Resampler::new(spec.sample_rate as usize, 16000)?;
+            let mut output = resampler.process(&channel_samples)?;
+            output.extend(resampler.flush()?);
+            resampled.push(output);
+        }
+        let len = resampled.iter().map(|s| s.len()).min().unwrap_or(0);
+        samples = (0..len).flat_map(|i| resampled.iter().map(move |s| s[i])).collect();
     }
     
-    // 创建音频流
-    Ok(WavStream::new(samples, chunk_size))
+    // 创建音频流，每块包含所有声道的chunk_size个采样
+    Ok((WavStream::new(samples, chunk_size * channels), channels))
 }
\ No newline at end of file
@@ -1,25 +1,143 @@
 use tokio::io::{AsyncRead, AsyncReadExt};
 use anyhow::{anyhow, Result};
-use std::{collections::VecDeque, f32::MIN};
-use futures::stream::Stream;
+
+/// Sample layout of the raw PCM read by `Audio`, little endian.
+#[derive(Copy, Clone, Debug, PartialEq, Eq)]
+pub(crate) enum PcmFormat {
+    S16,
+    F32,
+}
+
+impl PcmFormat {
+    fn bytes_per_sample(self) -> usize {
+        match self {
+            PcmFormat::S16 => 2,
+            PcmFormat::F32 => 4,
+        }
+    }
+
+    // Converts whole samples of `bytes` into `out`; both hold the same count.
+    // Fixed-size chunks keep the loops branch-free so they vectorize.
+    fn convert(self, bytes: &[u8], out: &mut [f32]) {
+        match self {
+            PcmFormat::S16 => {
+                for (dst, src) in out.iter_mut().zip(bytes.chunks_exact(2)) {
+                    *dst = i16::from_le_bytes([src[0], src[1]]) as f32 * (1.0 / 32768.0);
+                }
+            }
+            PcmFormat::F32 => {
+                for (dst, src) in out.iter_mut().zip(bytes.chunks_exact(4)) {
+                    *dst = f32::from_le_bytes([src[0], src[1], src[2], src[3]]);
+                }
+            }
+        }
+    }
+}
+
+/// Contiguous ring of samples for a single owner, not shared between
+/// threads: it is filled in place (`write_slices` + `commit`) and drained
+/// (`as_slices` + `consume`) through `&mut self`. Readers get the buffered
+/// samples as two slices, the (first, second) spans
+/// `LogMelSpectrogram::extract` takes, so nothing is copied to linearize them.
+pub(crate) struct SampleRing {
+    data: Vec<f32>,
+    head: usize,
+    len: usize,
+}
+
+impl SampleRing {
+    pub fn with_capacity(capacity: usize) -> Self {
+        Self {
+            data: vec![0.0; capacity.max(1)],
+            head: 0,
+            len: 0,
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.data.len()
+    }
+
+    /// The first `n` buffered samples (all of them if fewer).
+    pub fn as_slices(&self, n: usize) -> (&[f32], &[f32]) {
+        let n = n.min(self.len);
+        let first = n.min(self.capacity() - self.head);
+        (&self.data[self.head..self.head + first], &self.data[..n - first])
+    }
+
+    /// Free space for `n` more samples after the buffered ones, growing the
+    /// storage if needed. Nothing is buffered until `commit`.
+    pub fn write_slices(&mut self, n: usize) -> (&mut [f32], &mut [f32]) {
+        if self.len + n > self.capacity() {
+            self.grow((self.capacity() * 2).max(self.len + n));
+        }
+        let capacity = self.capacity();
+        let tail = (self.head + self.len) % capacity;
+        let first = n.min(capacity - tail);
+        let (front, back) = self.data.split_at_mut(tail);
+        (&mut back[..first], &mut front[..n - first])
+    }
+
+    pub fn commit(&mut self, n: usize) {
+        self.len = (self.len + n).min(self.capacity());
+    }
+
+    pub fn consume(&mut self, n: usize) {
+        let n = n.min(self.len);
+        self.head = (self.head + n) % self.capacity();
+        self.len -= n;
+        if self.len == 0 {
+            self.head = 0;
+        }
+    }
+
+    fn grow(&mut self, capacity: usize) {
+        let mut data = vec![0.0; capacity];
+        let (first, second) = self.as_slices(self.len);
+        data[..first.len()].copy_from_slice(first);
+        data[first.len()..self.len].copy_from_slice(second);
+        self.data = data;
+        self.head = 0;
+    }
+}
 
 pub(crate) struct Audio<R> {
     reader: R,
+    format: PcmFormat,
     eof: bool,
-    buffer: VecDeque<f32>,
+    buffer: SampleRing,
+    // raw bytes read but not converted yet, at most one partial sample
+    pending: Vec<u8>,
+    pending_len: usize,
     offset: usize,
     samples_per_millis: usize,
 }
 
 impl<R: AsyncRead + Unpin> Audio<R> {
     const CHUNK_SIZE: usize = 30 * 16000;
-    
+    const BLOCK_BYTES: usize = 64 * 1024;
+
     pub fn new(reader: R, sample_rate: usize) -> Self {
+        Self::with_format(reader, PcmFormat::S16, sample_rate)
+    }
+
+    pub fn with_format(reader: R, format: PcmFormat, sample_rate: usize) -> Self {
         Self {
             reader,
+            format,
             samples_per_millis: sample_rate / 1000,
             eof: false,
-            buffer: VecDeque::with_capacity(Self::CHUNK_SIZE * 2),
+            buffer: SampleRing::with_capacity(Self::CHUNK_SIZE * 2),
+            pending: vec![0; Self::BLOCK_BYTES],
+            pending_len: 0,
             offset: 0,
         }
     }
@@ -32,45 +150,48 @@ impl<R: AsyncRead + Unpin> Audio<R> {
         self.offset + self.buffer.len() / self.samples_per_millis
     }
 
-    pub async fn samples(&self, n: usize) -> Result<(&[f32], &[f32])> {
-        loop {
-            if self.buffer.len() >= n {
-                let (first, second) = self.buffer.as_slices();
-                if first.len() >= n {
-                    return Ok((&first[..n], &second[..0]));
-                } else {
-                    let second_len = n - first.len();
-                    return Ok((first, &second[..second_len]));
-                }
-            }
-
-            if self.eof {
-                return Ok((self.buffer.as_slices().0, self.buffer.as_slices().1)); // Return whatever is left in the buffer
-            }
-
-            // If we don't have enough samples, fill the buffer
-        }
+    /// The next `n` samples as two slices, fewer only at the end of the input.
+    pub async fn samples(&mut self, n: usize) -> Result<(&[f32], &[f32])> {
+        self.fill_until(n).await
     }
 
     async fn fill_until(&mut self, n: usize) -> Result<(&[f32], &[f32])> {
         while !self.eof && self.buffer.len() < n {
-            match self.reader.read_i16_le().await {
-                Ok(sample) => self.buffer.push_back(sample as f32 / i16::MAX as f32),
-                Err(e) => {
-                    if e.kind() != std::io::ErrorKind::UnexpectedEof {
-                        return Err(anyhow!(e));
-                    }
-                    self.eof = true;
-                    break;
-                }
-            }
+            self.read_block().await?;
+        }
+        Ok(self.buffer.as_slices(n))
+    }
+
+    // One read of up to BLOCK_BYTES, converted in bulk into the ring.
+    async fn read_block(&mut self) -> Result<()> {
+        let read = self.reader.read(&mut self.pending[self.pending_len..]).await
+            .map_err(|e| anyhow!("failed to read audio: {}", e))?;
+        if read == 0 {
+            // a trailing partial sample is dropped
+            self.eof = true;
+            self.pending_len = 0;
+            return Ok(());
         }
-        let (first, second) = self.buffer.as_slices();
-        Ok((&[f32], &[f32]))
+        self.pending_len += read;
+
+        let width = self.format.bytes_per_sample();
+        let n = self.pending_len / width;
+        let bytes = &self.pending[..n * width];
+
+        let (first, second) = self.buffer.write_slices(n);
+        let split = first.len() * width;
+        self.format.convert(&bytes[..split], first);
+        self.format.convert(&bytes[split..], second);
+        self.buffer.commit(n);
+
+        self.pending.copy_within(n * width..self.pending_len, 0);
+        self.pending_len -= n * width;
+        Ok(())
     }
 
     pub fn consume(&mut self, n: usize) {
-        self.buffer.drain(..n);
+        let n = n.min(self.buffer.len());
+        self.buffer.consume(n);
         self.offset += n;
     }
 
@@ -81,56 +202,112 @@ impl<R: AsyncRead + Unpin> Audio<R> {
     pub fn eof(&self) -> bool {
         self.eof
     }
+}
 
-    /*
-    pub fn chunk(&self) -> (&[f32], &[f32]) {
-        let (first, second) = self.buffer.as_slices();
-        let total_len = self.buffer.len().min(Self::CHUNK_SIZE);
-        
-        if first.len() >= total_len {
-            // If first slice has enough elements, return first slice and empty second slice
-            (&first[..total_len], &[])
-        } else {
-            // If we need elements from both slices
-            let second_len = total_len - first.len();
-            (first, &second[..second_len])
+#[cfg(test)]
+mod tests {
+    use super::{Audio, PcmFormat, SampleRing};
+    use std::pin::Pin;
+    use std::task::{Context, Poll};
+    use std::time::Instant;
+    use tokio::io::{AsyncRead, AsyncReadExt, ReadBuf};
+
+    // Hands out at most `step` bytes per read, to split samples across reads.
+    struct Trickle {
+        data: Vec<u8>,
+        position: usize,
+        step: usize,
+    }
+
+    impl AsyncRead for Trickle {
+        fn poll_read(mut self: Pin<&mut Self>, _cx: &mut Context<'_>, buf: &mut ReadBuf<'_>) -> Poll<std::io::Result<()>> {
+            let n = self.step.min(buf.remaining()).min(self.data.len() - self.position);
+            let start = self.position;
+            buf.put_slice(&self.data[start..start + n]);
+            self.position += n;
+            Poll::Ready(Ok(()))
         }
     }
 
-    pub fn chunk_end(&self) -> usize {
-        self.offset + self.chunk_duration()
+    fn pcm(n: usize) -> (Vec<u8>, Vec<f32>) {
+        let samples: Vec<i16> = (0..n).map(|i| ((i * 7919) % 65536) as u16 as i16).collect();
+        let bytes = samples.iter().flat_map(|s| s.to_le_bytes()).collect();
+        let floats = samples.iter().map(|&s| s as f32 / 32768.0).collect();
+        (bytes, floats)
     }
 
-    pub async fn fill_chunk(&mut self) -> Result<(&[f32], &[f32])> {
-        while self.buffer.len() < Self::CHUNK_SIZE && !self.is_end {
-            match self.reader.read_i16_le().await {
-                Ok(sample) => self.buffer.push_back(sample as f32 / i16::MAX as f32),
-                Err(e) => {
-                    if e.kind() != std::io::ErrorKind::UnexpectedEof {
-                        return Err(anyhow!(e));
-                    }
-                    self.is_end = true;
-                    break;
-                }
+    #[test]
+    fn test_ring_wraps_and_grows() {
+        let mut ring = SampleRing::with_capacity(8);
+        let mut next = 0.0;
+        let mut expected = std::collections::VecDeque::new();
+        for step in 0..200 {
+            let n = (step * 5) % 11;
+            let (first, second) = ring.write_slices(n);
+            for x in first.iter_mut().chain(second.iter_mut()) {
+                *x = next;
+                expected.push_back(next);
+                next += 1.0;
             }
+            ring.commit(n);
+            ring.consume(step % 7);
+            expected.drain(..(step % 7).min(expected.len()));
+
+            let (a, b) = ring.as_slices(usize::MAX);
+            let got: Vec<f32> = a.iter().chain(b.iter()).copied().collect();
+            assert_eq!(got, expected.iter().copied().collect::<Vec<_>>());
         }
-        Ok(self.chunk())
-    }
-
-    pub async fn fill(&mut self) -> Result<()> {
-        while self.buffer.len() < Self::CHUNK_SIZE * 2 && !self.is_end {
-            match self.reader.read_i16_le().await {
-                Ok(sample) => self.buffer.push_back(sample as f32 / i16::MAX as f32),
-                Err(e) => {
-                    if e.kind() != std::io::ErrorKind::UnexpectedEof {
-                        return Err(anyhow!(e));
-                    }
-                    self.is_end = true;
+    }
+
+    #[tokio::test]
+    async fn test_fill_until_across_partial_reads() {
+        let (bytes, floats) = pcm(10_001);
+        for step in [1, 3, 4_097] {
+            let mut audio = Audio::new(Trickle { data: bytes.clone(), position: 0, step }, 16000);
+            let mut got = Vec::new();
+            loop {
+                let (first, second) = audio.samples(1_234).await.unwrap();
+                let n = first.len() + second.len();
+                got.extend_from_slice(first);
+                got.extend_from_slice(second);
+                audio.consume(n);
+                if n < 1_234 {
                     break;
                 }
             }
+            assert!(audio.eof());
+            assert_eq!(got, floats, "step {step}");
         }
-        Ok(())
     }
-    */
-}
\ No newline at end of file
+
+    #[tokio::test]
+    #[ignore]
+    async fn bench_pcm_ingestion() {
+        let (bytes, _) = pcm(16000 * 600);
+        let n = bytes.len() / 2;
+
+        // the previous path: one await and one push per sample
+        let start = Instant::now();
+        let mut reader = &bytes[..];
+        let mut samples = std::collections::VecDeque::with_capacity(n);
+        while let Ok(sample) = reader.read_i16_le().await {
+            samples.push_back(sample as f32 / i16::MAX as f32);
+        }
+        let per_sample = n as f64 / start.elapsed().as_secs_f64();
+
+        let start = Instant::now();
+        let mut audio = Audio::with_format(&bytes[..], PcmFormat::S16, 16000);
+        loop {
+            let (first, second) = audio.samples(16000 * 30).await.unwrap();
+            let len = first.len() + second.len();
+            audio.consume(len);
+            if audio.eof() && len == 0 {
+                break;
+            }
+        }
+        let bulk = n as f64 / start.elapsed().as_secs_f64();
+
+        println!("per-sample reads: {:.1} M samples/s", per_sample / 1e6);
+        println!("bulk reads:       {:.1} M samples/s ({:.1}x)", bulk / 1e6, bulk / per_sample);
+    }
+}
@@ -0,0 +1,3 @@
+mod sys;
+
+pub use sys::Fbank;
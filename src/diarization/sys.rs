@@ -0,0 +1,3 @@
+mod kaldifeat;
+
+pub use kaldifeat::Fbank;
@@ -0,0 +1,252 @@
+#include "whisper-trtllm-rs/src/diarization/sys/kaldifeat.h"
+#include "whisper-trtllm-rs/src/sys/fft.h"
+#include "whisper-trtllm-rs/src/sys/simd.h"
+
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    // Kaldi floors energies at float epsilon before the log
+    constexpr float LOG_FLOOR = std::numeric_limits<float>::epsilon();
+
+    double mel_scale(const double hz) {
+        return 1127.0 * std::log(1.0 + hz / 700.0);
+    }
+
+    std::vector<float> povey_window(const size_t n) {
+        std::vector<float> window(n, 1.0f);
+        if (n < 2) {
+            return window;
+        }
+        const double step = 2.0 * M_PI / static_cast<double>(n - 1);
+        for (size_t i = 0; i < n; i++) {
+            window[i] = static_cast<float>(std::pow(0.5 - 0.5 * std::cos(step * static_cast<double>(i)), 0.85));
+        }
+        return window;
+    }
+
+    size_t round_up_to_power_of_two(const size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    // Kaldi's ExtractWindow reflects samples outside the signal back in.
+    int64_t reflect(int64_t i, const int64_t len) {
+        while (i < 0 || i >= len) {
+            i = i < 0 ? -i - 1 : 2 * len - 1 - i;
+        }
+        return i;
+    }
+
+    // Mel energies of one power spectrum into row.
+    void project(
+        const simd::Kernels& kernels,
+        const MelBands& bands,
+        const float* power,
+        float* row
+    ) {
+        for (size_t m = 0; m < bands.n_mels(); m++) {
+            row[m] = kernels.dot(
+                bands.weights.data() + bands.offset[m],
+                power + bands.begin[m],
+                bands.offset[m + 1] - bands.offset[m]
+            );
+        }
+    }
+
+    // Kaldi's banks for an n_fft point spectrum as a [n_mels, n_fft / 2 + 1]
+    // CPU tensor.
+    torch::Tensor mel_banks(const FbankOptions& options, const size_t n_fft) {
+        auto weights = kaldi_mel_banks(
+            options.n_mels, n_fft, options.sample_rate, options.low_freq, options.high_freq);
+        return torch::from_blob(
+            weights.data(),
+            {static_cast<int64_t>(options.n_mels), static_cast<int64_t>(n_fft / 2 + 1)},
+            torch::kFloat32
+        ).clone();
+    }
+
+    template <typename Transform>
+    void compute_fbank(
+        const Transform& transform,
+        const std::span<const float> samples,
+        const FbankOptions& options,
+        const size_t frame_length,
+        const size_t frame_shift,
+        const std::vector<float>& window,
+        const MelBands& bands,
+        const int64_t n_frames,
+        float* out
+    ) {
+        const size_t n_fft = transform.size();
+        const size_t n_freqs = n_fft / 2 + 1;
+        const size_t n_mels = bands.n_mels();
+        const int64_t len = static_cast<int64_t>(samples.size());
+        const auto& kernels = simd::kernels();
+
+        at::parallel_for(0, n_frames, 16, [&](int64_t begin, int64_t end) {
+            std::vector<float> frame(n_fft, 0.0f);
+            std::vector<float> re(n_freqs);
+            std::vector<float> im(n_freqs);
+            std::vector<float> power(n_freqs);
+
+            for (int64_t t = begin; t < end; t++) {
+                int64_t start = t * static_cast<int64_t>(frame_shift);
+                if (!options.snip_edges) {
+                    start += static_cast<int64_t>(frame_shift / 2) - static_cast<int64_t>(frame_length / 2);
+                }
+                for (size_t i = 0; i < frame_length; i++) {
+                    frame[i] = samples[reflect(start + static_cast<int64_t>(i), len)] * options.sample_scale;
+                }
+
+                if (options.remove_dc_offset) {
+                    double sum = 0.0;
+                    for (size_t i = 0; i < frame_length; i++) {
+                        sum += frame[i];
+                    }
+                    const float mean = static_cast<float>(sum / static_cast<double>(frame_length));
+                    for (size_t i = 0; i < frame_length; i++) {
+                        frame[i] -= mean;
+                    }
+                }
+                if (options.preemphasis != 0.0f) {
+                    for (size_t i = frame_length - 1; i > 0; i--) {
+                        frame[i] -= options.preemphasis * frame[i - 1];
+                    }
+                    frame[0] -= options.preemphasis * frame[0];
+                }
+                for (size_t i = 0; i < frame_length; i++) {
+                    frame[i] *= window[i];
+                }
+                // frame[frame_length, n_fft) stays zero
+
+                transform.forward(frame.data(), re.data(), im.data());
+                kernels.power(re.data(), im.data(), power.data(), n_freqs);
+
+                project(kernels, bands, power.data(), out + t * n_mels);
+            }
+        });
+    }
+}
+
+std::vector<float> kaldi_mel_banks(
+    const size_t n_mels,
+    const size_t n_fft,
+    const size_t sample_rate,
+    const float low_freq,
+    const float high_freq
+) {
+    const double nyquist = 0.5 * static_cast<double>(sample_rate);
+    const double high = high_freq > 0.0f ? high_freq : nyquist + high_freq;
+    if (n_mels == 0 || n_fft < 2 || low_freq < 0.0f || high <= low_freq || high > nyquist) {
+        throw std::invalid_argument("fbank needs n_mels > 0 and 0 <= low_freq < high_freq <= nyquist");
+    }
+
+    const size_t n_freqs = n_fft / 2 + 1;
+    const double bin_width = static_cast<double>(sample_rate) / static_cast<double>(n_fft);
+    const double mel_low = mel_scale(low_freq);
+    const double mel_delta = (mel_scale(high) - mel_low) / static_cast<double>(n_mels + 1);
+
+    std::vector<float> weights(n_mels * n_freqs, 0.0f);
+    for (size_t m = 0; m < n_mels; m++) {
+        const double left = mel_low + static_cast<double>(m) * mel_delta;
+        const double center = left + mel_delta;
+        const double right = center + mel_delta;
+        // the Nyquist bin is not part of any filter
+        for (size_t k = 0; k < n_fft / 2; k++) {
+            const double mel = mel_scale(bin_width * static_cast<double>(k));
+            if (mel > left && mel < right) {
+                const double weight = mel <= center ? (mel - left) / (center - left) : (right - mel) / (right - center);
+                weights[m * n_freqs + k] = static_cast<float>(weight);
+            }
+        }
+    }
+    return weights;
+}
+
+Fbank::Fbank(const FbankOptions& options) : options_(options) {
+    const double rate = static_cast<double>(options.sample_rate);
+    frame_length_ = static_cast<size_t>(rate * options.frame_length_ms / 1000.0);
+    frame_shift_ = static_cast<size_t>(rate * options.frame_shift_ms / 1000.0);
+    if (frame_length_ < 2 || frame_shift_ == 0) {
+        throw std::invalid_argument("fbank frames need at least 2 samples and a non-zero shift");
+    }
+    padded_length_ = options.round_to_power_of_two ? round_up_to_power_of_two(frame_length_) : frame_length_;
+    if (padded_length_ % 2 != 0) {
+        throw std::invalid_argument("fbank FFT length must be even");
+    }
+
+    window_ = povey_window(frame_length_);
+
+    bands_ = MelBands::banded(mel_banks(options, padded_length_));
+    spectrum_banks_ = mel_banks(options, options.spectrum_fft);
+    spectrum_bands_ = MelBands::banded(spectrum_banks_);
+}
+
+size_t Fbank::n_frames(const size_t n_samples) const {
+    if (!options_.snip_edges) {
+        return (n_samples + frame_shift_ / 2) / frame_shift_;
+    }
+    return n_samples < frame_length_ ? 0 : 1 + (n_samples - frame_length_) / frame_shift_;
+}
+
+torch::Tensor Fbank::compute(const std::span<const float> samples) const {
+    const int64_t frames = static_cast<int64_t>(n_frames(samples.size()));
+    torch::Tensor mel = torch::empty(
+        {frames, static_cast<int64_t>(options_.n_mels)},
+        torch::TensorOptions().dtype(torch::kFloat32)
+    );
+    if (frames == 0) {
+        return mel;
+    }
+
+    auto out = mel.data_ptr<float>();
+    if (padded_length_ == 512) {
+        compute_fbank(RealFFT<512>::instance(), samples, options_, frame_length_, frame_shift_, window_, bands_, frames, out);
+    } else {
+        compute_fbank(DynamicRealFFT(padded_length_), samples, options_, frame_length_, frame_shift_, window_, bands_, frames, out);
+    }
+    return finish(mel);
+}
+
+torch::Tensor Fbank::from_power_spectrum(const torch::Tensor& power) const {
+    const int64_t n_freqs = spectrum_banks_.size(1);
+    if (power.dim() != 2 || power.size(1) != n_freqs) {
+        throw std::invalid_argument("power spectrum must be [n_frames, spectrum_fft / 2 + 1]");
+    }
+
+    // scaled like Kaldi's integer samples, which matters only at the floor
+    const double scale = static_cast<double>(options_.sample_scale) * options_.sample_scale;
+    if (!power.device().is_cpu()) {
+        auto banks = spectrum_banks_.to(power.device());
+        return finish(torch::matmul(power.to(torch::kFloat32), banks.t()).mul_(scale));
+    }
+
+    auto input = power.to(torch::kFloat32).contiguous();
+    const int64_t frames = input.size(0);
+    const size_t n_mels = options_.n_mels;
+    auto mel = torch::empty({frames, static_cast<int64_t>(n_mels)}, input.options());
+    const auto& kernels = simd::kernels();
+    const float* data = input.data_ptr<float>();
+    float* out = mel.data_ptr<float>();
+    at::parallel_for(0, frames, 64, [&](int64_t begin, int64_t end) {
+        for (int64_t t = begin; t < end; t++) {
+            project(kernels, spectrum_bands_, data + t * n_freqs, out + t * n_mels);
+        }
+    });
+    return finish(mel.mul_(scale));
+}
+
+torch::Tensor Fbank::finish(torch::Tensor mel) const {
+    mel.clamp_min_(LOG_FLOOR).log_();
+    if (options_.cmn && mel.size(0) > 0) {
+        mel.sub_(mel.mean(0, true));
+    }
+    return mel;
+}
@@ -1,28 +1,127 @@
-#include "kaldifeat/csrc/feature-fbank.h"
+#pragma once
 
+#include "whisper-trtllm-rs/src/sys/features.h"
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+#include "whisper-trtllm-rs/src/sys/mel.h"
+
+#include "rust/cxx.h"
+
+#include <torch/torch.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Options of Kaldi's compute-fbank-feats, with the defaults speaker
+// embedding models are trained on. Dithering is left out so features are
+// deterministic.
+struct FbankOptions {
+    size_t sample_rate = SAMPLE_RATE;
+    float frame_length_ms = 25.0f;
+    float frame_shift_ms = 10.0f;
+    size_t n_mels = 80;
+    float low_freq = 20.0f;
+    // values <= 0 are an offset from the Nyquist frequency
+    float high_freq = 0.0f;
+    float preemphasis = 0.97f;
+    bool remove_dc_offset = true;
+    bool snip_edges = true;
+    bool round_to_power_of_two = true;
+    // Kaldi reads 16-bit samples as integers, samples in [-1, 1] are scaled
+    float sample_scale = 32768.0f;
+    // subtract the mean of every bin over the utterance
+    bool cmn = true;
+    // FFT size of the power spectra from_power_spectrum() takes, Whisper's
+    size_t spectrum_fft = N_FFT;
+};
+
+// HTK mel filterbank as Kaldi's MelBanks builds it for an n_fft point
+// spectrum: triangles on the 1127 ln(1 + f / 700) scale, unit peak, the
+// Nyquist bin left out. Row-major [n_mels, n_fft / 2 + 1].
+std::vector<float> kaldi_mel_banks(
+    const size_t n_mels,
+    const size_t n_fft,
+    const size_t sample_rate,
+    const float low_freq,
+    const float high_freq
+);
+
+// Kaldi-compatible log mel filterbank features (Povey window, pre-emphasis,
+// DC removal), computed on the CPU. from_power_spectrum() runs the same
+// projection over the power spectrum LogMelSpectrogram already computed for
+// Whisper, so diarization needs one more mel projection rather than a second
+// STFT; those frames are Hann windowed and centred on t * hop without
+// pre-emphasis, which CMN mostly absorbs, so they approximate Kaldi's rather
+// than match them.
 class Fbank {
     public:
-        Fbank(
-            const std::string& melFilterPath,
-            const int nMels = N_MELS,
-            const int nFFT = N_FFT,
-            const int hopLength = HOP_LENGTH
-        );
-        
-        size_t nMels() const;
-        
-        size_t nFFT() const;
-        
-        size_t hopLength() const;
-        
-        size_t len() const {
-            return mBuffer.size(0);
+        explicit Fbank(const FbankOptions& options = FbankOptions());
+
+        size_t n_mels() const {
+            return options_.n_mels;
+        }
+
+        // window, hop and FFT size in samples
+        size_t frame_length() const {
+            return frame_length_;
+        }
+
+        size_t frame_shift() const {
+            return frame_shift_;
         }
-        
-        bool compute_features() const {
-            return (mBuffer.size(0) == 0 && mPrev.size() <= mNOverlapFrames * mExtractor.hopLength());
+
+        size_t padded_length() const {
+            return padded_length_;
+        }
+
+        size_t n_frames(const size_t n_samples) const;
+
+        // float32 [n_frames, n_mels] on the CPU.
+        torch::Tensor compute(const std::span<const float> samples) const;
+
+        // Log mel energies and CMN of a power spectrum [n_frames,
+        // spectrum_fft / 2 + 1] of samples in [-1, 1], on the spectrum's
+        // device.
+        torch::Tensor from_power_spectrum(const torch::Tensor& power) const;
+
+        // rust ffi
+        inline std::unique_ptr<Features> compute(
+            const rust::Slice<const float> samples
+        ) const {
+            return std::make_unique<Features>(
+                compute(std::span<const float>(samples.data(), samples.size()))
+            );
+        }
+
+        // rust ffi
+        inline std::unique_ptr<Features> from_power_spectrum(
+            const Features& power
+        ) const {
+            return std::make_unique<Features>(from_power_spectrum(power.tensor()));
         }
 
     private:
-        inner_ kaldifeat::Fbank;
-}
\ No newline at end of file
+        // natural log with Kaldi's floor, then CMN
+        torch::Tensor finish(torch::Tensor mel) const;
+
+        FbankOptions options_;
+        size_t frame_length_;
+        size_t frame_shift_;
+        size_t padded_length_;
+        std::vector<float> window_;
+        MelBands bands_;
+        // filters over the shared spectrum: banded for the CPU, dense
+        // [n_mels, spectrum_fft / 2 + 1] for other devices
+        MelBands spectrum_bands_;
+        torch::Tensor spectrum_banks_;
+};
+
+// rust ffi
+inline std::unique_ptr<Fbank> fbank(
+    const size_t n_mels,
+    const bool cmn
+) {
+    FbankOptions options;
+    options.n_mels = n_mels;
+    options.cmn = cmn;
+    return std::make_unique<Fbank>(options);
+}
@@ -1,22 +1,135 @@
-use std::ops::Deref;
-
 use cxx::UniquePtr;
 
 use anyhow::{anyhow, Result};
 
+use crate::sys::features::{self, Features};
+
 #[cxx::bridge]
 pub(crate) mod ffi {
     unsafe extern "C++" {
+        type Features = super::features::ffi::Features;
+
         include!("whisper-trtllm-rs/src/diarization/sys/kaldifeat.h");
 
         type Fbank;
 
-        fn fbank() -> UniquePtr<Fbank>;
+        fn fbank(
+            n_mels: usize,
+            cmn: bool,
+        ) -> Result<UniquePtr<Fbank>>;
+
+        fn n_mels(self: &Fbank) -> usize;
 
-        fn compute_features(
+        fn compute(
             self: &Fbank,
             samples: &[f32],
-            vtln_warp: f32,
         ) -> Result<UniquePtr<Features>>;
+
+        fn from_power_spectrum(
+            self: &Fbank,
+            power: &Features,
+        ) -> Result<UniquePtr<Features>>;
+    }
+}
+
+/// Kaldi-compatible log mel filterbank features (25 ms Povey windows every
+/// 10 ms, pre-emphasis, DC removal, optional CMN) for speaker embeddings.
+pub struct Fbank {
+    ptr: UniquePtr<ffi::Fbank>,
+}
+
+impl Fbank {
+    pub fn new(n_mels: usize, cmn: bool) -> Result<Self> {
+        let ptr = ffi::fbank(n_mels, cmn)
+            .map_err(|e| anyhow!("failed to create fbank: {}", e))?;
+        Ok(Self { ptr })
+    }
+
+    pub fn n_mels(&self) -> usize {
+        self.ptr.n_mels()
+    }
+
+    /// Features of 16 kHz samples in [-1, 1], row-major [n_frames, n_mels].
+    pub fn compute(&self, samples: &[f32]) -> Result<Vec<f32>> {
+        let ptr = self.ptr.compute(samples)
+            .map_err(|e| anyhow!("failed to compute fbank: {}", e))?;
+        Ok(ptr.to_vec())
+    }
+
+    /// Features from the power spectrum `LogMelSpectrogram::power_spectrum`
+    /// computed for Whisper: one more mel projection instead of another STFT.
+    /// The frames are Hann windowed and centred, so the result approximates
+    /// `compute` rather than matching it.
+    pub(crate) fn from_power_spectrum(&self, power: &Features) -> Result<Features> {
+        let ptr = self.ptr.from_power_spectrum(power)
+            .map_err(|e| anyhow!("failed to compute fbank from power spectrum: {}", e))?;
+        Ok(ptr.into())
+    }
+}
+
+unsafe impl Send for Fbank {}
+unsafe impl Sync for Fbank {}
+
+#[cfg(test)]
+mod tests {
+    use super::Fbank;
+    use crate::sys::LogMelSpectrogram;
+
+    // rising chirp over light noise
+    fn chirp(seconds: usize) -> Vec<f32> {
+        let mut state = 1u32;
+        (0..seconds * 16000).map(|i| {
+            let t = i as f32 / 16000.0;
+            state = state.wrapping_mul(1664525).wrapping_add(1013904223);
+            let noise = (state >> 8) as f32 / (1u32 << 24) as f32 - 0.5;
+            0.3 * (2.0 * std::f32::consts::PI * (200.0 + 800.0 * t) * t).sin() + 0.1 * noise
+        }).collect()
+    }
+
+    #[test]
+    fn test_fbank_frames() {
+        let fbank = Fbank::new(80, true).unwrap();
+        let values = fbank.compute(&chirp(1)).unwrap();
+        // snip_edges: 1 + (16000 - 400) / 160
+        assert_eq!(values.len(), 98 * 80);
+        for bin in 0..80 {
+            let mean: f32 = values.iter().skip(bin).step_by(80).sum::<f32>() / 98.0;
+            assert!(mean.abs() < 1e-3, "bin {bin} mean {mean}");
+        }
+    }
+
+    #[test]
+    fn test_fbank_from_shared_spectrum() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let fbank = Fbank::new(80, true).unwrap();
+        let audio = chirp(3);
+
+        let kaldi = fbank.compute(&audio).unwrap();
+        // the one STFT both front ends project
+        let power = extractor.power_spectrum(&audio, &[]).unwrap();
+
+        let whisper = extractor.from_power_spectrum(&power).unwrap().to_vec();
+        let expected = extractor.extract_final(&audio, &[]).unwrap().to_vec();
+        assert_eq!(whisper.len(), expected.len());
+        let max_diff = whisper.iter().zip(expected.iter())
+            .map(|(x, y)| (x - y).abs())
+            .fold(0.0f32, f32::max);
+        assert!(max_diff < 1e-2, "max diff {max_diff}");
+
+        // centred frame t + 1 is the nearest to Kaldi's frame t
+        let shared = fbank.from_power_spectrum(&power).unwrap()
+            .slice(1, 1 + kaldi.len() / 80)
+            .to_vec();
+        assert_eq!(shared.len(), kaldi.len());
+
+        let n = kaldi.len() as f64;
+        let (a, b): (Vec<f64>, Vec<f64>) = kaldi.iter().zip(shared.iter()).map(|(x, y)| (*x as f64, *y as f64)).unzip();
+        let mean_a = a.iter().sum::<f64>() / n;
+        let mean_b = b.iter().sum::<f64>() / n;
+        let cov: f64 = a.iter().zip(b.iter()).map(|(x, y)| (x - mean_a) * (y - mean_b)).sum();
+        let var_a: f64 = a.iter().map(|x| (x - mean_a).powi(2)).sum();
+        let var_b: f64 = b.iter().map(|y| (y - mean_b).powi(2)).sum();
+        let correlation = cov / (var_a * var_b).sqrt();
+        assert!(correlation > 0.85, "correlation {correlation}");
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,467 @@
+use super::admission::Permit;
+use super::sys::{ExecutorResponse, TranscribeResult};
+use anyhow::{anyhow, Result};
+use std::collections::HashMap;
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+use tokio::sync::oneshot;
+
+// The admission permit of a request is held until its final response, when
+// the executor has let go of it.
+enum Pending {
+    Waiting {
+        sender: oneshot::Sender<Result<TranscribeResult>>,
+        deadline: Option<Instant>,
+        permit: Option<Permit>,
+    },
+    // the final response landed while its enqueue was still returning
+    Ready(Result<TranscribeResult>),
+    // given up on or failed; its final response, if any, is dropped
+    Cancelled(Option<Permit>),
+}
+
+struct Shared {
+    pending: Mutex<HashMap<u64, Pending>>,
+    // enqueues whose request is not registered yet; only while there are
+    // any can a response for an unknown id still be claimed
+    enqueuing: AtomicUsize,
+    cancel: Box<dyn Fn(u64) -> Result<()> + Send + Sync>,
+}
+
+impl Shared {
+    /// Ends an enqueue; the last one out drops the responses nobody
+    /// registered.
+    fn enqueued(&self) {
+        let mut pending = self.pending.lock().unwrap();
+        if self.enqueuing.fetch_sub(1, Ordering::AcqRel) == 1 {
+            pending.retain(|_, entry| !matches!(entry, Pending::Ready(_)));
+        }
+    }
+
+    /// Cancels a request nobody waits for any more.
+    fn abandon(&self, request_id: u64) {
+        let mut pending = self.pending.lock().unwrap();
+        match pending.remove(&request_id) {
+            Some(Pending::Waiting { permit, .. }) => {
+                pending.insert(request_id, Pending::Cancelled(permit));
+            }
+            Some(Pending::Cancelled(permit)) => {
+                pending.insert(request_id, Pending::Cancelled(permit));
+                return;
+            }
+            // done, nothing to cancel
+            _ => return,
+        }
+        drop(pending);
+
+        // on failure the request runs to completion and its response is
+        // dropped all the same
+        let _ = (self.cancel)(request_id);
+    }
+}
+
+/// Hands the executor's responses to the requests waiting for them: one
+/// thread drains every ready response, blocking until one lands, and
+/// completes the request's oneshot with its final result. Callers are woken
+/// as soon as their result is in, without polling.
+///
+/// A request whose response future is dropped is cancelled, and so is one
+/// still running at its deadline, which then fails; either way the executor
+/// stops decoding it and frees its state. Responses to requests that were
+/// not enqueued through the dispatcher, or that it already failed, are
+/// dropped.
+pub(crate) struct Dispatcher {
+    shared: Arc<Shared>,
+    running: Arc<AtomicBool>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl Dispatcher {
+    /// How long one drain waits for a response before it checks deadlines
+    /// and shutdown; responses wake it earlier.
+    pub const TIMEOUT: Duration = Duration::from_millis(10);
+
+    /// Starts the dispatcher thread on a drain like
+    /// `sys::Whisper::await_responses` and a cancel like
+    /// `sys::Whisper::cancel_request`.
+    pub fn spawn<F, C>(mut drain: F, cancel: C) -> Self
+    where
+        F: FnMut(Duration) -> Result<Vec<ExecutorResponse>> + Send + 'static,
+        C: Fn(u64) -> Result<()> + Send + Sync + 'static,
+    {
+        let shared = Arc::new(Shared {
+            pending: Mutex::default(),
+            enqueuing: AtomicUsize::new(0),
+            cancel: Box::new(cancel),
+        });
+        let running = Arc::new(AtomicBool::new(true));
+
+        let thread = {
+            let shared = shared.clone();
+            let running = running.clone();
+            thread::Builder::new()
+                .name("whisper-dispatcher".into())
+                .spawn(move || {
+                    while running.load(Ordering::Acquire) {
+                        match drain(Self::TIMEOUT) {
+                            Ok(responses) => {
+                                for response in responses {
+                                    Self::dispatch(&shared, response);
+                                }
+                            }
+                            Err(e) => {
+                                Self::fail_waiting(&shared, &e.to_string());
+                                thread::sleep(Self::TIMEOUT);
+                            }
+                        }
+                        Self::expire(&shared, Instant::now());
+                    }
+                    Self::fail_waiting(&shared, "dispatcher stopped");
+                })
+                .expect("failed to spawn the response dispatcher")
+        };
+
+        Self { shared, running, thread: Some(thread) }
+    }
+
+    /// Enqueues a request with `enqueue`, which returns its id, and
+    /// registers it. The response resolves to the final result, or to an
+    /// error once the deadline has passed. Dropping the response cancels the
+    /// request. The permit is released with the final response.
+    pub fn enqueue<E>(&self, enqueue: E, deadline: Option<Instant>, permit: Option<Permit>) -> Result<Response>
+    where
+        E: FnOnce() -> Result<u64>,
+    {
+        // counted before the executor can answer, so a response that lands
+        // before the registration below is kept for it
+        self.shared.enqueuing.fetch_add(1, Ordering::AcqRel);
+        let request_id = match enqueue() {
+            Ok(request_id) => request_id,
+            Err(e) => {
+                self.shared.enqueued();
+                return Err(e);
+            }
+        };
+
+        let (sender, receiver) = oneshot::channel();
+        let mut pending = self.shared.pending.lock().unwrap();
+        match pending.remove(&request_id) {
+            Some(Pending::Ready(result)) => {
+                let _ = sender.send(result);
+            }
+            _ => {
+                pending.insert(request_id, Pending::Waiting { sender, deadline, permit });
+            }
+        }
+        drop(pending);
+        self.shared.enqueued();
+
+        Ok(Response {
+            request_id,
+            receiver,
+            shared: Some(self.shared.clone()),
+        })
+    }
+
+    fn dispatch(shared: &Shared, response: ExecutorResponse) {
+        let result = if response.error.is_empty() {
+            // not streaming, so only the final response counts
+            if !response.result.is_final {
+                return;
+            }
+            Ok(response.result)
+        } else {
+            Err(anyhow!("request {} failed: {}", response.request_id, response.error))
+        };
+
+        let mut pending = shared.pending.lock().unwrap();
+        let entry = pending.remove(&response.request_id);
+        let entry = match entry {
+            Some(Pending::Waiting { sender, permit, .. }) => {
+                let _ = sender.send(result);
+                permit
+            }
+            Some(Pending::Cancelled(permit)) => permit,
+            // its enqueue may not have registered it yet
+            None if shared.enqueuing.load(Ordering::Acquire) > 0 => {
+                pending.insert(response.request_id, Pending::Ready(result));
+                None
+            }
+            // never enqueued through the dispatcher
+            None => None,
+            Some(ready) => {
+                pending.insert(response.request_id, ready);
+                None
+            }
+        };
+        drop(pending);
+        // admits the next request, outside the lock
+        drop(entry);
+    }
+
+    // fails and cancels the requests past their deadline
+    fn expire(shared: &Shared, now: Instant) {
+        let mut pending = shared.pending.lock().unwrap();
+        let expired: Vec<u64> = pending.iter()
+            .filter(|(_, entry)| matches!(entry, Pending::Waiting { deadline: Some(deadline), .. } if *deadline <= now))
+            .map(|(request_id, _)| *request_id)
+            .collect();
+        for &request_id in &expired {
+            if let Some(Pending::Waiting { sender, permit, .. }) = pending.remove(&request_id) {
+                let _ = sender.send(Err(anyhow!("request {request_id} missed its deadline")));
+                pending.insert(request_id, Pending::Cancelled(permit));
+            }
+        }
+        drop(pending);
+
+        for request_id in expired {
+            let _ = (shared.cancel)(request_id);
+        }
+    }
+
+    // fails and cancels every waiting request; the executor may never
+    // answer, so the permits go now, cancelled requests' too, and what it
+    // does answer later is dropped
+    fn fail_waiting(shared: &Shared, error: &str) {
+        let mut pending = shared.pending.lock().unwrap();
+        let unanswered: Vec<u64> = pending.iter()
+            .filter(|(_, entry)| !matches!(entry, Pending::Ready(_)))
+            .map(|(request_id, _)| *request_id)
+            .collect();
+        let mut failed = vec![];
+        let mut permits = vec![];
+        for request_id in unanswered {
+            match pending.insert(request_id, Pending::Cancelled(None)) {
+                Some(Pending::Waiting { sender, permit, .. }) => {
+                    let _ = sender.send(Err(anyhow!("request {request_id} failed: {error}")));
+                    permits.push(permit);
+                    failed.push(request_id);
+                }
+                Some(Pending::Cancelled(permit)) => permits.push(permit),
+                _ => {}
+            }
+        }
+        drop(pending);
+        drop(permits);
+
+        for request_id in failed {
+            let _ = (shared.cancel)(request_id);
+        }
+    }
+}
+
+impl Drop for Dispatcher {
+    fn drop(&mut self) {
+        self.running.store(false, Ordering::Release);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+/// The pending result of one request; cancels the request when dropped
+/// before the result is in.
+pub(crate) struct Response {
+    request_id: u64,
+    receiver: oneshot::Receiver<Result<TranscribeResult>>,
+    // None once the result is in
+    shared: Option<Arc<Shared>>,
+}
+
+impl Future for Response {
+    type Output = Result<TranscribeResult>;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let request_id = self.request_id;
+        let result = match Pin::new(&mut self.receiver).poll(cx) {
+            Poll::Pending => return Poll::Pending,
+            Poll::Ready(result) => result,
+        };
+        self.shared = None;
+        Poll::Ready(result.map_err(|_| anyhow!("request {request_id} was dropped by the dispatcher"))?)
+    }
+}
+
+impl Drop for Response {
+    fn drop(&mut self) {
+        if let Some(shared) = self.shared.take() {
+            shared.abandon(self.request_id);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::admission::{Admission, AdmissionConfig, Priority, Scheduling};
+    use std::sync::mpsc;
+
+    fn response(request_id: u64, is_final: bool, tokens: Vec<u32>) -> ExecutorResponse {
+        ExecutorResponse {
+            request_id,
+            error: String::new(),
+            result: TranscribeResult {
+                is_final,
+                is_sequence_final: is_final,
+                tokens,
+                avg_logprob: 0.0,
+            },
+        }
+    }
+
+    /// A dispatcher draining whatever the test sends it, and the ids it
+    /// cancelled.
+    fn dispatcher() -> (Dispatcher, mpsc::Sender<ExecutorResponse>, mpsc::Receiver<u64>) {
+        let (sender, receiver) = mpsc::channel();
+        let (cancel_sender, cancelled) = mpsc::channel();
+        let cancel_sender = Mutex::new(cancel_sender);
+        let dispatcher = Dispatcher::spawn(
+            move |timeout| Ok(receiver.recv_timeout(timeout).into_iter().chain(receiver.try_iter()).collect()),
+            move |request_id| Ok(cancel_sender.lock().unwrap().send(request_id)?),
+        );
+        (dispatcher, sender, cancelled)
+    }
+
+    /// Waits for the condition, failing the test after a second.
+    async fn eventually(mut condition: impl FnMut() -> bool) {
+        tokio::time::timeout(Duration::from_secs(1), async {
+            while !condition() {
+                tokio::time::sleep(Duration::from_millis(1)).await;
+            }
+        }).await.expect("condition not met in time");
+    }
+
+    #[tokio::test]
+    async fn test_dispatcher_completes_requests() {
+        let (dispatcher, executor, cancelled) = dispatcher();
+
+        // registered before the response lands, and while its enqueue is
+        // still returning
+        let first = dispatcher.enqueue(|| Ok(1), None, None).unwrap();
+        executor.send(response(1, false, vec![1])).unwrap();
+        executor.send(response(1, true, vec![1, 2])).unwrap();
+        assert_eq!(first.await.unwrap().tokens, vec![1, 2]);
+        let second = dispatcher.enqueue(|| {
+            executor.send(response(2, true, vec![3])).unwrap();
+            thread::sleep(Dispatcher::TIMEOUT * 3);
+            Ok(2)
+        }, None, None).unwrap();
+        assert_eq!(second.await.unwrap().tokens, vec![3]);
+
+        let failed = dispatcher.enqueue(|| Ok(3), None, None).unwrap();
+        executor.send(ExecutorResponse { error: "cancelled".into(), ..response(3, true, vec![]) }).unwrap();
+        assert!(failed.await.is_err());
+
+        assert!(cancelled.try_recv().is_err());
+    }
+
+    #[tokio::test]
+    async fn test_dropped_and_late_requests_are_cancelled() {
+        let (dispatcher, executor, cancelled) = dispatcher();
+
+        drop(dispatcher.enqueue(|| Ok(1), None, None).unwrap());
+        assert_eq!(cancelled.recv_timeout(Duration::from_secs(1)).unwrap(), 1);
+
+        let late = dispatcher.enqueue(|| Ok(2), Some(Instant::now() + Duration::from_millis(20)), None).unwrap();
+        assert!(late.await.is_err());
+        assert_eq!(cancelled.recv_timeout(Duration::from_secs(1)).unwrap(), 2);
+
+        // the final responses of both are dropped, not kept for a caller
+        executor.send(response(1, true, vec![])).unwrap();
+        executor.send(response(2, true, vec![])).unwrap();
+        eventually(|| dispatcher.shared.pending.lock().unwrap().is_empty()).await;
+    }
+
+    /// Responses to ids the dispatcher never enqueued are dropped, and so is
+    /// a response that lands during an enqueue that then fails.
+    #[tokio::test]
+    async fn test_unknown_responses_are_dropped() {
+        let (dispatcher, executor, cancelled) = dispatcher();
+
+        executor.send(response(7, true, vec![1])).unwrap();
+        let refused = dispatcher.enqueue(|| {
+            executor.send(response(8, true, vec![2])).unwrap();
+            thread::sleep(Dispatcher::TIMEOUT * 3);
+            Err(anyhow!("queue full"))
+        }, None, None);
+        assert!(refused.is_err());
+
+        // drained in order, so 7 and 8 are through once 9 is
+        let known = dispatcher.enqueue(|| Ok(9), None, None).unwrap();
+        executor.send(response(9, true, vec![3])).unwrap();
+        assert_eq!(known.await.unwrap().tokens, vec![3]);
+        assert!(dispatcher.shared.pending.lock().unwrap().is_empty());
+        assert!(cancelled.try_recv().is_err());
+    }
+
+    /// The siblings of a multi-segment job whose later enqueue failed:
+    /// their responses are dropped unpolled, one after its final response
+    /// landed and one before, and neither leaves an entry or a place behind.
+    #[tokio::test]
+    async fn test_abandoned_siblings_are_released() {
+        let (dispatcher, executor, cancelled) = dispatcher();
+        let admission = Admission::new(AdmissionConfig::default());
+        let scheduling = Scheduling { priority: Priority::Batch, tenant: String::new(), deadline: None };
+
+        let mut siblings = vec![];
+        for request_id in [1, 2] {
+            let permit = admission.admit(&scheduling).await.unwrap();
+            siblings.push(dispatcher.enqueue(|| Ok(request_id), None, Some(permit)).unwrap());
+        }
+        // the dispatcher drops a permit just after it clears the entry
+        executor.send(response(1, true, vec![1])).unwrap();
+        eventually(|| admission.in_flight() == 1).await;
+
+        drop(siblings);
+        assert_eq!(cancelled.recv_timeout(Duration::from_secs(1)).unwrap(), 2);
+        executor.send(response(2, true, vec![])).unwrap();
+        eventually(|| admission.in_flight() == 0).await;
+        assert!(dispatcher.shared.pending.lock().unwrap().is_empty());
+        assert!(cancelled.try_recv().is_err());
+    }
+
+    /// A failing drain fails and cancels the waiting requests and gives
+    /// back the places of cancelled requests as well as theirs. What the
+    /// executor still sends for them afterwards is dropped.
+    #[tokio::test]
+    async fn test_failed_drain_cancels_and_releases_every_permit() {
+        let (executor, responses) = mpsc::channel();
+        let (cancel_sender, cancelled) = mpsc::channel();
+        let cancel_sender = Mutex::new(cancel_sender);
+        let failing = Arc::new(AtomicBool::new(false));
+        let dispatcher = {
+            let failing = failing.clone();
+            Dispatcher::spawn(
+                move |timeout| {
+                    if failing.swap(false, Ordering::AcqRel) {
+                        return Err(anyhow!("executor gone"));
+                    }
+                    Ok(responses.recv_timeout(timeout).into_iter().chain(responses.try_iter()).collect())
+                },
+                move |request_id| Ok(cancel_sender.lock().unwrap().send(request_id)?),
+            )
+        };
+        let admission = Admission::new(AdmissionConfig::default());
+        let scheduling = Scheduling { priority: Priority::Batch, tenant: String::new(), deadline: None };
+
+        let waiting = dispatcher.enqueue(|| Ok(1), None, Some(admission.admit(&scheduling).await.unwrap())).unwrap();
+        drop(dispatcher.enqueue(|| Ok(2), None, Some(admission.admit(&scheduling).await.unwrap())).unwrap());
+        assert_eq!(cancelled.recv_timeout(Duration::from_secs(1)).unwrap(), 2);
+        assert_eq!(admission.in_flight(), 2);
+
+        failing.store(true, Ordering::Release);
+        assert!(waiting.await.is_err());
+        assert_eq!(cancelled.recv_timeout(Duration::from_secs(1)).unwrap(), 1);
+        eventually(|| admission.in_flight() == 0).await;
+
+        executor.send(response(1, true, vec![1])).unwrap();
+        executor.send(response(2, true, vec![])).unwrap();
+        eventually(|| dispatcher.shared.pending.lock().unwrap().is_empty()).await;
+        assert!(cancelled.try_recv().is_err());
+    }
+}
@@ -1,40 +1,33 @@
-use tokio::io::{AsyncRead, AsyncReadExt};
-use anyhow::{anyhow, Ok, Result};
-use std::collections::VecDeque;
-use super::sys::{Features, LogMelSpectrogram};
+use anyhow::Result;
+use super::sys::{self, Features, LogMelSpectrogram};
 use futures::stream::{Stream, StreamExt};
 
-pub(crate) struct FeatureBuffer<'a, S> {
-    extractor: &'a LogMelSpectrogram,
+pub(crate) struct FeatureBuffer<S> {
+    buffer: sys::FeatureBuffer,
     stream: S,
-    prev: Vec<f32>,
-    overlap_frames: usize,
-    features: Features,
     offset: usize,
     eof: bool,
 }
 
-impl<'a, S> FeatureBuffer<'a, S> 
-where 
+impl<S> FeatureBuffer<S>
+where
     S: Stream<Item = Vec<f32>> + Unpin,
-{  
+{
     const MILLIS_PER_FRAME: usize = 10;
+    const N_FRAMES: usize = 3000;
 
-    pub fn new(extractor: &'a LogMelSpectrogram, stream: S) -> Self {
-        let features = extractor.empty();
-        Self {
-            extractor,
+    pub fn new(extractor: &LogMelSpectrogram, stream: S) -> Result<Self> {
+        let buffer = sys::FeatureBuffer::new(extractor)?;
+        Ok(Self {
+            buffer,
             stream,
-            prev: vec![],
-            overlap_frames: 0,
-            features,
             offset: 0,
             eof: false,
-        }
+        })
     }
 
     pub fn len(&self) -> usize {
-        self.offset + self.features.len()
+        self.offset + self.buffer.len()
     }
 
     pub fn eof(&self) -> bool {
@@ -42,38 +35,22 @@ where
     }
 
     pub fn offset(&self) -> usize {
-        self.offset + Self::MILLIS_PER_FRAME
-    }
-
-    fn overlap_samples(&self) -> usize {
-        self.overlap_frames * self.samples_per_frame()
-    }
-
-    fn samples_per_frame(&self) -> usize {
-        self.extractor.hop_length()
+        self.offset * Self::MILLIS_PER_FRAME
     }
 
-    fn required_overlap_frames(&self) -> usize {
-        self.extractor.required_overlap_frames()
-    }
-
-    // pub fn duration(&self) -> usize {
-    //    self.offset + self.buffer.len() / Self::SAMPLES_PER_MILLIS
-    // }
-
     pub async fn features(&mut self, chunk_size: usize) -> Result<Option<Features>> {
         loop {
-            if self.features.len() >= chunk_size {
-                let chuck = self.features.slice(0, chunk_size);
+            if self.buffer.len() >= chunk_size {
+                let chuck = self.buffer.features(chunk_size)?;
                 return Ok(Some(chuck));
             }
 
             if self.eof {
-                if self.features.len() == 0 {
+                if self.buffer.len() == 0 {
                     return Ok(None);
                 } else {
-                    let n = chunk_size - self.features.len();
-                    let features = self.features.pad(n);
+                    let n = chunk_size - self.buffer.len();
+                    let features = self.buffer.features(self.buffer.len())?.pad(n);
                     return Ok(Some(features));
                 }
             }
@@ -82,47 +59,164 @@ where
         }
     }
 
+    /// Next encoder window, written into a pooled slab and padded in place.
+    pub async fn encoder_input(&mut self) -> Result<Option<Features>> {
+        while self.buffer.len() < Self::N_FRAMES && !self.eof {
+            self.fill().await?;
+        }
+
+        if self.buffer.len() == 0 {
+            return Ok(None);
+        }
+        let n = self.buffer.len().min(Self::N_FRAMES);
+        Ok(Some(self.buffer.encoder_input(n)?))
+    }
+
+    // Only the frames completed by the new samples are extracted; the stream
+    // keeps the partial window between calls.
     pub async fn fill(&mut self) -> Result<()> {
-        let Some(mut samples) = self.stream.next().await else {
-            let features = self.extractor.extract_final(&self.prev, &[]).unwrap();
-            self.features.join(&features.slice_to_end(self.overlap_frames));
+        let Some(samples) = self.stream.next().await else {
+            self.buffer.finish()?;
             self.eof = true;
             return Ok(());
         };
 
-        let features = self.extractor.extract(
-            &self.prev,
-            &samples,
-        )?.slice_to_end(self.overlap_frames);
+        self.buffer.append(&samples)
+    }
+
+    pub fn consume(&mut self, n_frames: usize) -> Result<()> {
+        let n_frames = n_frames.min(self.buffer.len());
+        self.buffer.consume(n_frames)?;
+        self.offset += n_frames;
+        Ok(())
+    }
+
+    /// Consumes non-speech in front of the next speech, reading ahead until
+    /// speech shows up or the stream ends, so silent or music-only windows
+    /// never reach the encoder. Returns the number of frames skipped.
+    pub async fn skip_non_speech(&mut self) -> Result<usize> {
+        let mut skipped = 0;
+        loop {
+            let n = self.buffer.skip_non_speech()?;
+            self.offset += n;
+            skipped += n;
+
+            if self.eof || !self.buffer.speech_spans().is_empty() {
+                return Ok(skipped);
+            }
+            self.fill().await?;
+        }
+    }
+
+    /// Speech in the buffered frames as (start, end) millis from the start
+    /// of the stream.
+    pub fn speech_spans(&mut self) -> Vec<(usize, usize)> {
+        let offset = self.offset;
+        self.buffer.speech_spans().iter()
+            .map(|span| (
+                (offset + span.begin) * Self::MILLIS_PER_FRAME,
+                (offset + span.end) * Self::MILLIS_PER_FRAME,
+            ))
+            .collect()
+    }
+
+    /// Parks the buffered frames in host memory while the stream is idle;
+    /// the next fill or consume brings them back.
+    pub fn park(&mut self, quantize: bool) -> Result<()> {
+        self.buffer.park(quantize)
+    }
+
+    pub fn consume_millis(&mut self, millis: usize) -> Result<()> {
+        self.consume(millis / Self::MILLIS_PER_FRAME)
+    }
+}
+
+/// Features of every channel of an interleaved multi-channel stream. The
+/// channels advance together: each chunk read from the stream is split and
+/// extracted for all of them in one batched call.
+pub(crate) struct ChannelFeatures<S> {
+    buffers: sys::ChannelBuffers,
+    stream: S,
+    offsets: Vec<usize>,
+    eof: bool,
+}
+
+impl<S> ChannelFeatures<S>
+where
+    S: Stream<Item = Vec<f32>> + Unpin,
+{
+    const MILLIS_PER_FRAME: usize = 10;
+    const N_FRAMES: usize = 3000;
+
+    pub fn new(extractor: &LogMelSpectrogram, channels: usize, stream: S) -> Result<Self> {
+        let buffers = sys::ChannelBuffers::new(extractor, channels)?;
+        Ok(Self {
+            buffers,
+            stream,
+            offsets: vec![0; channels],
+            eof: false,
+        })
+    }
+
+    pub fn channels(&self) -> usize {
+        self.offsets.len()
+    }
+
+    pub fn eof(&self) -> bool {
+        self.eof
+    }
+
+    pub fn offset(&self, channel: usize) -> usize {
+        self.offsets[channel] * Self::MILLIS_PER_FRAME
+    }
 
-        let mut n = self.prev.len() + samples.len() - features.len() * self.samples_per_frame();
-        if self.overlap_frames < self.required_overlap_frames() {
-            n -= self.overlap_samples();
+    /// Next encoder window of one channel, reading ahead for all of them.
+    pub async fn encoder_input(&mut self, channel: usize) -> Result<Option<Features>> {
+        while self.buffers.len(channel)? < Self::N_FRAMES && !self.eof {
+            self.fill().await?;
+        }
 
-            self.overlap_frames = std::cmp::min(
-                self.overlap_frames + features.len(),
-                self.required_overlap_frames(),
-            );
+        let len = self.buffers.len(channel)?;
+        if len == 0 {
+            return Ok(None);
+        }
+        Ok(Some(self.buffers.encoder_input(channel, len.min(Self::N_FRAMES))?))
+    }
 
-            n += self.overlap_samples();
+    /// Skips the non-speech in front of a channel's next speech, see
+    /// `FeatureBuffer::skip_non_speech`.
+    pub async fn skip_non_speech(&mut self, channel: usize) -> Result<usize> {
+        let mut skipped = 0;
+        loop {
+            let n = self.buffers.skip_non_speech(channel)?;
+            self.offsets[channel] += n;
+            skipped += n;
 
-            let mut combined = self.prev.clone();
-            combined.extend(samples);
-            samples = combined;            
+            if self.eof || !self.buffers.speech_spans(channel)?.is_empty() {
+                return Ok(skipped);
+            }
+            self.fill().await?;
         }
-        self.prev = samples[samples.len() - n..].to_vec();
+    }
 
-        self.features = self.features.join(&features);
+    pub async fn fill(&mut self) -> Result<()> {
+        let Some(samples) = self.stream.next().await else {
+            self.buffers.finish()?;
+            self.eof = true;
+            return Ok(());
+        };
 
-        Ok(())
+        self.buffers.append_interleaved(&samples)
     }
 
-    pub fn consume(&mut self, n_frames: usize) {
-        self.features = self.features.slice_to_end(n_frames);
-        self.offset += n_frames;
+    pub fn consume(&mut self, channel: usize, n_frames: usize) -> Result<()> {
+        let n_frames = n_frames.min(self.buffers.len(channel)?);
+        self.buffers.consume(channel, n_frames)?;
+        self.offsets[channel] += n_frames;
+        Ok(())
     }
 
-    pub fn consume_millis(&mut self, millis: usize) {
-        self.consume(millis / Self::MILLIS_PER_FRAME);
+    pub fn consume_millis(&mut self, channel: usize, millis: usize) -> Result<()> {
+        self.consume(channel, millis / Self::MILLIS_PER_FRAME)
     }
-}
\ No newline at end of file
+}
@@ -1,10 +1,15 @@
 mod sys;
 mod tokenizer;
 mod model;
+mod dispatcher;
+mod admission;
 mod features;
 mod audio;
 mod whisper;
-//mod transcript;
+pub mod diarization;
+mod transcript;
 //pub use sys::TranscribeOptions;
 pub use whisper::{Whisper, Config};
-//pub use transcript::{Segment};
\ No newline at end of file
+pub use admission::{AdmissionConfig, Priority};
+pub use sys::Resampler;
+pub use transcript::Segment;
\ No newline at end of file
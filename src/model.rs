@@ -1,39 +1,59 @@
 use super::sys::{self, Config, Features, TranscribeOptions, TranscribeResult};
-use std::sync::{Mutex, RwLock};
+#[cfg(test)]
+use super::sys::MockConfig;
+use super::admission::{Admission, AdmissionConfig, Scheduling};
+use super::dispatcher::Dispatcher;
+use std::sync::{Arc, Mutex};
 use anyhow::{anyhow, Result};
 use std::path::Path;
 use std::future::Future;
-use tokio::time::{sleep, Duration};
+use futures::future::try_join_all;
 
 pub(crate) struct Model {
-    inner: RwLock<sys::Whisper>,
+    inner: Arc<sys::Whisper>,
+    dispatcher: Dispatcher,
+    admission: Admission,
 }
 
 impl Model {
-    pub fn load<P: AsRef<Path>>(model_path: P, config: Config) -> Result<Self> {
-        let inner = RwLock::new(sys::Whisper::load(&model_path, config)?);
-        Ok(Self { inner })
+    pub fn load<P: AsRef<Path>>(model_path: P, config: Config, admission: AdmissionConfig) -> Result<Self> {
+        let inner = sys::Whisper::load(&model_path, config)?;
+        Ok(Self::new(inner, admission))
     }
 
-    pub fn detect_language<'a>(&'a self, features: &'a Features) -> impl Future<Output = Result<u32>> + 'a {
-        let mut whisper = self.inner.write().unwrap();
-        let result = whisper.enqueue_detect_language_request(features);
+    /// A model on the CPU mock executor.
+    #[cfg(test)]
+    pub fn mock(config: MockConfig, admission: AdmissionConfig) -> Self {
+        Self::new(sys::Whisper::mock(config), admission)
+    }
 
-        async move {
-            let request_id = result?;
-            
-            loop {
-                let whisper = self.inner.read().unwrap();
-                if whisper.is_response_ready(&request_id)? {
-                    break;
-                }
-                drop(whisper);
-                sleep(Duration::from_millis(5)).await;
-            }
-            
-            let mut whisper = self.inner.write().unwrap();
-            whisper.await_detect_language_response(&request_id)
-        }
+    fn new(inner: sys::Whisper, admission: AdmissionConfig) -> Self {
+        let inner = Arc::new(inner);
+
+        let (whisper, cancelling) = (inner.clone(), inner.clone());
+        let dispatcher = Dispatcher::spawn(
+            move |timeout| whisper.await_responses(timeout),
+            move |request_id| cancelling.cancel_request(request_id),
+        );
+
+        Self { inner, dispatcher, admission: Admission::new(admission) }
+    }
+
+    /// Requests wait in the admission queue for a place in the executor,
+    /// and hold it until their result is in. Requests still running at
+    /// their deadline are cancelled and fail; dropping the returned futures
+    /// cancels them as well.
+    pub async fn detect_language(&self, features: &Features, scheduling: &Scheduling) -> Result<u32> {
+        let permit = self.admission.admit(scheduling).await?;
+
+        let response = self.dispatcher.enqueue(
+            || self.inner.enqueue_detect_language_request(features),
+            scheduling.deadline,
+            Some(permit),
+        )?;
+        let result = response.await?;
+
+        result.tokens.last().copied().ok_or_else(|| anyhow!("no language token in the response"))
     }
 
     /*
@@ -88,31 +108,139 @@ impl Model {
     }
     */
 
+    /// Decodes several windows, e.g. one per channel of a recording, as
+    /// sibling requests: all are enqueued before any is awaited, so they run
+    /// in the same in-flight batch. Token sequences come back in order.
+    /// If one fails, the others are cancelled.
+    pub async fn transcribe_segments(&self,
+        features: Vec<Features>,
+        input: &[u32],
+        scheduling: &Scheduling,
+    ) -> Result<Vec<Vec<u32>>> {
+        let mut responses = Vec::with_capacity(features.len());
+        for features in &features {
+            // the siblings already in give their places back as they finish
+            let permit = self.admission.admit(scheduling).await?;
+            // registered right away: if a later sibling fails to enqueue,
+            // dropping these cancels the ones already in
+            responses.push(self.dispatcher.enqueue(
+                || self.inner.enqueue_transcribe_request(
+                    features,
+                    input,
+                    &TranscribeOptions::default(),
+                    true, // stop_on_timestamp
+                ),
+                scheduling.deadline,
+                Some(permit),
+            )?);
+        }
+
+        let results = try_join_all(responses).await?;
+
+        Ok(results.into_iter().map(|result| result.tokens).collect())
+    }
+
     pub async fn transcribe_segment<'a>(&'a self, 
         features: Features, 
         input: &[u32],
+        scheduling: &Scheduling,
     ) -> Result<Vec<u32>> {
-        let mut whisper = self.inner.write().unwrap();
-        let request_id = whisper.enqueue_transcribe_request(
-            &features, 
-            &input, 
-            &TranscribeOptions::default(),
-            true, // stop_on_timestamp
+        let permit = self.admission.admit(scheduling).await?;
+
+        let response = self.dispatcher.enqueue(
+            || self.inner.enqueue_transcribe_request(
+                &features, 
+                &input, 
+                &TranscribeOptions::default(),
+                true, // stop_on_timestamp
+            ),
+            scheduling.deadline,
+            Some(permit),
         )?;
-        drop(whisper);
-            
-        loop {
-            let whisper = self.inner.read().unwrap();
-            if whisper.is_response_ready(&request_id)? {
-                break;
-            }
-            drop(whisper);
-            sleep(Duration::from_millis(5)).await;
-        }
-            
-        let mut whisper = self.inner.write().unwrap();
-        let result = whisper.await_transcribe_response(&request_id)?;
+        let result = response.await?;
 
         Ok(result.tokens)
     }
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::admission::Priority;
+    use crate::sys::LogMelSpectrogram;
+    use futures::future::join_all;
+    use std::time::{Duration, Instant};
+
+    /// Every class through a tight admission queue in front of the mock
+    /// executor: all requests finish and give their places back.
+    #[tokio::test]
+    async fn test_mock_admits_every_class() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+        let admission = AdmissionConfig { max_in_flight: 2, realtime_reserve: 1, ..Default::default() };
+        let mock = MockConfig { encoder_micros: 0, step_micros: 100, step_micros_per_request: 0, ..Default::default() };
+        let model = Model::mock(mock, admission);
+
+        let requests = (0..24).map(|i| {
+            let scheduling = Scheduling {
+                priority: [Priority::Realtime, Priority::Interactive, Priority::Batch][i % 3],
+                tenant: format!("tenant{}", i % 2),
+                deadline: None,
+            };
+            let (model, features) = (&model, &features);
+            async move { model.detect_language(features, &scheduling).await }
+        });
+        let languages = tokio::time::timeout(Duration::from_secs(10), join_all(requests)).await.unwrap();
+        for language in languages {
+            assert_eq!(language.unwrap(), 50259);
+        }
+        // the dispatcher drops a permit just after handing out its result
+        tokio::time::timeout(Duration::from_secs(1), async {
+            while model.admission.in_flight() > 0 {
+                tokio::time::sleep(Duration::from_millis(1)).await;
+            }
+        }).await.unwrap();
+    }
+
+    /// Mixed load on the mock executor with a tenth of the requests
+    /// realtime, three tenths interactive and the rest batch.
+    #[tokio::test]
+    #[ignore]
+    async fn bench_mock_latency_per_class() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+        let admission = AdmissionConfig { max_in_flight: 16, realtime_reserve: 4, ..Default::default() };
+        let model = Model::mock(MockConfig { max_batch_size: 16, ..Default::default() }, admission);
+
+        let requests = (0..512).map(|i| {
+            let scheduling = Scheduling {
+                priority: match i % 10 {
+                    0 => Priority::Realtime,
+                    1..=3 => Priority::Interactive,
+                    _ => Priority::Batch,
+                },
+                tenant: format!("tenant{}", i % 4),
+                deadline: None,
+            };
+            let (model, features) = (&model, &features);
+            async move {
+                // arrivals spread over the run rather than one burst
+                tokio::time::sleep(Duration::from_millis(i * 2)).await;
+                let start = Instant::now();
+                model.detect_language(features, &scheduling).await.unwrap();
+                (scheduling.priority, start.elapsed())
+            }
+        });
+        let results = join_all(requests).await;
+
+        for priority in [Priority::Realtime, Priority::Interactive, Priority::Batch] {
+            let mut latencies: Vec<Duration> = results.iter()
+                .filter(|(p, _)| *p == priority)
+                .map(|(_, latency)| *latency)
+                .collect();
+            latencies.sort();
+            let p50 = latencies[latencies.len() / 2];
+            let p99 = latencies[latencies.len() * 99 / 100];
+            println!("{priority:?}: {} requests, p50 {p50:?}, p99 {p99:?}", latencies.len());
+        }
+    }
+}
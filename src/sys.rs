@@ -1,8 +1,23 @@
-mod features;
+pub(crate) mod features;
 mod mel;
+mod buffer;
+mod input;
+#[cfg(test)]
+mod logits;
+#[cfg(test)]
+mod registry;
+#[cfg(test)]
+mod timestamps;
 mod whisper;
+#[cfg(test)]
+mod testing;
 
 //pub(crate) use tensor::Tensor;
 pub(crate) use features::Features;
 pub(crate) use mel::LogMelSpectrogram;
-pub use whisper::*;
\ No newline at end of file
+pub(crate) use buffer::{feature_memory, ChannelBuffers, FeatureBuffer, FeatureMemory};
+pub(crate) use input::{AudioEncoding, AudioInput};
+pub use input::Resampler;
+pub use whisper::*;
+#[cfg(test)]
+pub(crate) use testing::ffi::MockConfig;
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "tensorrt_llm/executor/executor.h"
+
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+namespace tle = tensorrt_llm::executor;
+
+// What Whisper needs from an executor: enqueue and cancel requests and drain
+// the responses of all requests. Implementations are thread-safe and call the
+// batched logits post-processor they were built with on every decode step.
+class ExecutorBackend {
+    public:
+        virtual ~ExecutorBackend() = default;
+
+        virtual tle::IdType enqueue(
+            const tle::Request& request
+        ) = 0;
+
+        // every ready response, waiting up to timeout for the first
+        virtual std::vector<tle::Response> await_responses(
+            const std::chrono::milliseconds timeout
+        ) = 0;
+
+        // stops decoding the request, which then gets its final response;
+        // ids that are already done are ignored
+        virtual void cancel(
+            const tle::IdType request_id
+        ) = 0;
+};
+
+// TensorRT-LLM's executor over an encoder-decoder engine.
+class TrtllmBackend : public ExecutorBackend {
+    public:
+        TrtllmBackend(
+            const std::filesystem::path& model_path,
+            const tle::ExecutorConfig& config
+        ) : executor_(
+                model_path / "encoder",
+                model_path / "decoder",
+                tle::ModelType::kENCODER_DECODER,
+                config
+            ) {}
+
+        tle::IdType enqueue(
+            const tle::Request& request
+        ) override {
+            return executor_.enqueueRequest(request);
+        }
+
+        std::vector<tle::Response> await_responses(
+            const std::chrono::milliseconds timeout
+        ) override {
+            return executor_.awaitResponses(timeout);
+        }
+
+        void cancel(
+            const tle::IdType request_id
+        ) override {
+            executor_.cancelRequest(request_id);
+        }
+
+    private:
+        tle::Executor executor_;
+};
@@ -1,86 +1,272 @@
-#include "whisper-trtllm-rs/src/sys/buffer.h"
+#include "whisper-trtllm-rs/src/sys/buffer.rs.h"
 
 #include <algorithm>
+#include <stdexcept>
 
 FeatureBuffer::FeatureBuffer(
-    const LogMelSpectrogram logMel
-) : mBuffer(torch::empty({0, logMel.nMels()})),
-    mPrev(std::vector<float>()),
-    mExtractor(logMel),
-    mNOverlapFrames(0)
-{
-    mNMaxOverlapFrames = (mExtractor.nFFT() / 2 + mExtractor.hopLength() - 1) / mExtractor.hopLength();
-    mPrev.reserve(mNMaxOverlapFrames * mExtractor.hopLength() + mExtractor.nFFT() / 2);
-}
-
-FeatureBuffer::FeatureBuffer(
-    std::filesystem::path const& melFilterPath,
-    torch::Device const& device,
-    const int nMels,
-    const int nFFT,
-    const int hopLength
-) : FeatureBuffer(
-    LogMelSpectrogram(melFilterPath, device, nMels, nFFT, hopLength)
-) {
+    const LogMelSpectrogram& logMel,
+    const size_t capacity
+) : mStream(logMel),
+    mFrames(
+        capacity,
+        logMel.n_mels(),
+        torch::TensorOptions().dtype(torch::kFloat32).device(logMel.device())
+    ),
+    mMaxima(N_FRAMES),
+    mVoice(logMel.n_mels()),
+    mSlabs(
+        N_FRAMES,
+        logMel.n_mels(),
+        torch::TensorOptions().dtype(torch::kFloat16).device(logMel.device())
+    ) {
 }
 
 size_t FeatureBuffer::nMels() const {
-    return mExtractor.nMels();
+    return mStream.extractor().n_mels();
 }
 
 size_t FeatureBuffer::nFFT() const {
-    return mExtractor.nFFT();
+    return mStream.extractor().n_fft();
 }
 
 size_t FeatureBuffer::hopLength() const {
-    return mExtractor.hopLength();
+    return mStream.extractor().hop_length();
+}
+
+torch::Tensor FeatureBuffer::getFeatures(const size_t amt) {
+    auto [frames, max] = window(amt);
+    return mStream.extractor().normalize(frames, max);
+}
+
+torch::Tensor FeatureBuffer::encoderInput(const size_t amt) {
+    unpark();
+    auto [frames, max] = window(std::min(amt, N_FRAMES));
+    const int64_t n = frames.size(0);
+
+    auto slab = mSlabs.acquire();
+    mStream.extractor().normalize(frames, max, slab.slice(0, 0, n));
+    if (n < slab.size(0)) {
+        slab.slice(0, n).fill_(PAD_VALUE);
+    }
+    return slab;
 }
 
-torch::Tensor FeatureBuffer::getFeatures(const size_t amt) const {
-    if (mBuffer.size(0) >= amt) {
-        return mBuffer.slice(0, 0, amt);
-    } else {
-        auto padTo = (amt - mBuffer.size(0)) * hopLength();
-        auto features = mExtractor.extract(mPrev, std::nullopt, padTo).transpose(0, 1);
-        if (mPrev.size() > 0) {
-            features = features.slice(0, mNOverlapFrames);
+std::pair<torch::Tensor, float> FeatureBuffer::window(const size_t amt) {
+    sync();
+    const size_t buffered = len();
+    auto head = [&](const size_t n) {
+        if (mIsParked && n > 0) {
+            return mParked.load(0, n, mStream.extractor().device());
         }
-        return torch::cat({mBuffer, features}, 0);
+        return mFrames.frames(0, n);
+    };
+
+    if (buffered >= amt || mStream.is_flushed()) {
+        auto n = std::min(amt, buffered);
+        return {head(n), mMaxima.max(n)};
     }
+
+    // peek at the tail as if the stream ended here, without flushing it
+    LogMelStream stream(mStream);
+    auto tail = stream.flush().slice(0, 0, amt - buffered);
+    auto max = mMaxima.max(buffered);
+    if (tail.size(0) > 0) {
+        max = std::max(max, tail.max().item<float>());
+    }
+    return {torch::cat({head(buffered), tail}, 0), max};
 }
 
 void FeatureBuffer::append(
     const std::span<const float> samples
 ) {
-    auto nSamples = mPrev.size() + samples.size();
-    size_t nFrames = 0;
-    if (nSamples + hopLength() > nFFT() / 2) {
-        nFrames = (nSamples + hopLength() - nFFT() / 2) / hopLength();
-    }
-    auto nTail = nSamples - nFrames * hopLength();
-
-    auto features = mExtractor.extract(mPrev, samples).transpose(0, 1).slice(0, mNOverlapFrames, nFrames);
-    mBuffer = torch::cat({mBuffer, features}, 0);
-
-    mNOverlapFrames = std::min(nFrames, mNMaxOverlapFrames);
-    auto n = mNOverlapFrames * hopLength() + nTail;
-    if (n <= samples.size()) {
-        mPrev.resize(n);
-        std::copy(samples.end() - n, samples.end(), mPrev.begin());
-    } else {
-        auto m = n - samples.size();
-        if (m <= mPrev.size()) {
-            std::copy(mPrev.end() - m, mPrev.end(), mPrev.begin());
-            mPrev.resize(n);
-            std::copy(samples.begin(), samples.end(), mPrev.begin() + m);
-        } else {
-            mPrev.insert(mPrev.end(), samples.begin(), samples.end());
-        }
+    unpark();
+    push(mStream.push(samples));
+}
+
+void FeatureBuffer::appendBatch(
+    const std::vector<FeatureBuffer*>& buffers,
+    const std::vector<std::span<const float>>& samples
+) {
+    std::vector<LogMelStream*> streams;
+    streams.reserve(buffers.size());
+    for (auto buffer : buffers) {
+        buffer->unpark();
+        streams.push_back(&buffer->mStream);
+    }
+
+    auto frames = LogMelStream::push_batch(streams, samples);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        buffers[i]->push(frames[i]);
+    }
+}
+
+void FeatureBuffer::finish() {
+    unpark();
+    push(mStream.flush());
+}
+
+void FeatureBuffer::push(const torch::Tensor& frames) {
+    if (frames.size(0) == 0) {
+        return;
+    }
+    mFrames.push(frames);
+
+    // stays on the device until something reads it, so appending never
+    // waits for the extraction
+    mPending.push_back(torch::cat({frames.amax(1, true), mVoice.statistics(frames)}, 1));
+}
+
+void FeatureBuffer::sync() {
+    if (mPending.empty()) {
+        return;
+    }
+    auto pending = mPending.size() == 1 ? mPending.front() : torch::cat(mPending, 0);
+    mPending.clear();
+
+    auto stats = pending.to(torch::kCPU).contiguous();
+    auto data = stats.data_ptr<float>();
+    const int64_t width = stats.size(1);
+    for (int64_t i = 0; i < stats.size(0); i++) {
+        auto row = data + i * width;
+        mMaxima.push(row[0]);
+        mVoice.push(FrameStatistics{row[1], row[2], row[3], row[4]});
     }
 }
 
 void FeatureBuffer::consume(
     const size_t amt
 ) {
-    mBuffer = mBuffer.slice(0, amt);
-}
\ No newline at end of file
+    unpark();
+    sync();
+    mFrames.consume(amt);
+    mMaxima.consume(amt);
+    mVoice.consume(amt);
+}
+
+std::vector<std::pair<size_t, size_t>> FeatureBuffer::speechSpans() {
+    sync();
+    return mVoice.spans();
+}
+
+size_t FeatureBuffer::skipNonSpeech() {
+    sync();
+    const size_t n = mVoice.leading_non_speech(isFinished());
+    if (n > 0) {
+        consume(n);
+    }
+    return n;
+}
+
+rust::Vec<SpeechSpan> FeatureBuffer::speech_spans() {
+    rust::Vec<SpeechSpan> spans;
+    for (auto [begin, end] : speechSpans()) {
+        spans.push_back(SpeechSpan{begin, end});
+    }
+    return spans;
+}
+
+void FeatureBuffer::park(const bool quantize) {
+    if (mIsParked) {
+        return;
+    }
+    // nothing of the session is left on the device
+    sync();
+    mParked.store(mFrames.frames(0, mFrames.len()), quantize);
+    mFrames.release();
+    mSlabs.release();
+    mIsParked = true;
+}
+
+void FeatureBuffer::unpark() {
+    if (!mIsParked) {
+        return;
+    }
+    mIsParked = false;
+    if (mParked.len() > 0) {
+        mFrames.push(mParked.load(0, mParked.len(), mStream.extractor().device()));
+    }
+    mParked.clear();
+}
+
+FeatureMemory FeatureBuffer::memory() const {
+    return FeatureMemory{
+        mFrames.bytes() + mSlabs.bytes(),
+        mParked.bytes(),
+    };
+}
+
+ChannelBuffers::ChannelBuffers(
+    const LogMelSpectrogram& logMel,
+    const size_t channels
+) : mChannels(channels) {
+    if (channels == 0) {
+        throw std::invalid_argument("at least one channel is required");
+    }
+    mBuffers.reserve(channels);
+    for (size_t i = 0; i < channels; i++) {
+        mBuffers.push_back(std::make_unique<FeatureBuffer>(logMel));
+    }
+}
+
+const FeatureBuffer& ChannelBuffers::channel(const size_t index) const {
+    if (index >= mBuffers.size()) {
+        throw std::out_of_range("channel index out of range");
+    }
+    return *mBuffers[index];
+}
+
+FeatureBuffer& ChannelBuffers::channelMut(const size_t index) {
+    if (index >= mBuffers.size()) {
+        throw std::out_of_range("channel index out of range");
+    }
+    return *mBuffers[index];
+}
+
+void ChannelBuffers::appendInterleaved(const std::span<const float> samples) {
+    const size_t channels = mBuffers.size();
+    const size_t carried = mPartial.size();
+    const size_t n = (carried + samples.size()) / channels;
+
+    auto at = [&](const size_t i) {
+        return i < carried ? mPartial[i] : samples[i - carried];
+    };
+    for (size_t c = 0; c < channels; c++) {
+        auto& channel = mChannels[c];
+        channel.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            channel[i] = at(i * channels + c);
+        }
+    }
+
+    std::vector<float> rest;
+    for (size_t i = n * channels; i < carried + samples.size(); i++) {
+        rest.push_back(at(i));
+    }
+    mPartial = std::move(rest);
+
+    std::vector<FeatureBuffer*> buffers;
+    std::vector<std::span<const float>> spans;
+    buffers.reserve(channels);
+    spans.reserve(channels);
+    for (size_t c = 0; c < channels; c++) {
+        buffers.push_back(mBuffers[c].get());
+        spans.emplace_back(mChannels[c].data(), n);
+    }
+    FeatureBuffer::appendBatch(buffers, spans);
+}
+
+void ChannelBuffers::finish() {
+    // an incomplete last sample frame is dropped
+    mPartial.clear();
+    for (auto& buffer : mBuffers) {
+        buffer->finish();
+    }
+}
+
+FeatureMemory feature_memory() {
+    auto usage = tier_usage();
+    return FeatureMemory{
+        usage.active_bytes,
+        usage.parked_bytes,
+    };
+}
@@ -1,27 +1,37 @@
 #pragma once
 
 #include "whisper-trtllm-rs/src/sys/mel.h"
+#include "whisper-trtllm-rs/src/sys/stream.h"
+#include "whisper-trtllm-rs/src/sys/ring.h"
+#include "whisper-trtllm-rs/src/sys/running_max.h"
+#include "whisper-trtllm-rs/src/sys/slab.h"
+#include "whisper-trtllm-rs/src/sys/tier.h"
+#include "whisper-trtllm-rs/src/sys/vad.h"
 #include "whisper-trtllm-rs/src/sys/features.h"
 
 #include "rust/cxx.h"
 
 #include <torch/torch.h>
-#include <filesystem>
 #include <span>
 #include <memory>
+#include <utility>
+#include <vector>
 
+// frames in one 30 s encoder window
+const size_t N_FRAMES = 3000;
+
+struct FeatureMemory;
+struct SpeechSpan;
+
+// Buffers raw log10 mel frames of one stream. Whisper's dynamic range clamp is
+// applied when getFeatures() builds an encoder input, relative to the maximum
+// of that window, so the result does not depend on how the audio was chunked
+// and frames are computed once however often overlapping windows are read.
 class FeatureBuffer {
     public:
         FeatureBuffer(
-            const LogMelSpectrogram logMel
-        );
-
-        FeatureBuffer(
-            std::filesystem::path const& melFilterPath,
-            torch::Device const& device = torch::kCUDA,
-            const int nMels = N_MELS,
-            const int nFFT = N_FFT,
-            const int hopLength = HOP_LENGTH
+            const LogMelSpectrogram& logMel,
+            const size_t capacity = 2 * N_FRAMES
         );
 
         size_t nMels() const;
@@ -31,26 +41,76 @@ class FeatureBuffer {
         size_t hopLength() const;
 
         size_t len() const {
-            return mBuffer.size(0);
+            return mIsParked ? mParked.len() : mFrames.len();
         }
 
         bool isEmpty() const {
-            return (mBuffer.size(0) == 0 && mPrev.size() <= mNOverlapFrames * mExtractor.hopLength());
+            return len() == 0 && (mStream.is_flushed() || mStream.n_samples() == 0);
+        }
+
+        bool isFinished() const {
+            return mStream.is_flushed();
         }
 
-        torch::Tensor getFeatures(const size_t amt) const;
+        // The first amt frames normalized as one window.
+        torch::Tensor getFeatures(const size_t amt);
+
+        // The first min(amt, N_FRAMES) frames normalized straight into a
+        // pooled [N_FRAMES, n_mels] slab, the rest of it set to PAD_VALUE.
+        // The slab is reused once every reference to it has been dropped.
+        torch::Tensor encoderInput(const size_t amt);
 
         void append(
             const std::span<const float> samples
         );
 
+        // append() on several buffers of the same extractor configuration,
+        // with one batched extraction for all of them.
+        static void appendBatch(
+            const std::vector<FeatureBuffer*>& buffers,
+            const std::vector<std::span<const float>>& samples
+        );
+
+        void finish();
+
         void consume(const size_t amt);
 
+        // Speech spans [begin, end) over the buffered frames; the last one may
+        // still grow until the stream is finished.
+        std::vector<std::pair<size_t, size_t>> speechSpans();
+
+        // Consumes the frames in front of the next speech that no later audio
+        // can turn into speech, and returns how many were dropped.
+        size_t skipNonSpeech();
+
+        // Moves the buffered frames to host memory (int8 with a per-frame
+        // scale when quantize is set) and frees their device storage, for
+        // sessions that go idle. Reads still work while parked; appending,
+        // consuming or building an encoder input promotes the frames back.
+        void park(const bool quantize = false);
+
+        void unpark();
+
+        bool isParked() const {
+            return mIsParked;
+        }
+
+        // rust ffi: bytes this buffer holds per storage tier
+        FeatureMemory memory() const;
+
         // rust ffi
-        inline std::unique_ptr<Features> features(const size_t amt) const {
+        rust::Vec<SpeechSpan> speech_spans();
+
+        // rust ffi
+        inline std::unique_ptr<Features> features(const size_t amt) {
             return std::make_unique<Features>(getFeatures(amt));
         }
 
+        // rust ffi
+        inline std::unique_ptr<Features> encoder_input(const size_t amt) {
+            return std::make_unique<Features>(encoderInput(amt));
+        }
+
         // rust ffi
         inline void append(
             const rust::Slice<const float> samples
@@ -58,23 +118,92 @@ class FeatureBuffer {
             append(std::span<const float>(samples.data(), samples.size()));
         }
 
+    private:
+        void push(const torch::Tensor& frames);
+
+        // Brings the statistics of pushed frames to the host, in one copy,
+        // before the maxima or speech decisions are read or consumed.
+        void sync();
+
+        // raw frames [0, amt) and their maximum
+        std::pair<torch::Tensor, float> window(const size_t amt);
+
+        LogMelStream mStream;
+
+        FeatureRing mFrames;
+
+        // [n, 1 + N_STATISTICS] per-frame maxima and voice statistics of
+        // the frames pushed since the last sync(), still on the device
+        std::vector<torch::Tensor> mPending;
+
+        // per-frame maxima of mFrames, windowed over N_FRAMES; with mVoice
+        // a host cache filled by sync()
+        RunningMax mMaxima;
+
+        // speech decisions for the frames of mFrames
+        VoiceActivity mVoice;
+
+        SlabPool mSlabs;
+
+        ParkedFrames mParked;
+
+        bool mIsParked = false;
+};
+
+// One FeatureBuffer per channel of an interleaved multi-channel stream, e.g.
+// the agent and customer sides of a stereo call. Appends de-interleave the
+// samples and extract the new frames of every channel in one batched call.
+class ChannelBuffers {
+    public:
+        ChannelBuffers(
+            const LogMelSpectrogram& logMel,
+            const size_t channels
+        );
+
+        size_t channels() const {
+            return mBuffers.size();
+        }
+
+        const FeatureBuffer& channel(const size_t index) const;
+
+        FeatureBuffer& channelMut(const size_t index);
+
+        // Interleaved samples; a trailing partial sample frame is kept until
+        // the rest of it arrives.
+        void appendInterleaved(const std::span<const float> samples);
+
+        void finish();
+
+        // rust ffi
+        inline void append_interleaved(
+            const rust::Slice<const float> samples
+        ) {
+            appendInterleaved(std::span<const float>(samples.data(), samples.size()));
+        }
 
     private:
-        LogMelSpectrogram mExtractor;
+        std::vector<std::unique_ptr<FeatureBuffer>> mBuffers;
 
-        torch::Tensor mBuffer;
+        // de-interleaved samples of the current append, per channel
+        std::vector<std::vector<float>> mChannels;
 
-        std::vector<float> mPrev;
-        size_t mNOverlapFrames;
-        size_t mNMaxOverlapFrames;        
+        std::vector<float> mPartial;
 };
 
+// rust ffi: bytes all feature buffers of the process hold per storage tier
+FeatureMemory feature_memory();
+
 // rust ffi
 inline std::unique_ptr<FeatureBuffer> feature_buffer(
-    const rust::Str mel_filter_path
+    const LogMelSpectrogram& extractor
+) {
+    return std::make_unique<FeatureBuffer>(extractor);
+}
+
+// rust ffi
+inline std::unique_ptr<ChannelBuffers> channel_buffers(
+    const LogMelSpectrogram& extractor,
+    const size_t channels
 ) {
-    auto path = std::filesystem::path(static_cast<std::string>(mel_filter_path));
-    return std::make_unique<FeatureBuffer>(
-        path
-    );
-}
\ No newline at end of file
+    return std::make_unique<ChannelBuffers>(extractor, channels);
+}
@@ -1,21 +1,40 @@
 use cxx::UniquePtr;
 
-use std::path::Path;
 use anyhow::{anyhow, Result};
+use std::pin::Pin;
 
 use super::features::{self, Features};
+use super::mel::{self, LogMelSpectrogram};
+
+pub(crate) use ffi::{FeatureMemory, SpeechSpan};
 
 #[cxx::bridge]
-mod ffi {
+pub(crate) mod ffi {
+    /// Bytes of feature storage per tier: active frames sit on the extractor
+    /// device, parked frames are host copies of idle sessions.
+    #[derive(Copy, Clone, Debug, Default)]
+    struct FeatureMemory {
+        active_bytes: usize,
+        parked_bytes: usize,
+    }
+
+    /// Frames [begin, end) of a buffer that hold speech.
+    #[derive(Copy, Clone, Debug, PartialEq, Eq)]
+    struct SpeechSpan {
+        begin: usize,
+        end: usize,
+    }
+
     unsafe extern "C++" {
         type Features = super::features::ffi::Features;
+        type LogMelSpectrogram = super::mel::ffi::LogMelSpectrogram;
         
         include!("whisper-trtllm-rs/src/sys/buffer.h");
 
         type FeatureBuffer;
 
         fn feature_buffer(
-            mel_filter_path: &str,
+            extractor: &LogMelSpectrogram,
         ) -> Result<UniquePtr<FeatureBuffer>>;
 
         fn len(self: &FeatureBuffer) -> usize;
@@ -23,20 +42,84 @@ mod ffi {
         #[rust_name = "is_empty"]
         fn isEmpty(self: &FeatureBuffer) -> bool;
 
+        #[rust_name = "is_finished"]
+        fn isFinished(self: &FeatureBuffer) -> bool;
+
         fn features(
-            self: &FeatureBuffer, 
+            self: Pin<&mut FeatureBuffer>,
+            amt: usize
+        ) -> Result<UniquePtr<Features>>;
+
+        fn encoder_input(
+            self: Pin<&mut FeatureBuffer>,
             amt: usize
-        ) -> UniquePtr<Features>;
+        ) -> Result<UniquePtr<Features>>;
 
         fn append(
             self: Pin<&mut FeatureBuffer>,
             samples: &[f32],
         ) -> Result<()>;
 
+        fn finish(
+            self: Pin<&mut FeatureBuffer>,
+        ) -> Result<()>;
+
         fn consume(
             self: Pin<&mut FeatureBuffer>,
             amt: usize,
         ) -> Result<()>;
+
+        fn speech_spans(self: Pin<&mut FeatureBuffer>) -> Vec<SpeechSpan>;
+
+        #[rust_name = "skip_non_speech"]
+        fn skipNonSpeech(
+            self: Pin<&mut FeatureBuffer>,
+        ) -> Result<usize>;
+
+        fn park(
+            self: Pin<&mut FeatureBuffer>,
+            quantize: bool,
+        ) -> Result<()>;
+
+        fn unpark(
+            self: Pin<&mut FeatureBuffer>,
+        ) -> Result<()>;
+
+        #[rust_name = "is_parked"]
+        fn isParked(self: &FeatureBuffer) -> bool;
+
+        fn memory(self: &FeatureBuffer) -> FeatureMemory;
+
+        type ChannelBuffers;
+
+        fn channel_buffers(
+            extractor: &LogMelSpectrogram,
+            channels: usize,
+        ) -> Result<UniquePtr<ChannelBuffers>>;
+
+        fn channels(self: &ChannelBuffers) -> usize;
+
+        fn channel(
+            self: &ChannelBuffers,
+            index: usize,
+        ) -> Result<&FeatureBuffer>;
+
+        #[rust_name = "channel_mut"]
+        fn channelMut(
+            self: Pin<&mut ChannelBuffers>,
+            index: usize,
+        ) -> Result<Pin<&mut FeatureBuffer>>;
+
+        fn append_interleaved(
+            self: Pin<&mut ChannelBuffers>,
+            samples: &[f32],
+        ) -> Result<()>;
+
+        fn finish(
+            self: Pin<&mut ChannelBuffers>,
+        ) -> Result<()>;
+
+        fn feature_memory() -> FeatureMemory;
     }
 }
 
@@ -45,15 +128,17 @@ pub(crate) struct FeatureBuffer {
 }
 
 impl FeatureBuffer {
-    pub fn open<P: AsRef<Path>>(mel_filter_path: P) -> Result<Self> {
-        let mel_filter_path = mel_filter_path.as_ref();
-        let path = mel_filter_path.to_str().ok_or_else(|| anyhow!("invalid path: {}", mel_filter_path.display()))?;
-        let ptr = ffi::feature_buffer(path)
+    pub fn new(extractor: &LogMelSpectrogram) -> Result<Self> {
+        let ptr = ffi::feature_buffer(extractor.inner())
             .map_err(|e| anyhow!("failed to create feature buffer: {}", e))?;
 
         Ok(Self { ptr })
     }
 
+    pub(crate) fn inner_mut(&mut self) -> Pin<&mut ffi::FeatureBuffer> {
+        self.ptr.pin_mut()
+    }
+
     pub fn len(&self) -> usize {
         self.ptr.len()
     }
@@ -62,29 +147,481 @@ impl FeatureBuffer {
         self.ptr.is_empty()
     }
 
-    pub fn features(&self, amt: usize) -> Features {
-        Features::new(self.ptr.features(amt))
+    pub fn is_finished(&self) -> bool {
+        self.ptr.is_finished()
+    }
+
+    pub fn features(&mut self, amt: usize) -> Result<Features> {
+        let ptr = self.ptr.pin_mut().features(amt)
+            .map_err(|e| anyhow!("failed to get features: {}", e))?;
+        Ok(ptr.into())
+    }
+
+    /// The first `amt` frames (at most one window) in a pooled, padded
+    /// encoder input of `N_FRAMES` frames.
+    pub fn encoder_input(&mut self, amt: usize) -> Result<Features> {
+        let ptr = self.ptr.pin_mut().encoder_input(amt)
+            .map_err(|e| anyhow!("failed to get encoder input: {}", e))?;
+        Ok(ptr.into())
     }
 
     pub fn append(&mut self, samples: &[f32]) -> Result<()> {
         self.ptr.pin_mut().append(samples).map_err(|e| anyhow!("failed to append samples: {}", e))
     }
 
+    pub fn finish(&mut self) -> Result<()> {
+        self.ptr.pin_mut().finish().map_err(|e| anyhow!("failed to finish feature buffer: {}", e))
+    }
+
     pub fn consume(&mut self, amt: usize) -> Result<()> {
         self.ptr.pin_mut().consume(amt).map_err(|e| anyhow!("failed to consume features: {}", e))
     }
+
+    /// Speech spans over the buffered frames, from the frame-level voice
+    /// activity detector.
+    pub fn speech_spans(&mut self) -> Vec<SpeechSpan> {
+        self.ptr.pin_mut().speech_spans()
+    }
+
+    /// Consumes the non-speech frames in front of the next speech that no
+    /// later audio can change, returning their count.
+    pub fn skip_non_speech(&mut self) -> Result<usize> {
+        self.ptr.pin_mut().skip_non_speech()
+            .map_err(|e| anyhow!("failed to skip non-speech: {}", e))
+    }
+
+    /// Moves the frames to host memory, optionally int8 quantized, until
+    /// the buffer is appended to or consumed again.
+    pub fn park(&mut self, quantize: bool) -> Result<()> {
+        self.ptr.pin_mut().park(quantize).map_err(|e| anyhow!("failed to park feature buffer: {}", e))
+    }
+
+    pub fn unpark(&mut self) -> Result<()> {
+        self.ptr.pin_mut().unpark().map_err(|e| anyhow!("failed to unpark feature buffer: {}", e))
+    }
+
+    pub fn is_parked(&self) -> bool {
+        self.ptr.is_parked()
+    }
+
+    pub fn memory(&self) -> FeatureMemory {
+        self.ptr.memory()
+    }
+}
+
+/// Feature storage held by all buffers of the process, per tier.
+pub(crate) fn feature_memory() -> FeatureMemory {
+    ffi::feature_memory()
 }
 
 unsafe impl Send for FeatureBuffer {}
 unsafe impl Sync for FeatureBuffer {}
 
+/// Feature buffers for the channels of an interleaved multi-channel stream,
+/// filled by one batched extraction per append.
+pub(crate) struct ChannelBuffers {
+    ptr: UniquePtr<ffi::ChannelBuffers>,
+}
+
+impl ChannelBuffers {
+    pub fn new(extractor: &LogMelSpectrogram, channels: usize) -> Result<Self> {
+        let ptr = ffi::channel_buffers(extractor.inner(), channels)
+            .map_err(|e| anyhow!("failed to create channel buffers: {}", e))?;
+
+        Ok(Self { ptr })
+    }
+
+    pub fn channels(&self) -> usize {
+        self.ptr.channels()
+    }
+
+    fn channel(&self, index: usize) -> Result<&ffi::FeatureBuffer> {
+        self.ptr.channel(index).map_err(|e| anyhow!("failed to get channel {index}: {}", e))
+    }
+
+    fn channel_mut(&mut self, index: usize) -> Result<Pin<&mut ffi::FeatureBuffer>> {
+        self.ptr.pin_mut().channel_mut(index).map_err(|e| anyhow!("failed to get channel {index}: {}", e))
+    }
+
+    pub fn append_interleaved(&mut self, samples: &[f32]) -> Result<()> {
+        self.ptr.pin_mut().append_interleaved(samples)
+            .map_err(|e| anyhow!("failed to append interleaved samples: {}", e))
+    }
+
+    pub fn finish(&mut self) -> Result<()> {
+        self.ptr.pin_mut().finish().map_err(|e| anyhow!("failed to finish channel buffers: {}", e))
+    }
+
+    pub fn len(&self, channel: usize) -> Result<usize> {
+        Ok(self.channel(channel)?.len())
+    }
+
+    pub fn features(&mut self, channel: usize, amt: usize) -> Result<Features> {
+        let ptr = self.channel_mut(channel)?.features(amt)
+            .map_err(|e| anyhow!("failed to get features: {}", e))?;
+        Ok(ptr.into())
+    }
+
+    pub fn encoder_input(&mut self, channel: usize, amt: usize) -> Result<Features> {
+        let ptr = self.channel_mut(channel)?.encoder_input(amt)
+            .map_err(|e| anyhow!("failed to get encoder input: {}", e))?;
+        Ok(ptr.into())
+    }
+
+    pub fn consume(&mut self, channel: usize, amt: usize) -> Result<()> {
+        self.channel_mut(channel)?.consume(amt)
+            .map_err(|e| anyhow!("failed to consume features: {}", e))
+    }
+
+    pub fn speech_spans(&mut self, channel: usize) -> Result<Vec<SpeechSpan>> {
+        Ok(self.channel_mut(channel)?.speech_spans())
+    }
+
+    pub fn skip_non_speech(&mut self, channel: usize) -> Result<usize> {
+        self.channel_mut(channel)?.skip_non_speech()
+            .map_err(|e| anyhow!("failed to skip non-speech: {}", e))
+    }
+}
+
+unsafe impl Send for ChannelBuffers {}
+unsafe impl Sync for ChannelBuffers {}
+
 #[cfg(test)]
 mod tests {
-    use super::{Features, FeatureBuffer};
+    use super::{ChannelBuffers, FeatureBuffer, LogMelSpectrogram};
+    use crate::sys::testing::ffi::{feature_ring_errors, voice_activity_errors};
+
+    fn extractor() -> LogMelSpectrogram {
+        LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap()
+    }
 
     #[test]
     fn test_features_buffer() {
-        let mut buffer = FeatureBuffer::open("models/whisper_turbo/mel_filters.npz").unwrap();
+        let extractor = extractor();
+        let buffer = FeatureBuffer::new(&extractor).unwrap();
         assert_eq!(buffer.len(), 0); 
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn test_feature_ring_wraps_and_grows() {
+        for capacity in [1, 2, 7, 64] {
+            assert_eq!(feature_ring_errors(capacity), 0, "capacity {capacity}");
+        }
+    }
+
+    #[test]
+    fn test_voice_activity() {
+        assert_eq!(voice_activity_errors(), 0);
+    }
+
+    #[test]
+    fn test_streaming_frame_count() {
+        let extractor = extractor();
+        let audio: Vec<f32> = (0..123_457).map(|i| ((i * 7919) % 1000) as f32 / 1000.0 - 0.5).collect();
+
+        let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+        for chunk in audio.chunks(3_331) {
+            buffer.append(chunk).unwrap();
+        }
+        assert_eq!(buffer.len(), extractor.extract(&audio, &[]).unwrap().len());
+
+        buffer.finish().unwrap();
+        assert_eq!(buffer.len(), extractor.extract_final(&audio, &[]).unwrap().len());
+    }
+
+    #[test]
+    fn test_streaming_matches_one_shot() {
+        let extractor = extractor();
+        let audio: Vec<f32> = (0..56_007).map(|i| {
+            0.4 * (i as f32 * 0.031).sin() + ((i * 7919) % 1000) as f32 / 10_000.0
+        }).collect();
+        let expected = extractor.extract(&audio, &[]).unwrap().to_vec();
+        let expected_final = extractor.extract_final(&audio, &[]).unwrap().to_vec();
+
+        // chunk boundaries on and off the 160-sample hop
+        for chunk in [7, 159, 160, 161, 3_331, audio.len()] {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            for samples in audio.chunks(chunk) {
+                buffer.append(samples).unwrap();
+            }
+            let streamed = buffer.features(buffer.len()).unwrap().to_vec();
+            assert!(max_diff(&expected, &streamed) < 1e-3, "chunk {chunk}");
+
+            buffer.finish().unwrap();
+            let streamed = buffer.features(buffer.len()).unwrap().to_vec();
+            assert!(max_diff(&expected_final, &streamed) < 1e-3, "chunk {chunk}, finished");
+        }
+    }
+
+    #[test]
+    fn test_channels_match_mono_buffers() {
+        let extractor = extractor();
+        let left: Vec<f32> = (0..5 * 16000).map(|i| ((i * 7919) % 1000) as f32 / 1000.0 - 0.5).collect();
+        let right: Vec<f32> = (0..5 * 16000).map(|i| 0.3 * (i as f32 * 0.05).sin()).collect();
+        let interleaved: Vec<f32> = left.iter().zip(right.iter()).flat_map(|(l, r)| [*l, *r]).collect();
+
+        let mono = |audio: &[f32]| {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            buffer.append(audio).unwrap();
+            buffer.finish().unwrap();
+            buffer.features(buffer.len()).unwrap().to_vec()
+        };
+        let expected = [mono(&left), mono(&right)];
+
+        // odd chunks split sample frames between appends
+        for chunk in [1_001, 32_000, interleaved.len()] {
+            let mut buffers = ChannelBuffers::new(&extractor, 2).unwrap();
+            for samples in interleaved.chunks(chunk) {
+                buffers.append_interleaved(samples).unwrap();
+            }
+            buffers.finish().unwrap();
+            for channel in 0..2 {
+                let n = buffers.len(channel).unwrap();
+                assert_eq!(buffers.features(channel, n).unwrap().to_vec(), expected[channel], "chunk {chunk} channel {channel}");
+            }
+        }
+    }
+
+    fn max_diff(a: &[f32], b: &[f32]) -> f32 {
+        assert_eq!(a.len(), b.len());
+        a.iter().zip(b.iter()).map(|(x, y)| (x - y).abs()).fold(0.0f32, f32::max)
+    }
+
+    #[test]
+    fn test_window_normalization_ignores_chunking() {
+        let extractor = extractor();
+        let audio: Vec<f32> = (0..45 * 16000).map(|i| {
+            let loud = if (i / 16000) % 10 == 3 { 1.0 } else { 0.05 };
+            loud * ((i * 7919) % 1000) as f32 / 1000.0 - 0.5 * loud
+        }).collect();
+
+        let read = |chunk: usize, skip: usize| {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            for samples in audio.chunks(chunk) {
+                buffer.append(samples).unwrap();
+            }
+            buffer.finish().unwrap();
+            buffer.consume(skip).unwrap();
+            buffer.features(3000).unwrap().to_vec()
+        };
+
+        for skip in [0, 1000, 1250] {
+            let reference = read(audio.len(), skip);
+            for chunk in [1_601, 16_000, 100_003] {
+                assert!(max_diff(&reference, &read(chunk, skip)) < 1e-3, "skip {skip} chunk {chunk}");
+            }
+        }
+
+        // a whole stream shorter than a window normalizes like one extraction
+        let short = &audio[..20 * 16000];
+        let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+        buffer.append(short).unwrap();
+        buffer.finish().unwrap();
+        let expected = extractor.extract_final(short, &[]).unwrap().to_vec();
+        assert!(max_diff(&expected, &buffer.features(buffer.len()).unwrap().to_vec()) < 1e-3);
+    }
+
+    #[test]
+    fn test_encoder_input_matches_padded_features() {
+        let extractor = extractor();
+        let audio: Vec<f32> = (0..7 * 16000).map(|i| ((i * 7919) % 1000) as f32 / 1000.0 - 0.5).collect();
+
+        let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+        buffer.append(&audio).unwrap();
+        buffer.finish().unwrap();
+
+        let n = buffer.len();
+        let expected = buffer.features(n).unwrap().pad(3000 - n).to_vec();
+        for _ in 0..3 {
+            let input = buffer.encoder_input(n).unwrap();
+            assert_eq!(input.len(), 3000);
+            assert_eq!(input.to_vec(), expected);
+        }
+    }
+
+    #[test]
+    fn test_park_round_trip() {
+        let extractor = extractor();
+        let audio: Vec<f32> = (0..40 * 16000).map(|i| ((i * 7919) % 1000) as f32 / 1000.0 - 0.5).collect();
+
+        for quantize in [false, true] {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            buffer.append(&audio).unwrap();
+            let expected = buffer.features(3000).unwrap().to_vec();
+            let active = buffer.memory();
+            assert!(active.active_bytes > 0 && active.parked_bytes == 0);
+
+            buffer.park(quantize).unwrap();
+            assert!(buffer.is_parked());
+            let parked = buffer.memory();
+            assert_eq!(parked.active_bytes, 0);
+            assert!(parked.parked_bytes > 0);
+            if quantize {
+                assert!(parked.parked_bytes < active.active_bytes / 3);
+            }
+
+            // reads are served from the host copy
+            let tolerance = if quantize { 1e-2 } else { 1e-3 };
+            assert!(max_diff(&expected, &buffer.features(3000).unwrap().to_vec()) < tolerance);
+
+            // appending promotes the frames back
+            buffer.append(&audio[..16000]).unwrap();
+            assert!(!buffer.is_parked());
+            assert_eq!(buffer.memory().parked_bytes, 0);
+            assert!(max_diff(&expected, &buffer.features(3000).unwrap().to_vec()) < tolerance);
+        }
+    }
+
+    // Synthetic VAD corpus, 16 kHz. Speech is a harmonic source at a gliding
+    // pitch shaped by three formants, in syllables with pauses; the rest are
+    // signals a window should be skipped for.
+    mod corpus {
+        use std::f64::consts::PI;
+
+        pub const RATE: usize = 16000;
+
+        pub struct Lcg(u64);
+
+        impl Lcg {
+            pub fn new(seed: u64) -> Self {
+                Self(seed)
+            }
+
+            pub fn next(&mut self) -> f64 {
+                self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+                (self.0 >> 11) as f64 / (1u64 << 53) as f64
+            }
+        }
+
+        fn scale(x: Vec<f64>, rms: f64) -> Vec<f32> {
+            let current = (x.iter().map(|v| v * v).sum::<f64>() / x.len() as f64).sqrt();
+            x.iter().map(|v| (v / current * rms) as f32).collect()
+        }
+
+        fn peak(x: Vec<f64>, amp: f64) -> Vec<f32> {
+            let current = x.iter().fold(0.0f64, |m, v| m.max(v.abs()));
+            x.iter().map(|v| (v / current * amp) as f32).collect()
+        }
+
+        pub fn silence(seconds: usize) -> Vec<f32> {
+            vec![0.0; seconds * RATE]
+        }
+
+        pub fn noise(seconds: usize, rms: f64, seed: u64) -> Vec<f32> {
+            let mut rng = Lcg::new(seed);
+            (0..seconds * RATE).map(|_| ((rng.next() * 2.0 - 1.0) * rms * 3f64.sqrt()) as f32).collect()
+        }
+
+        pub fn hum(seconds: usize, amp: f64) -> Vec<f32> {
+            let x = (0..seconds * RATE).map(|i| {
+                let t = i as f64 / RATE as f64;
+                (1..6).map(|k| (2.0 * PI * 50.0 * k as f64 * t).sin() / k as f64).sum()
+            }).collect();
+            peak(x, amp)
+        }
+
+        // major triads, one per half second, plucked
+        pub fn music(seconds: usize, amp: f64, roots: &[f64]) -> Vec<f32> {
+            let x = (0..seconds * RATE).map(|i| {
+                let t = i as f64 / RATE as f64;
+                let note = t % 0.5;
+                let root = roots[(t / 0.5) as usize % roots.len()];
+                let envelope = (note / 0.02).min(1.0) * (-note * 2.0).exp();
+                [1.0, 1.26, 1.5].iter().map(|r| (2.0 * PI * root * r * t).sin()).sum::<f64>() * envelope
+            }).collect();
+            peak(x, amp)
+        }
+
+        pub fn speech(seconds: usize, rms: f64, seed: u64) -> Vec<f32> {
+            let mut rng = Lcg::new(seed);
+            let n = seconds * RATE;
+            let mut out = vec![0.0f64; n];
+            let mut i = 0;
+            while i < n {
+                let duration = ((0.12 + 0.18 * rng.next()) * RATE as f64) as usize;
+                if rng.next() < 0.15 {
+                    i += ((0.1 + 0.3 * rng.next()) * RATE as f64) as usize;
+                    continue;
+                }
+                let f0 = 100.0 + 120.0 * rng.next();
+                let formants = [
+                    300.0 + 600.0 * rng.next(),
+                    900.0 + 1600.0 * rng.next(),
+                    2400.0 + 1100.0 * rng.next(),
+                ];
+                let harmonics: Vec<(f64, f64)> = (1..).map(|k| k as f64)
+                    .take_while(|k| k * f0 < 7500.0)
+                    .map(|k| {
+                        let gain: f64 = formants.iter().map(|f| 1.0 / (1.0 + ((k * f0 - f) / 80.0).powi(2))).sum();
+                        (k, (gain + 0.05) / k)
+                    })
+                    .collect();
+                for j in 0..duration.min(n - i) {
+                    let t = j as f64 / RATE as f64;
+                    // 3 Hz vibrato on the pitch
+                    let phase = 2.0 * PI * f0 * (t + 0.05 / (2.0 * PI * 3.0) * (1.0 - (2.0 * PI * 3.0 * t).cos()));
+                    let sample: f64 = harmonics.iter().map(|(k, a)| a * (k * phase).sin()).sum();
+                    out[i + j] = sample * (PI * j as f64 / duration as f64).sin();
+                }
+                i += duration;
+            }
+            scale(out, rms)
+        }
+
+        pub fn mix(a: Vec<f32>, b: Vec<f32>) -> Vec<f32> {
+            a.iter().zip(b.iter()).map(|(x, y)| x + y).collect()
+        }
+    }
+
+    #[test]
+    fn test_vad_corpus() {
+        use corpus::*;
+
+        let extractor = extractor();
+        let clips: Vec<(&str, Vec<f32>, bool)> = vec![
+            ("silence", silence(30), false),
+            ("white noise", noise(30, 0.02, 1), false),
+            ("mains hum", hum(30, 0.03), false),
+            ("music", music(30, 0.1, &[220.0, 247.0, 262.0, 294.0, 330.0, 349.0, 392.0]), false),
+            ("speech", speech(30, 0.1, 2), true),
+            ("quiet speech", speech(30, 0.01, 3), true),
+            ("speech over noise", mix(speech(30, 0.1, 4), noise(30, 0.01, 5)), true),
+            ("speech over music", mix(speech(30, 0.1, 6), music(30, 0.02, &[262.0, 330.0, 392.0])), true),
+            ("sparse speech", [silence(25), speech(3, 0.05, 7), silence(2)].concat(), true),
+        ];
+
+        let mut skipped_windows = 0;
+        for (name, audio, is_speech) in &clips {
+            // skip while streaming, as the transcription loop would
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            let mut skipped = 0;
+            for chunk in audio.chunks(RATE) {
+                buffer.append(chunk).unwrap();
+                skipped += buffer.skip_non_speech().unwrap();
+            }
+            buffer.finish().unwrap();
+            skipped += buffer.skip_non_speech().unwrap();
+
+            let total = skipped + buffer.len();
+            let spans = buffer.speech_spans();
+            let covered: usize = spans.iter().map(|s| s.end - s.begin).sum();
+
+            if *is_speech {
+                assert!(!spans.is_empty(), "{name}");
+                if *name == "sparse speech" {
+                    // only the silence before the speech can be skipped
+                    assert!(skipped >= 2400 && covered >= 300, "{name}");
+                } else {
+                    assert!(covered * 10 >= total * 9, "{name}");
+                }
+            } else {
+                assert_eq!(buffer.len(), 0, "{name}");
+                skipped_windows += 1;
+            }
+        }
+
+        // every clip without speech is skipped whole
+        let non_speech = clips.iter().filter(|(_, _, s)| !s).count();
+        assert_eq!(skipped_windows, non_speech);
+    }
+}
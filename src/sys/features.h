@@ -1,9 +1,15 @@
 #pragma once
 
+#include "rust/cxx.h"
+
 #include <torch/torch.h>
+#include <vector>
 
 const int64_t LENGTH_DIM = 0;
 
+// normalized value of silence, used to pad encoder inputs
+const float PAD_VALUE = -1.5f;
+
 class Features {
     public:
         Features(
@@ -33,7 +39,7 @@ class Features {
         ) const {
             auto tensor = torch::nn::functional::pad(
                 tensor_, 
-                torch::nn::functional::PadFuncOptions({0, 0, 0, padding}).mode(torch::kConstant).value(-1.5));
+                torch::nn::functional::PadFuncOptions({0, 0, 0, padding}).mode(torch::kConstant).value(PAD_VALUE));
             return std::make_unique<Features>(tensor);
         }
 
@@ -42,6 +48,17 @@ class Features {
             return std::make_unique<Features>(tensor);
         }
 
+        inline rust::Vec<float> to_vec() const {
+            auto tensor = tensor_.to(torch::kCPU, torch::kFloat32).contiguous();
+            auto data = tensor.data_ptr<float>();
+            rust::Vec<float> vec;
+            vec.reserve(tensor.numel());
+            for (int64_t i = 0; i < tensor.numel(); i++) {
+                vec.push_back(data[i]);
+            }
+            return vec;
+        }
+
         inline const torch::Tensor& tensor() const {
             return tensor_;
         }
@@ -54,6 +71,28 @@ class Features {
         torch::Tensor tensor_;
 };
 
+// Per-stream results of a batched extraction.
+class FeaturesBatch {
+    public:
+        FeaturesBatch(
+            std::vector<torch::Tensor> tensors
+        ): tensors_(std::move(tensors)) {
+        }
+
+        inline size_t len() const {
+            return tensors_.size();
+        }
+
+        inline std::unique_ptr<Features> get(
+            const size_t index
+        ) const {
+            return std::make_unique<Features>(tensors_.at(index));
+        }
+
+    private:
+        std::vector<torch::Tensor> tensors_;
+};
+
 //inline std::unique_ptr<Features> features() {
 //    auto tensor = torch::Tensor();
 //    return std::make_unique<Features>(tensor);
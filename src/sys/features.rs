@@ -22,6 +22,14 @@ pub(crate) mod ffi {
         fn pad(self: &Features, padding: usize) -> UniquePtr<Features>;
 
         fn join(self: &Features, other: &Features) -> UniquePtr<Features>;
+
+        fn to_vec(self: &Features) -> Vec<f32>;
+
+        type FeaturesBatch;
+
+        fn len(self: &FeaturesBatch) -> usize;
+
+        fn get(self: &FeaturesBatch, index: usize) -> Result<UniquePtr<Features>>;
     }
 }
 
@@ -74,6 +82,10 @@ impl Features {
     pub fn join(&self, other: &Self) -> Self {
         self.ptr.join(&other.ptr).into()
     }
+
+    pub fn to_vec(&self) -> Vec<f32> {
+        self.ptr.to_vec()
+    }
 }
 
 unsafe impl Send for Features {}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Mixed-radix complex FFT (decimation in time, kissfft-style recursion).
+// The plan is built once per transform size and is read-only afterwards, so a
+// single instance can be shared by every thread that runs frames in parallel.
+class FFTPlan {
+    public:
+        using Complex = std::complex<float>;
+
+        explicit FFTPlan(const size_t n) : n_(n), twiddles_(n) {
+            for (size_t i = 0; i < n; i++) {
+                auto phase = -2.0 * M_PI * static_cast<double>(i) / static_cast<double>(n);
+                twiddles_[i] = Complex(std::cos(phase), std::sin(phase));
+            }
+
+            // radix 4 first, then 2, then odd radices; whatever is left is a prime
+            size_t m = n;
+            size_t p = 4;
+            while (m > 1) {
+                while (m % p != 0) {
+                    p = p == 4 ? 2 : (p == 2 ? 3 : p + 2);
+                    if (p * p > m) {
+                        p = m;
+                    }
+                }
+                m /= p;
+                factors_.push_back(p);
+                factors_.push_back(m);
+            }
+        }
+
+        size_t size() const {
+            return n_;
+        }
+
+        // out must not alias in; both hold size() elements
+        void forward(const Complex* in, Complex* out) const {
+            work(out, in, 1, factors_.data());
+        }
+
+    private:
+        void work(Complex* out, const Complex* in, const size_t fstride, const size_t* factors) const {
+            const size_t p = factors[0];
+            const size_t m = factors[1];
+
+            if (m == 1) {
+                for (size_t j = 0; j < p; j++) {
+                    out[j] = in[j * fstride];
+                }
+            } else {
+                for (size_t j = 0; j < p; j++) {
+                    work(out + j * m, in + j * fstride, fstride * p, factors + 2);
+                }
+            }
+
+            switch (p) {
+                case 2: butterfly2(out, fstride, m); break;
+                case 4: butterfly4(out, fstride, m); break;
+                default: butterfly(out, fstride, m, p); break;
+            }
+        }
+
+        void butterfly2(Complex* out, const size_t fstride, const size_t m) const {
+            for (size_t u = 0; u < m; u++) {
+                auto t = out[u + m] * twiddles_[u * fstride];
+                out[u + m] = out[u] - t;
+                out[u] += t;
+            }
+        }
+
+        void butterfly4(Complex* out, const size_t fstride, const size_t m) const {
+            for (size_t u = 0; u < m; u++) {
+                auto s0 = out[u + m] * twiddles_[u * fstride];
+                auto s1 = out[u + 2 * m] * twiddles_[2 * u * fstride];
+                auto s2 = out[u + 3 * m] * twiddles_[3 * u * fstride];
+
+                auto s5 = out[u] - s1;
+                out[u] += s1;
+                auto s3 = s0 + s2;
+                auto s4 = s0 - s2;
+                // multiply by -i
+                s4 = Complex(s4.imag(), -s4.real());
+
+                out[u + 2 * m] = out[u] - s3;
+                out[u] += s3;
+                out[u + m] = s5 + s4;
+                out[u + 3 * m] = s5 - s4;
+            }
+        }
+
+        void butterfly(Complex* out, const size_t fstride, const size_t m, const size_t p) const {
+            Complex scratch[16];
+            std::vector<Complex> heap;
+            Complex* s = scratch;
+            if (p > 16) {
+                heap.resize(p);
+                s = heap.data();
+            }
+
+            for (size_t u = 0; u < m; u++) {
+                for (size_t q = 0; q < p; q++) {
+                    s[q] = out[u + q * m];
+                }
+                for (size_t q1 = 0; q1 < p; q1++) {
+                    const size_t k = u + q1 * m;
+                    size_t idx = 0;
+                    auto t = s[0];
+                    for (size_t q = 1; q < p; q++) {
+                        idx += fstride * k;
+                        if (idx >= n_) {
+                            idx %= n_;
+                        }
+                        t += s[q] * twiddles_[idx];
+                    }
+                    out[k] = t;
+                }
+            }
+        }
+
+        size_t n_;
+        std::vector<Complex> twiddles_;
+        std::vector<size_t> factors_;
+};
+
+// Real-input FFT of an even length N computed through an N/2 point complex
+// transform. N is a template parameter so the frame buffers live on the stack
+// and the untangling loop has constant bounds; RealFFT<N_FFT> is the variant
+// the log-mel CPU path uses.
+template <size_t N>
+class RealFFT {
+    static_assert(N % 2 == 0, "RealFFT requires an even length");
+
+    public:
+        static constexpr size_t SIZE = N;
+        static constexpr size_t N_FREQS = N / 2 + 1;
+
+        using Complex = FFTPlan::Complex;
+
+        RealFFT() : plan_(N / 2) {
+            for (size_t k = 0; k < N / 2; k++) {
+                auto phase = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(N);
+                split_[k] = Complex(std::cos(phase), std::sin(phase));
+            }
+        }
+
+        static constexpr size_t size() {
+            return N;
+        }
+
+        static const RealFFT& instance() {
+            static const RealFFT fft;
+            return fft;
+        }
+
+        // Writes the N/2 + 1 non-negative frequency bins as separate real and
+        // imaginary arrays, the layout the SIMD power kernels consume.
+        void forward(const float* in, float* re, float* im) const {
+            std::array<Complex, N / 2> z;
+            std::array<Complex, N / 2> zf;
+            for (size_t n = 0; n < N / 2; n++) {
+                z[n] = Complex(in[2 * n], in[2 * n + 1]);
+            }
+            plan_.forward(z.data(), zf.data());
+
+            re[0] = zf[0].real() + zf[0].imag();
+            im[0] = 0.0f;
+            re[N / 2] = zf[0].real() - zf[0].imag();
+            im[N / 2] = 0.0f;
+
+            for (size_t k = 1; k < N / 2; k++) {
+                auto a = zf[k];
+                auto b = std::conj(zf[N / 2 - k]);
+                auto even = (a + b) * 0.5f;
+                auto odd = (a - b) * Complex(0.0f, -0.5f);
+                auto x = even + split_[k] * odd;
+                re[k] = x.real();
+                im[k] = x.imag();
+            }
+        }
+
+    private:
+        FFTPlan plan_;
+        std::array<Complex, N / 2> split_;
+};
+
+// Real-input FFT for a length only known at runtime; used for non-standard
+// n_fft values where a RealFFT<N> instantiation does not exist.
+class DynamicRealFFT {
+    public:
+        using Complex = FFTPlan::Complex;
+
+        explicit DynamicRealFFT(const size_t n) : plan_(n) {}
+
+        size_t size() const {
+            return plan_.size();
+        }
+
+        void forward(const float* in, float* re, float* im) const {
+            const size_t n = plan_.size();
+            std::vector<Complex> z(n);
+            std::vector<Complex> zf(n);
+            for (size_t i = 0; i < n; i++) {
+                z[i] = Complex(in[i], 0.0f);
+            }
+            plan_.forward(z.data(), zf.data());
+            for (size_t k = 0; k <= n / 2; k++) {
+                re[k] = zf[k].real();
+                im[k] = zf[k].imag();
+            }
+        }
+
+    private:
+        FFTPlan plan_;
+};
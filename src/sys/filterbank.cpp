@@ -0,0 +1,98 @@
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+    // Slaney's Auditory Toolbox scale: linear below 1 kHz, logarithmic above.
+    constexpr double F_SP = 200.0 / 3.0;
+    constexpr double MIN_LOG_HZ = 1000.0;
+    constexpr double MIN_LOG_MEL = MIN_LOG_HZ / F_SP;
+
+    double log_step() {
+        return std::log(6.4) / 27.0;
+    }
+
+    double hz_to_mel(const double hz) {
+        if (hz >= MIN_LOG_HZ) {
+            return MIN_LOG_MEL + std::log(hz / MIN_LOG_HZ) / log_step();
+        }
+        return hz / F_SP;
+    }
+
+    double mel_to_hz(const double mel) {
+        if (mel >= MIN_LOG_MEL) {
+            return MIN_LOG_HZ * std::exp(log_step() * (mel - MIN_LOG_MEL));
+        }
+        return F_SP * mel;
+    }
+
+    std::vector<float> build(const size_t n_mels, const size_t n_fft, const size_t sample_rate) {
+        const size_t n_freqs = n_fft / 2 + 1;
+        const double sr = static_cast<double>(sample_rate);
+
+        // n_mels + 2 band edges evenly spaced on the mel scale over [0, sr / 2]
+        const double max_mel = hz_to_mel(sr / 2.0);
+        std::vector<double> edges(n_mels + 2);
+        for (size_t i = 0; i < edges.size(); i++) {
+            auto mel = max_mel * static_cast<double>(i) / static_cast<double>(n_mels + 1);
+            edges[i] = mel_to_hz(mel);
+        }
+
+        std::vector<float> weights(n_mels * n_freqs, 0.0f);
+        for (size_t m = 0; m < n_mels; m++) {
+            const double lower_width = edges[m + 1] - edges[m];
+            const double upper_width = edges[m + 2] - edges[m + 1];
+            const double norm = 2.0 / (edges[m + 2] - edges[m]);
+
+            for (size_t k = 0; k < n_freqs; k++) {
+                const double freq = static_cast<double>(k) * sr / static_cast<double>(n_fft);
+                const double lower = (freq - edges[m]) / lower_width;
+                const double upper = (edges[m + 2] - freq) / upper_width;
+                const double weight = std::max(0.0, std::min(lower, upper));
+                weights[m * n_freqs + k] = static_cast<float>(weight * norm);
+            }
+        }
+
+        return weights;
+    }
+}
+
+std::shared_ptr<const std::vector<float>> mel_filterbank(
+    const size_t n_mels,
+    const size_t n_fft,
+    const size_t sample_rate
+) {
+    if (n_mels == 0 || n_fft < 2 || sample_rate == 0) {
+        throw std::invalid_argument("mel filterbank needs n_mels > 0, n_fft >= 2 and a sample rate");
+    }
+
+    using Key = std::tuple<size_t, size_t, size_t>;
+    static std::mutex mutex;
+    static std::map<Key, std::shared_ptr<const std::vector<float>>> cache;
+
+    std::lock_guard lock(mutex);
+    auto& table = cache[Key(n_mels, n_fft, sample_rate)];
+    if (!table) {
+        table = std::make_shared<const std::vector<float>>(build(n_mels, n_fft, sample_rate));
+    }
+    return table;
+}
+
+size_t mel_bin(
+    const double hz,
+    const size_t n_mels,
+    const size_t sample_rate
+) {
+    if (n_mels == 0) {
+        return 0;
+    }
+    // filter m is centred on band edge m + 1
+    const double step = hz_to_mel(static_cast<double>(sample_rate) / 2.0) / static_cast<double>(n_mels + 1);
+    const double bin = std::round(hz_to_mel(std::max(hz, 0.0)) / step) - 1.0;
+    return static_cast<size_t>(std::clamp(bin, 0.0, static_cast<double>(n_mels - 1)));
+}
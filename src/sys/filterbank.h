@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+const size_t SAMPLE_RATE = 16000;
+
+// Slaney-style mel filterbank, the same table librosa.filters.mel(sr, n_fft,
+// n_mels) produces with its defaults (Slaney mel scale, area normalization,
+// fmin = 0, fmax = sr / 2) and the one Whisper ships as mel_filters.npz.
+// Row-major [n_mels, n_fft / 2 + 1].
+//
+// Tables are computed on first use and cached per (n_mels, n_fft, sample_rate),
+// so constructing further extractors costs a map lookup.
+std::shared_ptr<const std::vector<float>> mel_filterbank(
+    const size_t n_mels,
+    const size_t n_fft,
+    const size_t sample_rate = SAMPLE_RATE
+);
+
+// Index of the filter of an n_mels bank whose centre frequency is nearest hz.
+size_t mel_bin(
+    const double hz,
+    const size_t n_mels,
+    const size_t sample_rate = SAMPLE_RATE
+);
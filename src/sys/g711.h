@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// ITU-T G.711 decoding through 256-entry tables built at compile time; samples
+// are scaled like 16-bit PCM, i.e. divided by 32768.
+namespace g711 {
+    constexpr float ulaw_sample(const uint8_t code) {
+        const uint8_t u = ~code;
+        const int exponent = (u >> 4) & 0x07;
+        const int mantissa = u & 0x0F;
+        const int magnitude = (((mantissa << 3) + 0x84) << exponent) - 0x84;
+        return static_cast<float>((u & 0x80) ? -magnitude : magnitude) / 32768.0f;
+    }
+
+    constexpr float alaw_sample(const uint8_t code) {
+        const uint8_t a = code ^ 0x55;
+        const int exponent = (a >> 4) & 0x07;
+        const int mantissa = a & 0x0F;
+        const int magnitude = exponent == 0
+            ? (mantissa << 4) + 0x08
+            : ((mantissa << 4) + 0x108) << (exponent - 1);
+        return static_cast<float>((a & 0x80) ? magnitude : -magnitude) / 32768.0f;
+    }
+
+    template <float (*Sample)(uint8_t)>
+    constexpr std::array<float, 256> table() {
+        std::array<float, 256> t{};
+        for (size_t i = 0; i < t.size(); i++) {
+            t[i] = Sample(static_cast<uint8_t>(i));
+        }
+        return t;
+    }
+
+    inline constexpr std::array<float, 256> ULAW = table<ulaw_sample>();
+    inline constexpr std::array<float, 256> ALAW = table<alaw_sample>();
+
+    inline void decode(const std::array<float, 256>& lut, const std::span<const uint8_t> in, float* out) {
+        for (size_t i = 0; i < in.size(); i++) {
+            out[i] = lut[in[i]];
+        }
+    }
+
+    inline void decode_ulaw(const std::span<const uint8_t> in, float* out) {
+        decode(ULAW, in, out);
+    }
+
+    inline void decode_alaw(const std::span<const uint8_t> in, float* out) {
+        decode(ALAW, in, out);
+    }
+}
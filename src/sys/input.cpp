@@ -0,0 +1,95 @@
+#include "whisper-trtllm-rs/src/sys/input.h"
+#include "whisper-trtllm-rs/src/sys/g711.h"
+
+#include <cstring>
+#include <stdexcept>
+
+AudioInput::AudioInput(
+    const AudioEncoding encoding,
+    const size_t sample_rate
+) : encoding_(encoding) {
+    if (sample_rate != SAMPLE_RATE) {
+        resampler_.emplace(sample_rate, SAMPLE_RATE);
+    }
+}
+
+size_t AudioInput::bytes_per_sample() const {
+    switch (encoding_) {
+        case AudioEncoding::Float32: return 4;
+        case AudioEncoding::Pcm16: return 2;
+        case AudioEncoding::MuLaw: return 1;
+        case AudioEncoding::ALaw: return 1;
+    }
+    throw std::invalid_argument("unknown audio encoding");
+}
+
+void AudioInput::write(
+    FeatureBuffer& buffer,
+    std::span<const uint8_t> data
+) {
+    const size_t width = bytes_per_sample();
+    decoded_.clear();
+
+    // complete the sample split by the previous write
+    if (!partial_.empty()) {
+        auto take = std::min(width - partial_.size(), data.size());
+        partial_.insert(partial_.end(), data.begin(), data.begin() + take);
+        data = data.subspan(take);
+        if (partial_.size() < width) {
+            return;
+        }
+        decode(partial_);
+        partial_.clear();
+    }
+
+    const size_t whole = data.size() / width * width;
+    auto rest = data.subspan(whole);
+    partial_.assign(rest.begin(), rest.end());
+    decode(data.first(whole));
+
+    if (resampler_) {
+        resampled_.clear();
+        resampler_->process(decoded_, resampled_);
+        buffer.append(std::span<const float>(resampled_));
+    } else {
+        buffer.append(std::span<const float>(decoded_));
+    }
+}
+
+void AudioInput::finish(FeatureBuffer& buffer) {
+    // a trailing partial sample is dropped
+    partial_.clear();
+    if (resampler_) {
+        resampled_.clear();
+        resampler_->flush(resampled_);
+        buffer.append(std::span<const float>(resampled_));
+    }
+    buffer.finish();
+}
+
+// Appends the samples of data (whole samples only) to decoded_.
+void AudioInput::decode(const std::span<const uint8_t> data) {
+    const size_t n = data.size() / bytes_per_sample();
+    const size_t offset = decoded_.size();
+    decoded_.resize(offset + n);
+    float* out = decoded_.data() + offset;
+
+    switch (encoding_) {
+        case AudioEncoding::Float32:
+            std::memcpy(out, data.data(), n * sizeof(float));
+            break;
+        case AudioEncoding::Pcm16:
+            for (size_t i = 0; i < n; i++) {
+                int16_t sample;
+                std::memcpy(&sample, data.data() + 2 * i, sizeof(sample));
+                out[i] = static_cast<float>(sample) / 32768.0f;
+            }
+            break;
+        case AudioEncoding::MuLaw:
+            g711::decode_ulaw(data.first(n), out);
+            break;
+        case AudioEncoding::ALaw:
+            g711::decode_alaw(data.first(n), out);
+            break;
+    }
+}
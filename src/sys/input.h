@@ -0,0 +1,66 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/buffer.h"
+#include "whisper-trtllm-rs/src/sys/resample.h"
+
+#include "rust/cxx.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+// sample formats; multi-byte ones little endian
+enum class AudioEncoding : uint8_t {
+    Float32 = 0,
+    Pcm16 = 1,
+    MuLaw = 2,
+    ALaw = 3,
+};
+
+// Decodes encoded audio of any sample rate to 16 kHz float samples and
+// appends them to a FeatureBuffer. Bytes of an incomplete sample and the
+// resampler history carry over between writes, so chunks can be cut anywhere.
+class AudioInput {
+    public:
+        AudioInput(
+            const AudioEncoding encoding,
+            const size_t sample_rate
+        );
+
+        void write(
+            FeatureBuffer& buffer,
+            const std::span<const uint8_t> data
+        );
+
+        // Flushes the resampler and finishes the buffer.
+        void finish(FeatureBuffer& buffer);
+
+        // rust ffi
+        inline void write(
+            FeatureBuffer& buffer,
+            const rust::Slice<const uint8_t> data
+        ) {
+            write(buffer, std::span<const uint8_t>(data.data(), data.size()));
+        }
+
+    private:
+        size_t bytes_per_sample() const;
+
+        void decode(const std::span<const uint8_t> data);
+
+        AudioEncoding encoding_;
+        std::optional<Resampler> resampler_;
+        std::vector<uint8_t> partial_;
+        std::vector<float> decoded_;
+        std::vector<float> resampled_;
+};
+
+// rust ffi
+inline std::unique_ptr<AudioInput> audio_input(
+    const AudioEncoding encoding,
+    const size_t sample_rate
+) {
+    return std::make_unique<AudioInput>(encoding, sample_rate);
+}
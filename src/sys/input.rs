@@ -0,0 +1,229 @@
+use cxx::UniquePtr;
+
+use anyhow::{anyhow, Result};
+
+use super::buffer::{self, FeatureBuffer};
+
+pub use ffi::AudioEncoding;
+
+#[cxx::bridge]
+mod ffi {
+    /// Sample formats accepted by `AudioInput`; multi-byte ones are little endian.
+    #[derive(Debug)]
+    #[repr(u8)]
+    enum AudioEncoding {
+        Float32 = 0,
+        Pcm16 = 1,
+        MuLaw = 2,
+        ALaw = 3,
+    }
+
+    unsafe extern "C++" {
+        type FeatureBuffer = super::buffer::ffi::FeatureBuffer;
+
+        include!("whisper-trtllm-rs/src/sys/input.h");
+
+        type AudioEncoding;
+
+        type Resampler;
+
+        fn resampler(
+            in_rate: usize,
+            out_rate: usize,
+        ) -> Result<UniquePtr<Resampler>>;
+
+        fn process(
+            self: Pin<&mut Resampler>,
+            input: &[f32],
+            out: &mut Vec<f32>,
+        ) -> Result<()>;
+
+        fn flush(
+            self: Pin<&mut Resampler>,
+            out: &mut Vec<f32>,
+        ) -> Result<()>;
+
+        type AudioInput;
+
+        fn audio_input(
+            encoding: AudioEncoding,
+            sample_rate: usize,
+        ) -> Result<UniquePtr<AudioInput>>;
+
+        fn write(
+            self: Pin<&mut AudioInput>,
+            buffer: Pin<&mut FeatureBuffer>,
+            data: &[u8],
+        ) -> Result<()>;
+
+        fn finish(
+            self: Pin<&mut AudioInput>,
+            buffer: Pin<&mut FeatureBuffer>,
+        ) -> Result<()>;
+    }
+}
+
+/// Streaming sample rate converter (Kaiser-windowed sinc, polyphase).
+/// Chunks can be of any size; the output equals converting the whole signal
+/// at once.
+pub struct Resampler {
+    ptr: UniquePtr<ffi::Resampler>,
+}
+
+impl Resampler {
+    pub fn new(in_rate: usize, out_rate: usize) -> Result<Self> {
+        let ptr = ffi::resampler(in_rate, out_rate)
+            .map_err(|e| anyhow!("failed to create resampler: {}", e))?;
+        Ok(Self { ptr })
+    }
+
+    pub fn process(&mut self, input: &[f32]) -> Result<Vec<f32>> {
+        let mut out = Vec::new();
+        self.ptr.pin_mut().process(input, &mut out)
+            .map_err(|e| anyhow!("failed to resample: {}", e))?;
+        Ok(out)
+    }
+
+    /// Remaining output once the input has ended.
+    pub fn flush(&mut self) -> Result<Vec<f32>> {
+        let mut out = Vec::new();
+        self.ptr.pin_mut().flush(&mut out)
+            .map_err(|e| anyhow!("failed to flush resampler: {}", e))?;
+        Ok(out)
+    }
+}
+
+unsafe impl Send for Resampler {}
+
+/// Decodes and resamples encoded audio straight into a `FeatureBuffer`.
+pub(crate) struct AudioInput {
+    ptr: UniquePtr<ffi::AudioInput>,
+}
+
+impl AudioInput {
+    pub fn new(encoding: AudioEncoding, sample_rate: usize) -> Result<Self> {
+        let ptr = ffi::audio_input(encoding, sample_rate)
+            .map_err(|e| anyhow!("failed to create audio input: {}", e))?;
+        Ok(Self { ptr })
+    }
+
+    pub fn write(&mut self, buffer: &mut FeatureBuffer, data: &[u8]) -> Result<()> {
+        self.ptr.pin_mut().write(buffer.inner_mut(), data)
+            .map_err(|e| anyhow!("failed to write audio: {}", e))
+    }
+
+    pub fn finish(&mut self, buffer: &mut FeatureBuffer) -> Result<()> {
+        self.ptr.pin_mut().finish(buffer.inner_mut())
+            .map_err(|e| anyhow!("failed to finish audio input: {}", e))
+    }
+}
+
+unsafe impl Send for AudioInput {}
+
+#[cfg(test)]
+mod tests {
+    use super::{AudioEncoding, AudioInput, Resampler};
+    use crate::sys::{FeatureBuffer, LogMelSpectrogram};
+    use crate::sys::testing::ffi::g711_table;
+    use std::time::Instant;
+
+    fn tone(rate: usize, seconds: usize) -> Vec<f32> {
+        (0..rate * seconds).map(|i| {
+            0.5 * (2.0 * std::f32::consts::PI * 440.0 * i as f32 / rate as f32).sin()
+        }).collect()
+    }
+
+    #[test]
+    fn test_chunked_input_matches_one_shot() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let pcm: Vec<u8> = tone(44100, 3).iter()
+            .flat_map(|s| ((s * 32767.0) as i16).to_le_bytes())
+            .collect();
+
+        let read = |chunk: usize| {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            let mut input = AudioInput::new(AudioEncoding::Pcm16, 44100).unwrap();
+            for data in pcm.chunks(chunk) {
+                input.write(&mut buffer, data).unwrap();
+            }
+            input.finish(&mut buffer).unwrap();
+            buffer.features(buffer.len()).unwrap().to_vec()
+        };
+
+        let expected = read(pcm.len());
+        assert_eq!(expected.len(), 300 * 128);
+        // odd sizes split samples between writes
+        for chunk in [333, 4_097, 88_201] {
+            assert_eq!(read(chunk), expected, "chunk {chunk}");
+        }
+    }
+
+    #[test]
+    fn test_g711_silence() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        for (encoding, silence) in [(AudioEncoding::MuLaw, 0xFFu8), (AudioEncoding::ALaw, 0xD5u8)] {
+            let mut buffer = FeatureBuffer::new(&extractor).unwrap();
+            let mut input = AudioInput::new(encoding, 8000).unwrap();
+            input.write(&mut buffer, &vec![silence; 8000]).unwrap();
+            input.finish(&mut buffer).unwrap();
+            assert_eq!(buffer.len(), 100);
+        }
+    }
+
+    // G.711 reconstruction levels: mu-law on the 14-bit scale, A-law on the
+    // 13-bit scale, both taken to 16-bit PCM
+    fn ulaw_reference(code: u8) -> f32 {
+        let sign = if code & 0x80 != 0 { 1 } else { -1 };
+        let code = !code & 0x7F;
+        let (segment, step) = ((code >> 4) as i32, (code & 0x0F) as i32);
+        let level = ((2 * step + 33) << segment) - 33;
+        (sign * level * 4) as f32 / 32768.0
+    }
+
+    fn alaw_reference(code: u8) -> f32 {
+        let sign = if code & 0x80 != 0 { 1 } else { -1 };
+        let code = (code ^ 0x55) & 0x7F;
+        let (segment, step) = ((code >> 4) as i32, (code & 0x0F) as i32);
+        let level = if segment == 0 { 2 * step + 1 } else { (2 * step + 33) << (segment - 1) };
+        (sign * level * 8) as f32 / 32768.0
+    }
+
+    #[test]
+    fn test_g711_tables_match_reference() {
+        let ulaw = g711_table(false);
+        let alaw = g711_table(true);
+        assert_eq!((ulaw.len(), alaw.len()), (256, 256));
+        for code in 0..=255u8 {
+            assert_eq!(ulaw[code as usize], ulaw_reference(code), "mu-law {code:#04x}");
+            assert_eq!(alaw[code as usize], alaw_reference(code), "A-law {code:#04x}");
+        }
+
+        // ends of the scale and silence
+        assert_eq!(ulaw[0x00] * 32768.0, -32124.0);
+        assert_eq!(ulaw[0x80] * 32768.0, 32124.0);
+        assert_eq!(ulaw[0xFF], 0.0);
+        assert_eq!(alaw[0x2A] * 32768.0, -32256.0);
+        assert_eq!(alaw[0xAA] * 32768.0, 32256.0);
+        assert_eq!(alaw[0xD5] * 32768.0, 8.0);
+    }
+
+    #[test]
+    #[ignore]
+    fn bench_resample() {
+        for rate in [8000, 44100, 48000] {
+            let audio = tone(rate, 60);
+            let mut resampler = Resampler::new(rate, 16000).unwrap();
+            let start = Instant::now();
+            let mut n = 0;
+            for chunk in audio.chunks(rate / 50) {
+                n += resampler.process(chunk).unwrap().len();
+            }
+            n += resampler.flush().unwrap().len();
+            let elapsed = start.elapsed().as_secs_f64();
+            println!(
+                "{rate} Hz -> 16 kHz: {:.1} M input samples/s per core, {n} output samples",
+                audio.len() as f64 / elapsed / 1e6,
+            );
+        }
+    }
+}
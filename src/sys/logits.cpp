@@ -0,0 +1,53 @@
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+#include "whisper-trtllm-rs/src/sys/logits.h"
+
+LogitBiases::LogitBiases(
+    const int64_t vocab,
+    const torch::TensorOptions& options
+) {
+    const float inf = std::numeric_limits<float>::infinity();
+    auto keep = [&](const int64_t begin, const int64_t end) {
+        auto bias = torch::full({vocab}, -inf, options);
+        bias.slice(0, begin, end).zero_();
+        return bias;
+    };
+    auto drop = [&](const int64_t begin, const int64_t end) {
+        auto bias = torch::zeros({vocab}, options);
+        bias.slice(0, begin, end).fill_(-inf);
+        return bias;
+    };
+
+    ids = torch::arange(vocab, options.dtype(torch::kLong));
+
+    languages_only = keep(token::START_OF_LANGUAGE, token::END_OF_LANGUAGE);
+    text_only = drop(token::START_OF_TIMESTAMP, vocab);
+    timestamps_only = drop(0, token::START_OF_TIMESTAMP);
+    blank = torch::zeros({vocab}, options);
+    blank.select(0, token::SPACE).fill_(-inf);
+    blank.select(0, token::END_OF_TEXT).fill_(-inf);
+
+    transcribe = keep(token::TRANSCRIBE, token::TRANSCRIBE + 1);
+    end_of_text = keep(token::END_OF_TEXT, token::END_OF_TEXT + 1);
+}
+
+const LogitBiases& BiasMasks::get(
+    const torch::Tensor& logits
+) {
+    const auto device = logits.device();
+    const auto dtype = logits.scalar_type();
+    const int64_t vocab = logits.size(-1);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : entries_) {
+        if (entry.device == device && entry.dtype == dtype && entry.vocab == vocab) {
+            return *entry.biases;
+        }
+    }
+    entries_.push_back(Entry{
+        device,
+        dtype,
+        vocab,
+        std::make_unique<LogitBiases>(vocab, torch::TensorOptions().device(device).dtype(dtype))
+    });
+    return *entries_.back().biases;
+}
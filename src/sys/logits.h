@@ -9,12 +9,61 @@
 #include "tensorrt_llm/runtime/torchUtils.h"
 
 #include <torch/torch.h>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace tlr = tensorrt_llm::runtime;
 namespace tle = tensorrt_llm::executor;
 
 const torch::Half NEG_INF = static_cast<torch::Half>(-std::numeric_limits<float>::infinity());
 
+// The static rules as bias vectors [vocab]: 0 where a token is kept and -inf
+// where it is suppressed, so a rule is one add_ broadcast over the beams. The
+// forced rules are -inf but for one token at 0 and replace the logits with
+// copy_.
+struct LogitBiases {
+    LogitBiases(
+        const int64_t vocab,
+        const torch::TensorOptions& options
+    );
+
+    // arange(vocab) as int64, for rules that depend on the step
+    torch::Tensor ids;
+
+    torch::Tensor languages_only;
+    // every timestamp suppressed
+    torch::Tensor text_only;
+    torch::Tensor timestamps_only;
+    torch::Tensor blank;
+
+    torch::Tensor transcribe;
+    torch::Tensor end_of_text;
+};
+
+// LogitBiases per device, dtype and vocabulary size, built the first time
+// logits of that kind come through and kept for the life of the model. get()
+// locks, so callers resolve the biases once and keep the reference rather
+// than look them up every step.
+class BiasMasks {
+    public:
+        const LogitBiases& get(
+            const torch::Tensor& logits
+        );
+
+    private:
+        struct Entry {
+            torch::Device device;
+            torch::ScalarType dtype;
+            int64_t vocab;
+            std::unique_ptr<LogitBiases> biases;
+        };
+
+        std::mutex mutex_;
+        std::vector<Entry> entries_;
+};
+
 class Logprobs {
     public:
         Logprobs(torch::Tensor tensor): tensor_(tensor) {}
@@ -51,18 +100,23 @@ class Logprobs {
 class Logits {
     public:
         Logits(
-            tle::Tensor& logits
-        ) : tensor_(tlr::Torch::tensor(tle::detail::toITensor(logits)))
-        {}
-
-        Logits(
-            torch::Tensor& logits
-        ) : tensor_(logits)
+            torch::Tensor& logits,
+            const LogitBiases& biases
+        ) : tensor_(logits), biases_(&biases)
         {}
 
         Logits beam(int64_t beam) {
             auto tensor = tensor_.index({0, beam});
-            return Logits(tensor);
+            return Logits(tensor, *biases_);
+        }
+
+        const LogitBiases& biases() const {
+            return *biases_;
+        }
+
+        // [1, n_beams, vocab] view of the executor's logits
+        torch::Tensor& tensor() {
+            return tensor_;
         }
 
         Logprobs logprobs() {
@@ -71,13 +125,11 @@ class Logits {
         }
 
         void set_transcribe() {
-            tensor_.fill_(NEG_INF);
-            tensor_.select(-1, token::TRANSCRIBE).fill_(0);
+            tensor_.copy_(biases_->transcribe);
         }
 
         void set_eot() {
-            tensor_.fill_(NEG_INF);
-            tensor_.select(-1, token::END_OF_TEXT).fill_(0);
+            tensor_.copy_(biases_->end_of_text);
         }
 
         void suppress_notimestamps() {
@@ -85,8 +137,7 @@ class Logits {
         }
 
         void suppress_non_languages() {
-            suppress_range(0, token::START_OF_LANGUAGE);
-            suppress_range(token::END_OF_LANGUAGE);
+            tensor_.add_(biases_->languages_only);
         }
 
         void suppress_eot() {
@@ -99,11 +150,15 @@ class Logits {
         }
 
         void suppress_timestamps(std::optional<tle::TokenIdType> end = std::nullopt) {
+            if (!end) {
+                tensor_.add_(biases_->text_only);
+                return;
+            }
             suppress_range(token::START_OF_TIMESTAMP, end);
         }
 
         void suppress_non_timestamps() {
-            suppress_range(0, token::START_OF_TIMESTAMP);
+            tensor_.add_(biases_->timestamps_only);
         }
 
         void suppress_text() {
@@ -111,8 +166,7 @@ class Logits {
         }
 
         void suppress_blank() {
-            torch::Tensor indices = torch::tensor({token::SPACE, token::END_OF_TEXT}, torch::kLong);
-            suppress_indices(indices);
+            tensor_.add_(biases_->blank);
         }
 
     private:
@@ -129,14 +183,6 @@ class Logits {
             tensor_.slice(-1, begin, end).fill_(NEG_INF);
         }
 
-        void suppress_indices(
-            torch::Tensor indices
-        ) {
-            int64_t n = tensor_.dim();
-            std::vector<torch::indexing::TensorIndex> idx(n, torch::indexing::Slice());
-            idx[n - 1] = indices;
-            tensor_.index_put_(idx, NEG_INF);
-        }
-
         torch::Tensor tensor_;
-};
\ No newline at end of file
+        const LogitBiases* biases_;
+};
@@ -0,0 +1,24 @@
+// The bias masks against the slice fills they replaced, through the
+// self-checks in src/sys/testing/logits.cpp.
+
+use super::testing::ffi::bench_logit_rules;
+
+#[test]
+fn test_bias_masks_match_fills() {
+    for bench in bench_logit_rules("cpu", 2, 1).unwrap() {
+        assert!(bench.matches, "{}", bench.rule);
+    }
+}
+
+#[test]
+#[ignore]
+fn bench_bias_masks() {
+    for n_beams in [1, 5] {
+        for bench in bench_logit_rules("cpu", n_beams, 2000).unwrap() {
+            println!(
+                "cpu {n_beams} beams {}: fill {:.1} us, bias {:.1} us per step",
+                bench.rule, bench.fill_micros, bench.bias_micros,
+            );
+        }
+    }
+}
@@ -1,32 +1,362 @@
+#include "whisper-trtllm-rs/src/sys/mel.rs.h"
 #include "whisper-trtllm-rs/src/sys/mel.h"
+#include "whisper-trtllm-rs/src/sys/fft.h"
+#include "whisper-trtllm-rs/src/sys/simd.h"
+#include "whisper-trtllm-rs/src/sys/staging.h"
 
 #include "cnpy.h"
 
 #include <torch/torch.h>
+#include <ATen/Parallel.h>
 #include <cuda_runtime.h>
 #include <ATen/cuda/CUDAContext.h>
+#include <ATen/cuda/CUDAEvent.h>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
 #include <string>
 #include <vector>
 #include <filesystem>
 
+namespace {
+    // The (first, second) sample spans followed by zero padding, read with the
+    // same reflect padding torch::stft applies when center is set. shift moves
+    // the frame centres, e.g. by n_fft / 2 for a signal that is already padded.
+    struct Samples {
+        std::span<const float> first;
+        std::span<const float> second;
+        int64_t len;
+        int64_t shift = 0;
+
+        inline float at(int64_t i) const {
+            i += shift;
+            if (i < 0) {
+                i = -i;
+            }
+            if (i >= len) {
+                i = 2 * (len - 1) - i;
+            }
+            i = std::clamp<int64_t>(i, 0, len - 1);
+
+            auto j = static_cast<size_t>(i);
+            if (j < first.size()) {
+                return first[j];
+            }
+            j -= first.size();
+            if (j < second.size()) {
+                return second[j];
+            }
+            return 0.0f;
+        }
+    };
+
+    // Calls emit(r, power) with the power spectrum of every centred frame r.
+    // Stream i owns rows [offsets[i], offsets[i + 1]), and all rows of the
+    // batch are spread over the thread pool together. HOP is a compile-time
+    // constant for the standard configuration; 0 falls back to the runtime
+    // hop_length.
+    template <size_t HOP, typename Transform, typename Emit>
+    void for_each_power(
+        const Transform& transform,
+        const std::vector<Samples>& batch,
+        const std::vector<int64_t>& offsets,
+        const size_t hop_length,
+        const float* window,
+        const Emit& emit
+    ) {
+        const size_t n_fft = transform.size();
+        const size_t n_freqs = n_fft / 2 + 1;
+        const int64_t hop = static_cast<int64_t>(HOP > 0 ? HOP : hop_length);
+        const auto& kernels = simd::kernels();
+
+        at::parallel_for(0, offsets.back(), 16, [&](int64_t begin, int64_t end) {
+            std::vector<float> frame(n_fft);
+            std::vector<float> re(n_freqs);
+            std::vector<float> im(n_freqs);
+            std::vector<float> power(n_freqs);
+
+            size_t b = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+            for (int64_t r = begin; r < end; r++) {
+                while (r >= offsets[b + 1]) {
+                    b++;
+                }
+                const auto& samples = batch[b];
+                const int64_t t = r - offsets[b];
+
+                const int64_t offset = t * hop - static_cast<int64_t>(n_fft / 2);
+                for (size_t i = 0; i < n_fft; i++) {
+                    frame[i] = samples.at(offset + static_cast<int64_t>(i)) * window[i];
+                }
+
+                transform.forward(frame.data(), re.data(), im.data());
+                kernels.power(re.data(), im.data(), power.data(), n_freqs);
+                emit(r, power.data());
+            }
+        });
+    }
+
+    template <typename Emit>
+    void for_each_power(
+        const size_t n_fft,
+        const size_t hop_length,
+        const std::vector<Samples>& batch,
+        const std::vector<int64_t>& offsets,
+        const float* window,
+        const Emit& emit
+    ) {
+        if (n_fft == N_FFT && hop_length == HOP_LENGTH) {
+            for_each_power<HOP_LENGTH>(
+                RealFFT<N_FFT>::instance(), batch, offsets, hop_length, window, emit);
+        } else {
+            for_each_power<0>(
+                DynamicRealFFT(n_fft), batch, offsets, hop_length, window, emit);
+        }
+    }
+
+    // Mel energies of one power spectrum into row.
+    inline void project_row(
+        const simd::Kernels& kernels,
+        const MelBands& bands,
+        const float* power,
+        float* row
+    ) {
+        for (size_t m = 0; m < bands.n_mels(); m++) {
+            row[m] = kernels.dot(
+                bands.weights.data() + bands.offset[m],
+                power + bands.begin[m],
+                bands.offset[m + 1] - bands.offset[m]
+            );
+        }
+    }
+
+    // Writes log10 mel energies of centred frames into out (row major, n_mels
+    // per row).
+    void compute_log_mel(
+        const size_t n_fft,
+        const size_t hop_length,
+        const std::vector<Samples>& batch,
+        const std::vector<int64_t>& offsets,
+        const float* window,
+        const MelBands& bands,
+        float* out
+    ) {
+        const size_t n_mels = bands.n_mels();
+        const auto& kernels = simd::kernels();
+
+        for_each_power(n_fft, hop_length, batch, offsets, window, [&](const int64_t r, const float* power) {
+            float* row = out + r * n_mels;
+            project_row(kernels, bands, power, row);
+            for (size_t m = 0; m < n_mels; m++) {
+                row[m] = std::log10(std::max(row[m], 1e-10f));
+            }
+        });
+    }
+
+    void* pinned_allocate(size_t bytes) {
+        void* ptr = nullptr;
+        if (cudaMallocHost(&ptr, bytes) != cudaSuccess) {
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    void pinned_deallocate(void* ptr) {
+        cudaFreeHost(ptr);
+    }
+
+    // Marks the end of the work enqueued so far on the current stream.
+    class CudaFence : public StagingFence {
+        public:
+            CudaFence() {
+                event_.record(at::cuda::getCurrentCUDAStream());
+            }
+
+            bool is_complete() const override {
+                return event_.query();
+            }
+
+            void wait() const override {
+                event_.synchronize();
+            }
+
+            // The callback runs on a side stream that only waits for the
+            // event, so work enqueued after the fence does not delay it.
+            void notify(std::function<void()> done) const override {
+                auto side = at::cuda::getStreamFromPool(false, event_.device_index());
+                if (cudaStreamWaitEvent(side.stream(), event_.event(), 0) != cudaSuccess) {
+                    throw std::runtime_error("failed to wait for the extraction event");
+                }
+                auto pending = new std::function<void()>(std::move(done));
+                auto status = cudaLaunchHostFunc(side.stream(), [](void* data) {
+                    std::unique_ptr<std::function<void()>> done(static_cast<std::function<void()>*>(data));
+                    (*done)();
+                }, pending);
+                if (status != cudaSuccess) {
+                    delete pending;
+                    throw std::runtime_error("failed to launch the extraction callback");
+                }
+            }
+
+        private:
+            at::cuda::CUDAEvent event_;
+    };
+
+    float max_of(const float* data, const int64_t n) {
+        float max = -std::numeric_limits<float>::infinity();
+        for (int64_t i = 0; i < n; i++) {
+            max = std::max(max, data[i]);
+        }
+        return max;
+    }
+
+    torch::Tensor builtin_filters(const size_t n_mels, const size_t n_fft) {
+        // cached tables are never evicted, so the blob outlives the tensor
+        auto table = mel_filterbank(n_mels, n_fft);
+        return torch::from_blob(
+            const_cast<float*>(table->data()),
+            {static_cast<int64_t>(n_mels), static_cast<int64_t>(n_fft / 2 + 1)},
+            torch::kFloat32
+        );
+    }
+
+    torch::Tensor load_filters(const std::filesystem::path& mel_filter_path, const size_t n_mels) {
+        cnpy::npz_t file = cnpy::npz_load(mel_filter_path);
+
+        std::string mel_name = std::string("mel_") + std::to_string(n_mels);
+        auto it = file.find(mel_name);
+        if (it == file.end()) {
+            throw std::invalid_argument(mel_name + " not found in " + mel_filter_path.string());
+        }
+        cnpy::NpyArray& mel_array = it->second;
+        std::vector<int64_t> shape(mel_array.shape.begin(), mel_array.shape.end());
+
+        // clone, the npz buffer is freed on return
+        return torch::from_blob(mel_array.data<void>(), shape, torch::kFloat32).clone();
+    }
+}
+
+MelBands MelBands::banded(const torch::Tensor& filters) {
+    auto dense = filters.to(torch::kFloat32).contiguous();
+    const size_t n_mels = dense.size(0);
+    const size_t n_freqs = dense.size(1);
+    auto data = dense.data_ptr<float>();
+
+    MelBands bands;
+    bands.begin.reserve(n_mels);
+    bands.offset.reserve(n_mels + 1);
+    bands.offset.push_back(0);
+    for (size_t m = 0; m < n_mels; m++) {
+        auto row = data + m * n_freqs;
+        size_t begin = 0;
+        while (begin < n_freqs && row[begin] == 0.0f) {
+            begin++;
+        }
+        size_t end = n_freqs;
+        while (end > begin && row[end - 1] == 0.0f) {
+            end--;
+        }
+        bands.begin.push_back(begin);
+        bands.weights.insert(bands.weights.end(), row + begin, row + end);
+        bands.offset.push_back(bands.weights.size());
+    }
+    return bands;
+}
+
+MelBands MelBands::dense(const torch::Tensor& filters) {
+    auto dense = filters.to(torch::kFloat32).contiguous();
+    const size_t n_mels = dense.size(0);
+    const size_t n_freqs = dense.size(1);
+    auto data = dense.data_ptr<float>();
+
+    MelBands bands;
+    bands.begin.assign(n_mels, 0);
+    bands.weights.assign(data, data + n_mels * n_freqs);
+    for (size_t m = 0; m <= n_mels; m++) {
+        bands.offset.push_back(m * n_freqs);
+    }
+    return bands;
+}
+
+LogMelSpectrogram::LogMelSpectrogram(
+    const size_t n_mels,
+    const size_t n_fft,
+    const size_t hop_length,
+    const torch::Device& device,
+    const bool banded
+) : LogMelSpectrogram(
+        builtin_filters(n_mels, n_fft),
+        n_fft,
+        hop_length,
+        device,
+        banded
+    ) {
+}
+
 LogMelSpectrogram::LogMelSpectrogram(
     const std::filesystem::path& mel_filter_path,
     const size_t n_mels,
     const size_t n_fft,
     const size_t hop_length,
-    const torch::Device& device
+    const torch::Device& device,
+    const bool banded
+) : LogMelSpectrogram(
+        load_filters(mel_filter_path, n_mels),
+        n_fft,
+        hop_length,
+        device,
+        banded
+    ) {
+}
+
+LogMelSpectrogram::LogMelSpectrogram(
+    const torch::Tensor& filters,
+    const size_t n_fft,
+    const size_t hop_length,
+    const torch::Device& device,
+    const bool banded
 ) : n_fft_(n_fft),
     hop_length_(hop_length) {
-    // Load the npz file
-    cnpy::npz_t file = cnpy::npz_load(mel_filter_path);
-
-    // Load the mel filter array
-    std::string mel_name = std::string("mel_") + std::to_string(n_mels);
-    cnpy::NpyArray mel_array = file[mel_name];
-    std::vector<int64_t> shape(mel_array.shape.begin(), mel_array.shape.end());
-    
-    filters_ = torch::from_blob(mel_array.data<void>(), shape, torch::kFloat32).to(device);
+    if (filters.dim() != 2 || static_cast<size_t>(filters.size(1)) != n_fft / 2 + 1) {
+        throw std::invalid_argument("mel filters do not match n_fft / 2 + 1 frequency bins");
+    }
+
+    // copy, so a CPU tensor does not keep pointing into the source buffer
+    filters_ = filters
+        .to(device, /*non_blocking=*/false, /*copy=*/true)
+        .contiguous();
     window_ = torch::hann_window(n_fft).to(device);
+
+    auto host_filters = filters_.to(torch::kCPU);
+    bands_ = std::make_shared<const MelBands>(
+        banded ? MelBands::banded(host_filters) : MelBands::dense(host_filters)
+    );
+    if (banded && !device.is_cpu()) {
+        sparse_filters_ = filters_.to_sparse_csr();
+    }
+
+    staging_ = StagingPool::create(
+        device.is_cpu() ? host_staging_allocator() : StagingAllocator{pinned_allocate, pinned_deallocate}
+    );
+}
+
+rust::Vec<float> LogMelSpectrogram::filterbank() const {
+    auto host = filters_.to(torch::kCPU).contiguous();
+    rust::Vec<float> out;
+    out.reserve(host.numel());
+    auto data = host.data_ptr<float>();
+    for (int64_t i = 0; i < host.numel(); i++) {
+        out.push_back(data[i]);
+    }
+    return out;
+}
+
+StagingStats LogMelSpectrogram::staging_stats() const {
+    auto stats = staging_->stats();
+    return StagingStats{
+        stats.allocated_bytes,
+        stats.cached_buffers,
+        stats.in_flight_buffers,
+    };
 }
 
 torch::Tensor LogMelSpectrogram::extract(
@@ -34,52 +364,260 @@ torch::Tensor LogMelSpectrogram::extract(
     const std::optional<std::span<const float>> second,
     const std::optional<bool> padding
 ) const {
-    auto device = filters_.device();
+    if (filters_.device().is_cpu()) {
+        return extract_cpu(first, second, padding);
+    }
+    return extract_cuda(first, second, padding);
+}
 
-    torch::TensorOptions options = torch::TensorOptions()
-        .dtype(torch::kFloat32)
-        .device(device);
+torch::Tensor LogMelSpectrogram::extract_cpu(
+    const std::span<const float> first, 
+    const std::optional<std::span<const float>> second,
+    const std::optional<bool> padding
+) const {
+    auto rest = second.has_value() ? second.value() : std::span<const float>();
+    auto total_size = first.size() + rest.size();
+    if (padding.has_value() && padding.value()) {
+        total_size += padding_size(total_size);
+    }
 
-    auto total_size = first.size() + (second.has_value() ? second.value().size() : 0);
-    
-    auto padding_size = 0;
+    auto n_mels = filters_.size(0);
+    auto frames = static_cast<int64_t>(n_frames(total_size));
+
+    torch::Tensor log_spec = torch::empty({frames, n_mels}, torch::TensorOptions().dtype(torch::kFloat32));
+    if (frames == 0) {
+        return log_spec.toType(torch::kFloat16);
+    }
+
+    std::vector<Samples> batch{Samples{first, rest, static_cast<int64_t>(total_size)}};
+    std::vector<int64_t> offsets{0, frames};
+    auto out = log_spec.data_ptr<float>();
+    compute_log_mel(
+        n_fft_, hop_length_, batch, offsets, window_.data_ptr<float>(), mel_bands(), out);
+    auto max = max_of(out, frames * n_mels);
+
+    log_spec.clamp_min_(max - 8.0).add_(4.0).div_(4.0);
+
+    return log_spec.toType(torch::kFloat16);
+}
+
+torch::Tensor LogMelSpectrogram::extract_cuda(
+    const std::span<const float> first, 
+    const std::optional<std::span<const float>> second,
+    const std::optional<bool> padding
+) const {
+    return extract_async(first, second, padding)->wait();
+}
+
+std::unique_ptr<PendingFeatures> LogMelSpectrogram::extract_async(
+    const std::span<const float> first, 
+    const std::optional<std::span<const float>> second,
+    const std::optional<bool> padding
+) const {
+    if (filters_.device().is_cpu()) {
+        return std::make_unique<PendingFeatures>(extract_cpu(first, second, padding), nullptr);
+    }
+
+    auto rest = second.has_value() ? second.value() : std::span<const float>();
+    auto n_samples = first.size() + rest.size();
+    auto total_size = n_samples;
     if (padding.has_value() && padding.value()) {
-        padding_size = n_fft_ / 2 - (total_size - 1) % hop_length_ - 1;
-        total_size += padding_size;
+        total_size += padding_size(n_samples);
     }
 
-    torch::Tensor samples = torch::empty({static_cast<long>(total_size)}, options);
+    auto staging = staging_->acquire(total_size);
+    std::copy(first.begin(), first.end(), staging.data());
+    std::copy(rest.begin(), rest.end(), staging.data() + first.size());
+    std::fill(staging.data() + n_samples, staging.data() + total_size, 0.0f);
 
-    float* data_ptr = samples.data_ptr<float>();
+    torch::Tensor samples = upload(staging, total_size);
 
-    cudaStream_t stream = at::cuda::getCurrentCUDAStream().stream();
-    if (first.size() > 0) {
-        cudaMemcpyAsync(
-            data_ptr,
-            first.data(),
-            first.size_bytes(),
-            cudaMemcpyHostToDevice,
-            stream
-        );
+    torch::Tensor stft = torch::stft(samples, 
+        n_fft_, 
+        hop_length_, 
+        n_fft_, 
+        window_, 
+        true, // center
+        "reflect", // pad_mode
+        false, // normalized
+        true, // onesided
+        true // return_complex
+    );
+
+    auto magnitudes = stft.slice(-1, 0, n_frames(total_size)).abs().pow(2);
+    // auto magnitudes = stft.slice(-1, 0, stft.size(stft.dim() - 1) - 1).abs().pow(2);
+
+    torch::Tensor mel_spec = project(magnitudes);
+
+    torch::Tensor log_spec = torch::clamp_min(mel_spec, 1e-10).log10();
+
+    auto features = normalize(log_spec.transpose(0, 1));
+
+    auto fence = std::make_shared<const CudaFence>();
+    staging.retire(fence);
+
+    return std::make_unique<PendingFeatures>(features, fence);
+}
+
+void PendingFeatures::on_ready(
+    rust::Fn<void(rust::Box<ReadySignal>)> done,
+    rust::Box<ReadySignal> signal
+) const {
+    if (!fence_ || fence_->is_complete()) {
+        done(std::move(signal));
+        return;
     }
-    if (second.has_value() && second.value().size() > 0) { 
+    // std::function needs a copyable callable, the box is move-only
+    auto held = std::make_shared<rust::Box<ReadySignal>>(std::move(signal));
+    fence_->notify([done, held] {
+        done(std::move(*held));
+    });
+}
+
+torch::Tensor LogMelSpectrogram::project(const torch::Tensor& magnitudes) const {
+    if (!sparse_filters_.defined()) {
+        return torch::matmul(filters_, magnitudes);
+    }
+    if (magnitudes.dim() == 2) {
+        return torch::mm(sparse_filters_, magnitudes);
+    }
+
+    // [N, n_freqs, T] -> [n_freqs, N * T] -> [n_mels, N, T] -> [N, n_mels, T]
+    auto n = magnitudes.size(0);
+    auto t = magnitudes.size(2);
+    auto flat = magnitudes.permute({1, 0, 2}).reshape({magnitudes.size(1), n * t});
+    return torch::mm(sparse_filters_, flat).view({-1, n, t}).permute({1, 0, 2});
+}
+
+torch::Tensor LogMelSpectrogram::upload(
+    StagingPool::Buffer& staging,
+    const size_t len
+) const {
+    torch::Tensor samples = torch::empty(
+        {static_cast<long>(len)},
+        torch::TensorOptions().dtype(torch::kFloat32).device(filters_.device())
+    );
+    if (len > 0) {
         cudaMemcpyAsync(
-            data_ptr + first.size(),
-            second.value().data(),
-            second.value().size_bytes(),
+            samples.data_ptr<float>(),
+            staging.data(),
+            len * sizeof(float),
             cudaMemcpyHostToDevice,
-            stream
+            at::cuda::getCurrentCUDAStream().stream()
         );
     }
-    if (padding_size > 0) {
-        cudaMemsetAsync(
-            data_ptr + total_size,  // Start position after all data
-            0,                     // Value to set (0)
-            padding_size * sizeof(float), // Size in bytes
-            stream
+    return samples;
+}
+
+std::vector<torch::Tensor> LogMelSpectrogram::extract_batch(
+    const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+    const bool padding
+) const {
+    if (spans.empty()) {
+        return {};
+    }
+    if (filters_.device().is_cpu()) {
+        return extract_batch_cpu(spans, padding);
+    }
+    return extract_batch_cuda(spans, padding);
+}
+
+std::unique_ptr<FeaturesBatch> LogMelSpectrogram::extract_batch(
+    const rust::Slice<const SampleSpan> spans,
+    const bool padding
+) const {
+    std::vector<std::pair<std::span<const float>, std::span<const float>>> views;
+    views.reserve(spans.size());
+    for (const auto& span : spans) {
+        views.emplace_back(
+            std::span<const float>(span.first.data(), span.first.size()),
+            std::span<const float>(span.second.data(), span.second.size())
         );
     }
-    cudaStreamSynchronize(stream);
+    return std::make_unique<FeaturesBatch>(extract_batch(views, padding));
+}
+
+std::vector<torch::Tensor> LogMelSpectrogram::extract_batch_cpu(
+    const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+    const bool padding
+) const {
+    auto n_mels = filters_.size(0);
+
+    std::vector<Samples> batch;
+    std::vector<int64_t> offsets{0};
+    batch.reserve(spans.size());
+    offsets.reserve(spans.size() + 1);
+    for (const auto& [first, second] : spans) {
+        auto total_size = first.size() + second.size();
+        if (padding) {
+            total_size += padding_size(total_size);
+        }
+        batch.push_back(Samples{first, second, static_cast<int64_t>(total_size)});
+        offsets.push_back(offsets.back() + static_cast<int64_t>(n_frames(total_size)));
+    }
+
+    torch::Tensor log_spec = torch::empty({offsets.back(), n_mels}, torch::TensorOptions().dtype(torch::kFloat32));
+    auto out = log_spec.data_ptr<float>();
+    compute_log_mel(
+        n_fft_, hop_length_, batch, offsets, window_.data_ptr<float>(), mel_bands(), out);
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto rows = log_spec.slice(0, offsets[i], offsets[i + 1]);
+        if (rows.numel() > 0) {
+            auto max = max_of(out + offsets[i] * n_mels, rows.numel());
+            rows.clamp_min_(max - 8.0).add_(4.0).div_(4.0);
+        }
+    }
+
+    auto half = log_spec.toType(torch::kFloat16);
+    std::vector<torch::Tensor> features;
+    features.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        features.push_back(half.slice(0, offsets[i], offsets[i + 1]));
+    }
+    return features;
+}
+
+std::vector<torch::Tensor> LogMelSpectrogram::extract_batch_cuda(
+    const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+    const bool padding
+) const {
+    auto device = filters_.device();
+    auto n_mels = filters_.size(0);
+    const int64_t n = spans.size();
+
+    std::vector<int64_t> frames;
+    frames.reserve(n);
+    size_t max_len = 0;
+    for (const auto& [first, second] : spans) {
+        auto total_size = first.size() + second.size();
+        if (padding) {
+            total_size += padding_size(total_size);
+        }
+        frames.push_back(n_frames(total_size));
+        max_len = std::max(max_len, total_size);
+    }
+    auto max_frames = *std::max_element(frames.begin(), frames.end());
+
+    std::vector<torch::Tensor> features;
+    features.reserve(n);
+    if (max_frames == 0 || max_len <= n_fft_ / 2) {
+        for (int64_t i = 0; i < n; i++) {
+            features.push_back(empty()->into_tensor());
+        }
+        return features;
+    }
+
+    // rows are zero padded to the longest stream; frames that reach into
+    // another stream's padding are dropped below, final padding is zeros too
+    auto staging = staging_->acquire(n * max_len);
+    for (int64_t i = 0; i < n; i++) {
+        const auto& [first, second] = spans[i];
+        auto row = staging.data() + i * max_len;
+        auto end = std::copy(second.begin(), second.end(), std::copy(first.begin(), first.end(), row));
+        std::fill(end, row + max_len, 0.0f);
+    }
+    torch::Tensor samples = upload(staging, n * max_len).view({n, static_cast<int64_t>(max_len)});
 
     torch::Tensor stft = torch::stft(samples, 
         n_fft_, 
@@ -93,21 +631,243 @@ torch::Tensor LogMelSpectrogram::extract(
         true // return_complex
     );
 
-    auto n_frames = total_size + hop_length_ > n_fft_ / 2 ? (total_size + hop_length_ - n_fft_ / 2) / hop_length_ : 0;
-    auto magnitudes = stft.slice(-1, 0, n_frames).abs().pow(2);
-    // auto magnitudes = stft.slice(-1, 0, stft.size(stft.dim() - 1) - 1).abs().pow(2);
+    auto magnitudes = stft.slice(-1, 0, max_frames).abs().pow(2);
+    torch::Tensor log_spec = torch::clamp_min(project(magnitudes), 1e-10).log10();
 
-    torch::Tensor mel_spec = torch::matmul(filters_, magnitudes);
+    // per-stream maximum over its valid frames only
+    auto valid = torch::arange(max_frames, torch::TensorOptions().dtype(torch::kLong).device(device)).unsqueeze(0)
+        < torch::tensor(frames, torch::kLong).to(device).unsqueeze(1);
+    auto max = log_spec.masked_fill(valid.logical_not().unsqueeze(1), -std::numeric_limits<float>::infinity())
+        .amax({1, 2}, true);
 
-    torch::Tensor log_spec = torch::clamp_min(mel_spec, 1e-10).log10();
-    log_spec = torch::maximum(log_spec, log_spec.max() - 8.0);
+    log_spec = torch::maximum(log_spec, max - 8.0);
     log_spec = (log_spec + 4.0) / 4.0;
+    log_spec = log_spec.toType(torch::kFloat16).transpose(1, 2);
 
-    log_spec = log_spec.toType(torch::kFloat16).transpose(0, 1);
+    for (int64_t i = 0; i < n; i++) {
+        features.push_back(log_spec[i].slice(0, 0, frames[i]));
+    }
+
+    staging.retire(std::make_shared<const CudaFence>());
+
+    return features;
+}
+
+torch::Tensor LogMelSpectrogram::log_mel_frames(
+    const std::span<const float> padded,
+    const size_t n_frames
+) const {
+    auto n_mels = filters_.size(0);
+    auto frames = static_cast<int64_t>(n_frames);
+    auto options = torch::TensorOptions().dtype(torch::kFloat32).device(filters_.device());
+
+    if (frames == 0) {
+        return torch::empty({0, n_mels}, options);
+    }
+    if (padded.size() < (n_frames - 1) * hop_length_ + n_fft_) {
+        throw std::invalid_argument("not enough samples for the requested number of frames");
+    }
+
+    if (filters_.device().is_cpu()) {
+        torch::Tensor log_spec = torch::empty({frames, n_mels}, options);
+        std::vector<Samples> batch{
+            Samples{padded, {}, static_cast<int64_t>(padded.size()), static_cast<int64_t>(n_fft_ / 2)}
+        };
+        std::vector<int64_t> offsets{0, frames};
+        compute_log_mel(
+            n_fft_, hop_length_, batch, offsets, window_.data_ptr<float>(), mel_bands(),
+            log_spec.data_ptr<float>());
+        return log_spec;
+    }
+
+    auto len = (n_frames - 1) * hop_length_ + n_fft_;
+    auto staging = staging_->acquire(len);
+    std::copy(padded.begin(), padded.begin() + len, staging.data());
+    torch::Tensor samples = upload(staging, len);
+
+    torch::Tensor stft = torch::stft(samples, 
+        n_fft_, 
+        hop_length_, 
+        n_fft_, 
+        window_, 
+        false, // center
+        "reflect", // pad_mode
+        false, // normalized
+        true, // onesided
+        true // return_complex
+    );
+
+    auto magnitudes = stft.slice(-1, 0, frames).abs().pow(2);
+    torch::Tensor mel_spec = project(magnitudes);
+    auto log_spec = torch::clamp_min(mel_spec, 1e-10).log10().transpose(0, 1);
+
+    staging.retire(std::make_shared<const CudaFence>());
 
     return log_spec;
 }
 
+std::vector<torch::Tensor> LogMelSpectrogram::log_mel_frames_batch(
+    const std::vector<std::pair<std::span<const float>, size_t>>& streams
+) const {
+    auto n_mels = filters_.size(0);
+    auto options = torch::TensorOptions().dtype(torch::kFloat32).device(filters_.device());
+
+    std::vector<int64_t> offsets{0};
+    offsets.reserve(streams.size() + 1);
+    size_t max_len = 0;
+    for (const auto& [padded, n_frames] : streams) {
+        if (n_frames > 0) {
+            auto len = (n_frames - 1) * hop_length_ + n_fft_;
+            if (padded.size() < len) {
+                throw std::invalid_argument("not enough samples for the requested number of frames");
+            }
+            max_len = std::max(max_len, len);
+        }
+        offsets.push_back(offsets.back() + static_cast<int64_t>(n_frames));
+    }
+
+    std::vector<torch::Tensor> frames;
+    frames.reserve(streams.size());
+    if (offsets.back() == 0) {
+        for (size_t i = 0; i < streams.size(); i++) {
+            frames.push_back(torch::empty({0, n_mels}, options));
+        }
+        return frames;
+    }
+
+    if (filters_.device().is_cpu()) {
+        torch::Tensor log_spec = torch::empty({offsets.back(), n_mels}, options);
+        std::vector<Samples> batch;
+        batch.reserve(streams.size());
+        for (const auto& [padded, n_frames] : streams) {
+            batch.push_back(Samples{padded, {}, static_cast<int64_t>(padded.size()), static_cast<int64_t>(n_fft_ / 2)});
+        }
+        compute_log_mel(
+            n_fft_, hop_length_, batch, offsets, window_.data_ptr<float>(), mel_bands(),
+            log_spec.data_ptr<float>());
+        for (size_t i = 0; i < streams.size(); i++) {
+            frames.push_back(log_spec.slice(0, offsets[i], offsets[i + 1]));
+        }
+        return frames;
+    }
+
+    // rows zero padded to the longest signal, each stream keeps its own frames
+    const int64_t n = streams.size();
+    auto staging = staging_->acquire(n * max_len);
+    auto data_ptr = staging.data();
+    std::fill(data_ptr, data_ptr + n * max_len, 0.0f);
+    for (int64_t i = 0; i < n; i++) {
+        const auto& [padded, n_frames] = streams[i];
+        auto len = std::min(padded.size(), max_len);
+        std::copy(padded.begin(), padded.begin() + len, data_ptr + i * max_len);
+    }
+    torch::Tensor samples = upload(staging, n * max_len).view({n, static_cast<int64_t>(max_len)});
+
+    torch::Tensor stft = torch::stft(samples, 
+        n_fft_, 
+        hop_length_, 
+        n_fft_, 
+        window_, 
+        false, // center
+        "reflect", // pad_mode
+        false, // normalized
+        true, // onesided
+        true // return_complex
+    );
+
+    auto max_frames = static_cast<int64_t>((max_len - n_fft_) / hop_length_ + 1);
+    auto magnitudes = stft.slice(-1, 0, max_frames).abs().pow(2);
+    auto log_spec = torch::clamp_min(project(magnitudes), 1e-10).log10().transpose(1, 2);
+    for (int64_t i = 0; i < n; i++) {
+        frames.push_back(log_spec[i].slice(0, 0, offsets[i + 1] - offsets[i]));
+    }
+
+    staging.retire(std::make_shared<const CudaFence>());
+
+    return frames;
+}
+
+torch::Tensor LogMelSpectrogram::power_spectrum(
+    const std::span<const float> first, 
+    const std::optional<std::span<const float>> second,
+    const std::optional<bool> padding
+) const {
+    auto rest = second.has_value() ? second.value() : std::span<const float>();
+    auto n_samples = first.size() + rest.size();
+    auto total_size = n_samples;
+    if (padding.has_value() && padding.value()) {
+        total_size += padding_size(n_samples);
+    }
+
+    const int64_t n_freqs = n_fft_ / 2 + 1;
+    auto frames = static_cast<int64_t>(n_frames(total_size));
+    auto options = torch::TensorOptions().dtype(torch::kFloat32).device(filters_.device());
+    if (frames == 0) {
+        return torch::empty({0, n_freqs}, options);
+    }
+
+    if (filters_.device().is_cpu()) {
+        torch::Tensor power = torch::empty({frames, n_freqs}, options);
+        std::vector<Samples> batch{Samples{first, rest, static_cast<int64_t>(total_size)}};
+        std::vector<int64_t> offsets{0, frames};
+        auto out = power.data_ptr<float>();
+        for_each_power(n_fft_, hop_length_, batch, offsets, window_.data_ptr<float>(), [&](const int64_t r, const float* row) {
+            std::copy(row, row + n_freqs, out + r * n_freqs);
+        });
+        return power;
+    }
+
+    auto staging = staging_->acquire(total_size);
+    std::copy(first.begin(), first.end(), staging.data());
+    std::copy(rest.begin(), rest.end(), staging.data() + first.size());
+    std::fill(staging.data() + n_samples, staging.data() + total_size, 0.0f);
+    torch::Tensor samples = upload(staging, total_size);
+
+    torch::Tensor stft = torch::stft(samples, 
+        n_fft_, 
+        hop_length_, 
+        n_fft_, 
+        window_, 
+        true, // center
+        "reflect", // pad_mode
+        false, // normalized
+        true, // onesided
+        true // return_complex
+    );
+    auto power = stft.slice(-1, 0, frames).abs().pow(2).transpose(0, 1).contiguous();
+
+    staging.retire(std::make_shared<const CudaFence>());
+
+    return power;
+}
+
+torch::Tensor LogMelSpectrogram::log_mel(const torch::Tensor& power) const {
+    return torch::clamp_min(project(power.transpose(0, 1)), 1e-10).log10().transpose(0, 1);
+}
+
+torch::Tensor LogMelSpectrogram::normalize(const torch::Tensor& log_spec) const {
+    if (log_spec.numel() == 0) {
+        return log_spec.toType(torch::kFloat16);
+    }
+    auto normalized = torch::maximum(log_spec, log_spec.max() - 8.0);
+    normalized = (normalized + 4.0) / 4.0;
+    return normalized.toType(torch::kFloat16);
+}
+
+torch::Tensor LogMelSpectrogram::normalize(const torch::Tensor& log_spec, const float max) const {
+    auto out = torch::empty(log_spec.sizes(), log_spec.options().dtype(torch::kFloat16));
+    normalize(log_spec, max, out);
+    return out;
+}
+
+void LogMelSpectrogram::normalize(const torch::Tensor& log_spec, const float max, torch::Tensor out) const {
+    // (max(x, max - 8) + 4) / 4 without a full-size temporary: the shift is
+    // computed in float32 and rounded into out once, the scaling by a power
+    // of two is exact, and the clamp moves to the shifted bound
+    at::add_out(out, log_spec, torch::scalar_tensor(4.0));
+    out.div_(4.0).clamp_min_((max - 4.0) / 4.0);
+}
+
 /*
 torch::Tensor LogMelSpectrogram::extract(
     const std::span<const float> first, 
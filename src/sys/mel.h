@@ -1,25 +1,104 @@
 #pragma once
 
 #include "whisper-trtllm-rs/src/sys/features.h"
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+#include "whisper-trtllm-rs/src/sys/staging.h"
 
 #include "rust/cxx.h"
 
 #include <torch/torch.h>
 #include <filesystem>
 #include <span>
+#include <utility>
+#include <vector>
 
 const size_t N_MELS = 128;
 const size_t N_FFT = 400;
 const size_t HOP_LENGTH = 160;
 
+struct StagingStats;
+struct SampleSpan;
+struct ReadySignal;
+
+// Mel filterbank with only the non-zero span of every triangular filter kept
+// (bins [begin[m], begin[m] + offset[m + 1] - offset[m])), so the CPU
+// projection touches a few bins per filter instead of all n_fft / 2 + 1.
+struct MelBands {
+    std::vector<size_t> begin;
+    std::vector<size_t> offset;
+    std::vector<float> weights;
+
+    size_t n_mels() const {
+        return begin.size();
+    }
+
+    static MelBands banded(const torch::Tensor& filters);
+
+    // every filter spanning all bins, i.e. the dense projection
+    static MelBands dense(const torch::Tensor& filters);
+};
+
+// Features whose extraction may still be running on the device.
+class PendingFeatures {
+    public:
+        PendingFeatures(
+            torch::Tensor features,
+            std::shared_ptr<const StagingFence> fence
+        ) : features_(std::move(features)),
+            fence_(std::move(fence)) {
+        }
+
+        bool is_ready() const {
+            return !fence_ || fence_->is_complete();
+        }
+
+        torch::Tensor wait() const {
+            if (fence_) {
+                fence_->wait();
+            }
+            return features_;
+        }
+
+        // rust ffi
+        inline std::unique_ptr<Features> features() const {
+            return std::make_unique<Features>(wait());
+        }
+
+        // rust ffi: hands signal to done once the features are computed,
+        // without blocking; from a CUDA host callback if they are not yet
+        void on_ready(
+            rust::Fn<void(rust::Box<ReadySignal>)> done,
+            rust::Box<ReadySignal> signal
+        ) const;
+
+    private:
+        torch::Tensor features_;
+        std::shared_ptr<const StagingFence> fence_;
+};
+
+// Device results are returned as soon as their work is enqueued on the
+// current stream; anything reading them on that stream sees them complete.
+// Only extract() and PendingFeatures wait for the host.
 class LogMelSpectrogram {
     public:
+        // Uses the built-in Slaney filterbank, no file is read. banded
+        // selects the banded mel projection; dense is kept for comparison.
+        explicit LogMelSpectrogram(
+            const size_t n_mels = N_MELS,
+            const size_t n_fft = N_FFT,
+            const size_t hop_length = HOP_LENGTH,
+            const torch::Device& device = torch::kCUDA,
+            const bool banded = true
+        );
+
+        // Loads the mel_<n_mels> filterbank from an npz file instead.
         LogMelSpectrogram(
             const std::filesystem::path& mel_filter_path,
             const size_t n_mels = N_MELS,
             const size_t n_fft = N_FFT,
             const size_t hop_length = HOP_LENGTH,
-            const torch::Device& device = torch::kCUDA
+            const torch::Device& device = torch::kCUDA,
+            const bool banded = true
         );
 
         torch::Tensor extract(
@@ -42,6 +121,110 @@ class LogMelSpectrogram {
             );
         }
 
+        // Copies the samples into a pooled staging buffer, enqueues the upload
+        // and extraction without blocking, and returns a handle to poll.
+        std::unique_ptr<PendingFeatures> extract_async(
+            const std::span<const float> first, 
+            const std::optional<std::span<const float>> second,
+            const std::optional<bool> padding = false
+        ) const;
+
+        // rust ffi
+        inline std::unique_ptr<PendingFeatures> extract_async(
+            const rust::Slice<const float> first, 
+            const rust::Slice<const float> second,
+            const bool padding = false
+        ) const {
+            return extract_async(
+                std::span<const float>(first.data(), first.size()), 
+                std::span<const float>(second.data(), second.size()),
+                padding
+            );
+        }
+
+        // rust ffi: the upload staging pool; on the CPU samples are read in
+        // place and the pool stays empty
+        StagingStats staging_stats() const;
+
+        // Extracts several independent streams in one pass (a single packed
+        // upload, one batched STFT and mel projection). Every stream is
+        // normalized on its own, so each result equals extract() of its span.
+        std::vector<torch::Tensor> extract_batch(
+            const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+            const bool padding = false
+        ) const;
+
+        // rust ffi
+        std::unique_ptr<FeaturesBatch> extract_batch(
+            const rust::Slice<const SampleSpan> spans,
+            const bool padding
+        ) const;
+
+        // Raw log10 mel energies of n_frames frames laid out back to back from
+        // the first sample of an already padded signal (no centring, no
+        // normalization); float32 [n_frames, n_mels] on the extractor device.
+        torch::Tensor log_mel_frames(
+            const std::span<const float> padded,
+            const size_t n_frames
+        ) const;
+
+        // Power spectrum of the centred, Hann windowed frames extract()
+        // projects; float32 [n_frames, n_fft / 2 + 1] on the extractor
+        // device. Other front ends can project the same frames, see Fbank.
+        torch::Tensor power_spectrum(
+            const std::span<const float> first, 
+            const std::optional<std::span<const float>> second,
+            const std::optional<bool> padding = false
+        ) const;
+
+        // rust ffi
+        inline std::unique_ptr<Features> power_spectrum(
+            const rust::Slice<const float> first, 
+            const rust::Slice<const float> second,
+            const bool padding
+        ) const {
+            return std::make_unique<Features>(
+                power_spectrum(
+                    std::span<const float>(first.data(), first.size()), 
+                    std::span<const float>(second.data(), second.size()),
+                    padding
+                )
+            );
+        }
+
+        // Raw log10 mel energies of a power_spectrum(), the frames
+        // log_mel_frames() returns for the same samples.
+        torch::Tensor log_mel(const torch::Tensor& power) const;
+
+        // rust ffi: normalized features of a power_spectrum(), what
+        // extract() returns for the same samples, without another STFT
+        inline std::unique_ptr<Features> from_power_spectrum(const Features& power) const {
+            return std::make_unique<Features>(normalize(log_mel(power.tensor())));
+        }
+
+        // log_mel_frames() of several padded signals in one pass, one
+        // (padded, n_frames) pair per stream.
+        std::vector<torch::Tensor> log_mel_frames_batch(
+            const std::vector<std::pair<std::span<const float>, size_t>>& streams
+        ) const;
+
+        // Whisper's dynamic range clamp and scaling over all given frames.
+        torch::Tensor normalize(const torch::Tensor& log_spec) const;
+
+        // Same, with the clamp anchored at a maximum tracked by the caller.
+        torch::Tensor normalize(const torch::Tensor& log_spec, const float max) const;
+
+        // Writes the normalized frames into out, e.g. a slice of a slab.
+        void normalize(const torch::Tensor& log_spec, const float max, torch::Tensor out) const;
+
+        size_t n_frames(const size_t n_samples) const {
+            return n_samples + hop_length_ > n_fft_ / 2 ? (n_samples + hop_length_ - n_fft_ / 2) / hop_length_ : 0;
+        }
+
+        size_t padding_size(const size_t n_samples) const {
+            return n_samples > 0 ? n_fft_ / 2 - (n_samples - 1) % hop_length_ - 1 : 0;
+        }
+
         inline std::unique_ptr<Features> empty() const {
             // auto tensor = torch::empty({n_mels(), 0}, torch::TensorOptions().dtype(torch::kFloat32).device(filters_.device()));
             auto tensor = torch::empty({0, n_mels()}, torch::TensorOptions().dtype(torch::kFloat16).device(filters_.device()));
@@ -60,19 +243,86 @@ class LogMelSpectrogram {
             return hop_length_;
         }
 
+        torch::Device device() const {
+            return filters_.device();
+        }
+
+        // rust ffi: the dense filterbank, row-major [n_mels, n_fft / 2 + 1]
+        rust::Vec<float> filterbank() const;
+
     private:
+        LogMelSpectrogram(
+            const torch::Tensor& filters,
+            const size_t n_fft,
+            const size_t hop_length,
+            const torch::Device& device,
+            const bool banded
+        );
+
+        torch::Tensor extract_cpu(
+            const std::span<const float> first, 
+            const std::optional<std::span<const float>> second,
+            const std::optional<bool> padding
+        ) const;
+
+        torch::Tensor extract_cuda(
+            const std::span<const float> first, 
+            const std::optional<std::span<const float>> second,
+            const std::optional<bool> padding
+        ) const;
+
+        const MelBands& mel_bands() const {
+            return *bands_;
+        }
+
+        torch::Tensor project(const torch::Tensor& magnitudes) const;
+
+        torch::Tensor upload(
+            StagingPool::Buffer& staging,
+            const size_t len
+        ) const;
+
+        std::vector<torch::Tensor> extract_batch_cpu(
+            const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+            const bool padding
+        ) const;
+
+        std::vector<torch::Tensor> extract_batch_cuda(
+            const std::vector<std::pair<std::span<const float>, std::span<const float>>>& spans,
+            const bool padding
+        ) const;
+
         torch::Tensor filters_;
+        torch::Tensor sparse_filters_;
+        // banded or dense, as constructed
+        std::shared_ptr<const MelBands> bands_;
         torch::Tensor window_;
         size_t n_fft_;
         size_t hop_length_;
+        std::shared_ptr<StagingPool> staging_;
 };
 
+// An empty mel_filter_path selects the built-in filterbank.
 inline std::unique_ptr<LogMelSpectrogram> log_mel_spectrogram(
     const rust::Str mel_filter_path,
     const size_t n_mels = N_MELS,
     const size_t n_fft = N_FFT,
-    const size_t hop_length = HOP_LENGTH
+    const size_t hop_length = HOP_LENGTH,
+    const rust::Str device = "cuda",
+    const bool banded = true
 ) {
+    auto torch_device = torch::Device(static_cast<std::string>(device));
+    if (mel_filter_path.empty()) {
+        return std::make_unique<LogMelSpectrogram>(n_mels, n_fft, hop_length, torch_device, banded);
+    }
+
     auto path = std::filesystem::path(static_cast<std::string>(mel_filter_path));
-    return std::make_unique<LogMelSpectrogram>(path, n_mels, n_fft, hop_length);
+    return std::make_unique<LogMelSpectrogram>(
+        path,
+        n_mels,
+        n_fft,
+        hop_length,
+        torch_device,
+        banded
+    );
 }
\ No newline at end of file
@@ -4,11 +4,33 @@ use cxx::UniquePtr;
 
 use anyhow::{anyhow, Result};
 use std::path::Path;
+use tokio::sync::oneshot;
 
 #[cxx::bridge]
 pub(crate) mod ffi {
+    /// Host buffers of an extractor's upload staging pool.
+    #[derive(Copy, Clone, Debug, Default)]
+    struct StagingStats {
+        allocated_bytes: usize,
+        /// free for the next upload
+        cached_buffers: usize,
+        /// handed back while a copy may still read them
+        in_flight_buffers: usize,
+    }
+
+    /// One stream of a batch, its samples in two parts as a ring hands them out.
+    struct SampleSpan<'a> {
+        first: &'a [f32],
+        second: &'a [f32],
+    }
+
+    extern "Rust" {
+        type ReadySignal;
+    }
+
     unsafe extern "C++" {
         type Features = super::features::ffi::Features;
+        type FeaturesBatch = super::features::ffi::FeaturesBatch;
 
         include!("whisper-trtllm-rs/src/sys/mel.h");
 
@@ -19,6 +41,8 @@ pub(crate) mod ffi {
             n_mels: usize,
             n_fft: usize,
             hop_length: usize,
+            device: &str,
+            banded: bool,
         ) -> Result<UniquePtr<LogMelSpectrogram>>;
 
         fn extract(
@@ -28,6 +52,43 @@ pub(crate) mod ffi {
             padding: bool,
         ) -> Result<UniquePtr<Features>>;
 
+        fn power_spectrum(
+            self: &LogMelSpectrogram,
+            first: &[f32],
+            second: &[f32],
+            padding: bool,
+        ) -> Result<UniquePtr<Features>>;
+
+        fn from_power_spectrum(
+            self: &LogMelSpectrogram,
+            power: &Features,
+        ) -> Result<UniquePtr<Features>>;
+
+        type PendingFeatures;
+
+        fn extract_async(
+            self: &LogMelSpectrogram,
+            first: &[f32],
+            second: &[f32],
+            padding: bool,
+        ) -> Result<UniquePtr<PendingFeatures>>;
+
+        fn is_ready(self: &PendingFeatures) -> bool;
+
+        fn on_ready(
+            self: &PendingFeatures,
+            done: fn(signal: Box<ReadySignal>),
+            signal: Box<ReadySignal>,
+        ) -> Result<()>;
+
+        fn features(self: &PendingFeatures) -> Result<UniquePtr<Features>>;
+
+        fn extract_batch(
+            self: &LogMelSpectrogram,
+            spans: &[SampleSpan],
+            padding: bool,
+        ) -> Result<UniquePtr<FeaturesBatch>>;
+
         fn empty(
             self: &LogMelSpectrogram
         ) -> UniquePtr<Features>;
@@ -39,6 +100,14 @@ pub(crate) mod ffi {
         fn hop_length(
             self: &LogMelSpectrogram
         ) -> usize;
+
+        fn filterbank(
+            self: &LogMelSpectrogram
+        ) -> Vec<f32>;
+
+        fn staging_stats(
+            self: &LogMelSpectrogram
+        ) -> StagingStats;
     }
 }
 
@@ -48,20 +117,49 @@ pub(crate) struct LogMelSpectrogram {
 }
 
 impl LogMelSpectrogram {
+    /// Extractor with the built-in Slaney filterbank; nothing is read from disk.
+    pub fn new(
+        n_mels: usize,
+        n_fft: usize,
+        hop_length: usize,
+        device: &str,
+    ) -> Result<Self> {
+        Self::create("", n_mels, n_fft, hop_length, device, true)
+    }
+
+    /// Extractor with the `mel_<n_mels>` filterbank of an npz file.
     pub fn open(
         mel_filter_path: impl AsRef<Path>,
         n_mels: usize,
         n_fft: usize,
         hop_length: usize,
+        device: &str,
     ) -> Result<Self> {
-        let required_overlap_frames = (n_fft / 2 + hop_length - 1) / hop_length;
         let path = mel_filter_path.as_ref().to_str()
             .ok_or_else(|| anyhow!("failed to convert mel filter path to str"))?;
+        if path.is_empty() {
+            return Err(anyhow!("mel filter path is empty"));
+        }
+        Self::create(path, n_mels, n_fft, hop_length, device, true)
+    }
+
+    // banded selects the banded mel projection, dense is for comparison
+    fn create(
+        path: &str,
+        n_mels: usize,
+        n_fft: usize,
+        hop_length: usize,
+        device: &str,
+        banded: bool,
+    ) -> Result<Self> {
+        let required_overlap_frames = (n_fft / 2 + hop_length - 1) / hop_length;
         let ptr = ffi::log_mel_spectrogram(
             path,
             n_mels,
             n_fft,
             hop_length,
+            device,
+            banded,
         ).map_err(|e| anyhow!("failed to create log mel spectrogram: {}", e))?;
 
         Ok(Self { 
@@ -70,6 +168,10 @@ impl LogMelSpectrogram {
         })
     }
 
+    pub(crate) fn inner(&self) -> &ffi::LogMelSpectrogram {
+        &self.ptr
+    }
+
     pub fn n_fft(&self) -> usize {
         self.ptr.n_fft()
     }
@@ -78,6 +180,10 @@ impl LogMelSpectrogram {
         self.ptr.hop_length()
     }
 
+    pub fn filterbank(&self) -> Vec<f32> {
+        self.ptr.filterbank()
+    }
+
     pub fn required_overlap_frames(&self) -> usize {
         self.required_overlap_frames
     }
@@ -96,10 +202,288 @@ impl LogMelSpectrogram {
         Ok(ptr.into())
     }
 
+    // Power spectrum of the frames `extract_final` projects, [n_frames,
+    // n_fft / 2 + 1], so other front ends can reuse the STFT.
+    pub fn power_spectrum(&self, first: &[f32], second: &[f32]) -> Result<Features> {
+        let ptr = self.ptr.power_spectrum(first, second, true)
+            .map_err(|e| anyhow!("failed to compute power spectrum: {}", e))?;
+
+        Ok(ptr.into())
+    }
+
+    // Whisper features of a `power_spectrum`, what `extract_final` returns for
+    // the same samples, so a caller that also feeds `Fbank` runs one STFT.
+    pub fn from_power_spectrum(&self, power: &Features) -> Result<Features> {
+        let ptr = self.ptr.from_power_spectrum(power)
+            .map_err(|e| anyhow!("failed to extract log mel spectrogram: {}", e))?;
+
+        Ok(ptr.into())
+    }
+
+    // Enqueues the extraction without waiting for the upload or the kernels.
+    pub fn extract_async(&self, first: &[f32], second: &[f32]) -> Result<PendingFeatures> {
+        let ptr = self.ptr.extract_async(first, second, false)
+            .map_err(|e| anyhow!("failed to extract log mel spectrogram: {}", e))?;
+
+        Ok(PendingFeatures { ptr })
+    }
+
+    pub fn extract_final_async(&self, first: &[f32], second: &[f32]) -> Result<PendingFeatures> {
+        let ptr = self.ptr.extract_async(first, second, true)
+            .map_err(|e| anyhow!("failed to extract log mel spectrogram: {}", e))?;
+
+        Ok(PendingFeatures { ptr })
+    }
+
+    // Extracts every (first, second) span in one batched pass; the result
+    // holds one Features per span, in order.
+    pub fn extract_batch(&self, spans: &[(&[f32], &[f32])]) -> Result<Vec<Features>> {
+        self.extract_batch_impl(spans, false)
+    }
+
+    pub fn extract_batch_final(&self, spans: &[(&[f32], &[f32])]) -> Result<Vec<Features>> {
+        self.extract_batch_impl(spans, true)
+    }
+
+    fn extract_batch_impl(&self, spans: &[(&[f32], &[f32])], padding: bool) -> Result<Vec<Features>> {
+        // the samples are only read where they are, by the upload or the CPU pass
+        let spans: Vec<_> = spans.iter()
+            .map(|&(first, second)| ffi::SampleSpan { first, second })
+            .collect();
+
+        let batch = self.ptr.extract_batch(&spans, padding)
+            .map_err(|e| anyhow!("failed to extract log mel spectrogram batch: {}", e))?;
+
+        (0..batch.len())
+            .map(|i| {
+                batch.get(i)
+                    .map(Features::from)
+                    .map_err(|e| anyhow!("failed to get batch features: {}", e))
+            })
+            .collect()
+    }
+
     pub fn empty(&self) -> Features {
         self.ptr.empty().into()
     }
 }
 
 unsafe impl Send for LogMelSpectrogram {}
-unsafe impl Sync for LogMelSpectrogram {}
\ No newline at end of file
+unsafe impl Sync for LogMelSpectrogram {}
+
+pub(crate) struct PendingFeatures {
+    ptr: UniquePtr<ffi::PendingFeatures>,
+}
+
+impl PendingFeatures {
+    pub fn is_ready(&self) -> bool {
+        self.ptr.is_ready()
+    }
+
+    // Blocks the calling thread until the features are computed.
+    pub fn wait(self) -> Result<Features> {
+        let ptr = self.ptr.features()
+            .map_err(|e| anyhow!("failed to extract log mel spectrogram: {}", e))?;
+
+        Ok(ptr.into())
+    }
+
+    // Resolves once the extraction completes; the device wakes the task.
+    pub async fn ready(self) -> Result<Features> {
+        let (sender, receiver) = oneshot::channel();
+        self.ptr.on_ready(ready_signalled, Box::new(ReadySignal(sender)))
+            .map_err(|e| anyhow!("failed to wait for log mel spectrogram: {}", e))?;
+        receiver.await
+            .map_err(|_| anyhow!("log mel spectrogram extraction was dropped"))?;
+        self.wait()
+    }
+}
+
+// Sent from the CUDA host callback when an extraction completes.
+struct ReadySignal(oneshot::Sender<()>);
+
+fn ready_signalled(signal: Box<ReadySignal>) {
+    let _ = signal.0.send(());
+}
+
+unsafe impl Send for PendingFeatures {}
+
+#[cfg(test)]
+mod tests {
+    use super::LogMelSpectrogram;
+    use crate::sys::testing::ffi::mel_projection_nanos;
+    use std::time::Instant;
+
+    const MEL_FILTER_PATH: &str = "models/whisper_turbo/mel_filters.npz";
+
+    fn open(device: &str) -> LogMelSpectrogram {
+        LogMelSpectrogram::open(MEL_FILTER_PATH, 128, 400, 160, device).unwrap()
+    }
+
+    fn samples(n: usize) -> Vec<f32> {
+        (0..n).map(|i| {
+            let t = i as f32 / 16000.0;
+            0.5 * (2.0 * std::f32::consts::PI * 440.0 * t).sin() + 0.1 * (i % 7) as f32 / 7.0
+        }).collect()
+    }
+
+    #[test]
+    fn test_staging_pool() {
+        assert_eq!(crate::sys::testing::ffi::staging_pool_errors(), 0);
+    }
+
+    /// Needs a CUDA device.
+    #[test]
+    #[ignore]
+    fn test_uploads_reuse_staging_buffers() {
+        let extractor = open("cuda");
+        let audio = samples(30 * 16000);
+        for _ in 0..3 {
+            extractor.extract(&audio, &[]).unwrap();
+        }
+        let warm = extractor.inner().staging_stats();
+        assert!(warm.allocated_bytes > 0);
+
+        for _ in 0..20 {
+            extractor.extract(&audio, &[]).unwrap();
+        }
+        let stats = extractor.inner().staging_stats();
+        assert_eq!(stats.allocated_bytes, warm.allocated_bytes);
+        assert!(stats.cached_buffers + stats.in_flight_buffers > 0);
+
+        // samples are read in place on the CPU
+        let cpu = open("cpu");
+        cpu.extract(&audio, &[]).unwrap();
+        assert_eq!(cpu.inner().staging_stats().allocated_bytes, 0);
+    }
+
+    #[test]
+    fn test_builtin_filters_match_npz() {
+        for n_mels in [80, 128] {
+            let builtin = LogMelSpectrogram::new(n_mels, 400, 160, "cpu").unwrap();
+            let shipped = LogMelSpectrogram::open(MEL_FILTER_PATH, n_mels, 400, 160, "cpu").unwrap();
+
+            let (a, b) = (builtin.filterbank(), shipped.filterbank());
+            assert_eq!(a.len(), n_mels * 201);
+            assert_eq!(a.len(), b.len());
+
+            let max_diff = a.iter().zip(b.iter())
+                .map(|(x, y)| (x - y).abs())
+                .fold(0.0f32, f32::max);
+            assert!(max_diff < 1e-6, "n_mels {n_mels}: max diff {max_diff}");
+        }
+    }
+
+    /// Needs a CUDA device.
+    #[test]
+    #[ignore]
+    fn test_cpu_matches_cuda() {
+        let (cpu, cuda) = (open("cpu"), open("cuda"));
+        let audio = samples(30 * 16000 + 123);
+        let (first, second) = audio.split_at(7 * 16000);
+
+        for final_chunk in [false, true] {
+            let (a, b) = if final_chunk {
+                (cpu.extract_final(first, second).unwrap(), cuda.extract_final(first, second).unwrap())
+            } else {
+                (cpu.extract(first, second).unwrap(), cuda.extract(first, second).unwrap())
+            };
+            assert_eq!(a.len(), b.len());
+
+            let max_diff = a.to_vec().iter().zip(b.to_vec().iter())
+                .map(|(x, y)| (x - y).abs())
+                .fold(0.0f32, f32::max);
+            assert!(max_diff < 1e-2, "max diff {max_diff}");
+        }
+    }
+
+    #[test]
+    fn test_extract_batch_matches_extract() {
+        let extractor = open("cpu");
+        let audio = samples(20 * 16000);
+        let spans: Vec<(&[f32], &[f32])> = vec![
+            (&audio[..16000], &audio[16000..32000]),
+            (&audio[..5000], &[]),
+            (&[], &[]),
+            (&audio[3000..], &[]),
+        ];
+
+        for final_chunk in [false, true] {
+            let batch = if final_chunk {
+                extractor.extract_batch_final(&spans).unwrap()
+            } else {
+                extractor.extract_batch(&spans).unwrap()
+            };
+            assert_eq!(batch.len(), spans.len());
+
+            for ((first, second), features) in spans.iter().zip(batch.iter()) {
+                let single = if final_chunk {
+                    extractor.extract_final(first, second).unwrap()
+                } else {
+                    extractor.extract(first, second).unwrap()
+                };
+                assert_eq!(single.len(), features.len());
+                assert_eq!(single.to_vec(), features.to_vec());
+            }
+        }
+    }
+
+    #[test]
+    fn test_extract_async_matches_extract() {
+        let extractor = open("cpu");
+        let audio = samples(3 * 16000 + 17);
+        let (first, second) = audio.split_at(16000);
+
+        let pending = extractor.extract_final_async(first, second).unwrap();
+        assert!(pending.is_ready());
+        let features = pending.wait().unwrap();
+        assert_eq!(features.to_vec(), extractor.extract_final(first, second).unwrap().to_vec());
+    }
+
+    #[test]
+    #[ignore]
+    fn bench_extract() {
+        let audio = samples(30 * 16000);
+        for device in ["cuda", "cpu"] {
+            let extractor = open(device);
+            extractor.extract(&audio, &[]).unwrap();
+
+            let n = 50;
+            let start = Instant::now();
+            for _ in 0..n {
+                extractor.extract(&audio, &[]).unwrap();
+            }
+            println!("{device}: {:?} per 30 s window", start.elapsed() / n);
+        }
+    }
+
+    fn open_projection(device: &str, banded: bool) -> LogMelSpectrogram {
+        LogMelSpectrogram::create(MEL_FILTER_PATH, 128, 400, 160, device, banded).unwrap()
+    }
+
+    #[test]
+    fn test_banded_matches_dense() {
+        let audio = samples(5 * 16000);
+
+        let banded = open_projection("cpu", true).extract(&audio, &[]).unwrap().to_vec();
+        let dense = open_projection("cpu", false).extract(&audio, &[]).unwrap().to_vec();
+
+        let max_diff = banded.iter().zip(dense.iter())
+            .map(|(x, y)| (x - y).abs())
+            .fold(0.0f32, f32::max);
+        assert!(max_diff < 1e-3, "max diff {max_diff}");
+    }
+
+    /// Times the mel projection alone, without the FFT or normalization.
+    #[test]
+    #[ignore]
+    fn bench_mel_projection() {
+        for device in ["cuda", "cpu"] {
+            for banded in [false, true] {
+                let nanos = mel_projection_nanos(device, banded, 3000, 50);
+                let projection = if banded { "banded" } else { "dense" };
+                println!("{device} {projection}: {:.1} us per 30 s window", nanos / 1000.0);
+            }
+        }
+    }
+}
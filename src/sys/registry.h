@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// Fixed-capacity table of per-request values keyed by request id, without
+// locks: open addressing from id % capacity with linear probing, an atomic id
+// per slot, and tombstones for erased entries that later inserts reuse.
+//
+// Executor ids are handed out in increasing order, so an entry nearly always
+// sits in its home slot; max_probe() bounds every scan, which keeps find()
+// wait-free. Any thread may insert, find and erase, but each id is inserted
+// by one thread only: two racing inserts of the same id could both claim a
+// slot. The values stay constructed when their entry is erased and are
+// handed to the next id to land in the slot, so the owner of a value resets
+// it on first use and is responsible for synchronizing access to it.
+template <typename Value>
+class SlotTable {
+    public:
+        using Id = uint64_t;
+
+        // ids 0 and max are reserved
+        static constexpr Id EMPTY = 0;
+        static constexpr Id TOMBSTONE = std::numeric_limits<Id>::max();
+
+        struct Slot {
+            std::atomic<Id> id{EMPTY};
+            Value value;
+        };
+
+        // capacity is rounded up to a power of two
+        explicit SlotTable(
+            const size_t capacity = 4096
+        ) : capacity_(round_up(capacity)),
+            mask_(capacity_ - 1),
+            slots_(std::make_unique<Slot[]>(capacity_))
+        {}
+
+        size_t capacity() const {
+            return capacity_;
+        }
+
+        // the longest distance from its home slot any entry was placed at
+        size_t max_probe() const {
+            return max_probe_.load(std::memory_order_acquire);
+        }
+
+        // The slot of id, claimed if id is absent; nullptr when the table
+        // is full.
+        Slot* insert(const Id id) {
+            const size_t home = id & mask_;
+            for (size_t probe = 0; probe < capacity_; probe++) {
+                Slot& slot = slots_[(home + probe) & mask_];
+                Id current = slot.id.load(std::memory_order_acquire);
+                if (current == id) {
+                    return &slot;
+                }
+                if (current != EMPTY && current != TOMBSTONE) {
+                    continue;
+                }
+
+                // finds must look this far before the id can land here
+                raise_max_probe(probe);
+                while (current == EMPTY || current == TOMBSTONE) {
+                    if (slot.id.compare_exchange_weak(current, id, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                        return &slot;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        // Wait-free: looks at no more than max_probe() + 1 slots.
+        Slot* find(const Id id) const {
+            const size_t home = id & mask_;
+            const size_t limit = max_probe();
+            for (size_t probe = 0; probe <= limit; probe++) {
+                Slot& slot = slots_[(home + probe) & mask_];
+                const Id current = slot.id.load(std::memory_order_acquire);
+                if (current == id) {
+                    return &slot;
+                }
+                if (current == EMPTY) {
+                    return nullptr;
+                }
+            }
+            return nullptr;
+        }
+
+        bool erase(const Id id) {
+            const size_t home = id & mask_;
+            const size_t limit = max_probe();
+            bool erased = false;
+            for (size_t probe = 0; probe <= limit; probe++) {
+                Slot& slot = slots_[(home + probe) & mask_];
+                Id current = id;
+                if (slot.id.compare_exchange_strong(current, TOMBSTONE, std::memory_order_acq_rel)) {
+                    erased = true;
+                } else if (current == EMPTY) {
+                    break;
+                }
+            }
+            return erased;
+        }
+
+        // live entries, exact once concurrent updates have settled
+        size_t size() const {
+            size_t n = 0;
+            for (size_t i = 0; i < capacity_; i++) {
+                const Id current = slots_[i].id.load(std::memory_order_acquire);
+                n += current != EMPTY && current != TOMBSTONE ? 1 : 0;
+            }
+            return n;
+        }
+
+    private:
+        static size_t round_up(const size_t n) {
+            size_t p = 1;
+            while (p < n) {
+                p <<= 1;
+            }
+            return p;
+        }
+
+        void raise_max_probe(const size_t probe) {
+            size_t current = max_probe_.load(std::memory_order_relaxed);
+            while (current < probe && !max_probe_.compare_exchange_weak(current, probe, std::memory_order_acq_rel)) {
+            }
+        }
+
+        size_t capacity_;
+        size_t mask_;
+        std::unique_ptr<Slot[]> slots_;
+        std::atomic<size_t> max_probe_{0};
+};
@@ -0,0 +1,23 @@
+// The SlotTable behind the logits processor's request contexts, through the
+// self-checks in src/sys/testing/registry.cpp.
+
+use super::testing::ffi::{bench_request_registry, request_registry_errors};
+
+#[test]
+fn test_slot_table_under_contention() {
+    for n_threads in [1, 4, 16] {
+        assert_eq!(request_registry_errors(n_threads, 5000), 0, "{n_threads} threads");
+    }
+}
+
+#[test]
+#[ignore]
+fn bench_slot_table_against_mutex() {
+    for n_threads in [1, 2, 4, 8, 16, 32] {
+        let bench = bench_request_registry(n_threads, 200_000);
+        println!(
+            "{n_threads} threads: mutex {:.0} ns, slot table {:.0} ns per request, max probe {}",
+            bench.mutex_nanos, bench.slot_nanos, bench.max_probe,
+        );
+    }
+}
@@ -0,0 +1,149 @@
+#include "whisper-trtllm-rs/src/sys/resample.h"
+#include "whisper-trtllm-rs/src/sys/simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    // passband edge relative to the lower Nyquist frequency
+    const double ROLLOFF = 0.945;
+    // Kaiser beta, about 90 dB stopband attenuation
+    const double KAISER_BETA = 9.0;
+
+    // zeroth order modified Bessel function of the first kind
+    double bessel_i0(const double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 64; k++) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < sum * 1e-17) {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    double sinc(const double x) {
+        return x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+    }
+}
+
+Resampler::Resampler(
+    const size_t in_rate,
+    const size_t out_rate,
+    const size_t zero_crossings
+) : in_rate_(in_rate),
+    out_rate_(out_rate),
+    start_(0),
+    n_in_(0),
+    n_out_(0),
+    flushed_(false) {
+    if (in_rate == 0 || out_rate == 0 || zero_crossings == 0) {
+        throw std::invalid_argument("resampler rates and zero crossings must be positive");
+    }
+
+    auto g = std::gcd(in_rate, out_rate);
+    up_ = out_rate / g;
+    down_ = in_rate / g;
+
+    // cutoff in cycles per input sample (1 = input Nyquist)
+    const double cutoff = ROLLOFF * std::min(1.0, static_cast<double>(up_) / static_cast<double>(down_));
+    half_taps_ = static_cast<size_t>(std::ceil(static_cast<double>(zero_crossings) / cutoff));
+    const size_t taps = 2 * half_taps_;
+    const double i0_beta = bessel_i0(KAISER_BETA);
+
+    // phase p interpolates at input time base + p / up_; tap k reads input
+    // sample base - half_taps_ + 1 + k
+    phases_.resize(up_ * taps);
+    for (uint64_t p = 0; p < up_; p++) {
+        float* coeffs = phases_.data() + p * taps;
+        double sum = 0.0;
+        for (size_t k = 0; k < taps; k++) {
+            const double t = static_cast<double>(p) / static_cast<double>(up_)
+                + static_cast<double>(half_taps_) - 1.0 - static_cast<double>(k);
+            const double r = t / static_cast<double>(half_taps_);
+            double w = 0.0;
+            if (std::abs(r) < 1.0) {
+                w = bessel_i0(KAISER_BETA * std::sqrt(1.0 - r * r)) / i0_beta;
+            }
+            const double h = cutoff * sinc(cutoff * t) * w;
+            coeffs[k] = static_cast<float>(h);
+            sum += h;
+        }
+        // unity gain at DC for every phase
+        for (size_t k = 0; k < taps; k++) {
+            coeffs[k] = static_cast<float>(coeffs[k] / sum);
+        }
+    }
+
+    history_.assign(half_taps_ - 1, 0.0f);
+}
+
+void Resampler::process(
+    const std::span<const float> in,
+    std::vector<float>& out
+) {
+    if (flushed_) {
+        throw std::logic_error("resampler already flushed");
+    }
+
+    history_.insert(history_.end(), in.begin(), in.end());
+    n_in_ += in.size();
+
+    // output j needs padded samples up to (j * down_) / up_ + 2 * half_taps_
+    const uint64_t padded = n_in_ + half_taps_ - 1;
+    if (padded < 2 * half_taps_) {
+        return;
+    }
+    const uint64_t last_base = padded - 2 * half_taps_;
+    emit(((last_base + 1) * up_ - 1) / down_ + 1, out);
+}
+
+void Resampler::flush(std::vector<float>& out) {
+    if (flushed_) {
+        return;
+    }
+    flushed_ = true;
+
+    // every output up to the end of the input, reading zeros past it
+    const uint64_t total = (n_in_ * up_ + down_ - 1) / down_;
+    history_.insert(history_.end(), half_taps_ + 1, 0.0f);
+    emit(total, out);
+}
+
+void Resampler::emit(const uint64_t n_outputs, std::vector<float>& out) {
+    if (n_outputs <= n_out_) {
+        return;
+    }
+
+    const auto& kernels = simd::kernels();
+    const size_t taps = 2 * half_taps_;
+
+    out.reserve(out.size() + (n_outputs - n_out_));
+    for (; n_out_ < n_outputs; n_out_++) {
+        const uint64_t position = n_out_ * down_;
+        const uint64_t base = position / up_;
+        const uint64_t phase = position % up_;
+        out.push_back(kernels.dot(
+            phases_.data() + phase * taps,
+            history_.data() + (base - start_),
+            taps
+        ));
+    }
+
+    // keep what the next output reads
+    const uint64_t next_base = n_out_ * down_ / up_;
+    const size_t drop = std::min<uint64_t>(next_base - start_, history_.size());
+    history_.erase(history_.begin(), history_.begin() + drop);
+    start_ += drop;
+}
+
+void Resampler::append(rust::Vec<float>& out) const {
+    out.reserve(out.size() + scratch_.size());
+    for (auto sample : scratch_) {
+        out.push_back(sample);
+    }
+}
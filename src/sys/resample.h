@@ -0,0 +1,88 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+
+#include "rust/cxx.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Streaming rational resampler (polyphase FIR). The conversion in_rate ->
+// out_rate is reduced to up / down; output sample j sits at input time
+// j * down / up and is one dot product of a Kaiser-windowed sinc phase with
+// 2 * half_taps consecutive input samples, run through the SIMD dot kernel.
+// Input may arrive in chunks of any size: the samples still needed by later
+// outputs are carried over, so chunked and one-shot output are identical.
+class Resampler {
+    public:
+        Resampler(
+            const size_t in_rate,
+            const size_t out_rate = SAMPLE_RATE,
+            const size_t zero_crossings = 16
+        );
+
+        size_t in_rate() const {
+            return in_rate_;
+        }
+
+        size_t out_rate() const {
+            return out_rate_;
+        }
+
+        // Appends the output samples completed by these input samples.
+        void process(
+            const std::span<const float> in,
+            std::vector<float>& out
+        );
+
+        // Appends the remaining output, treating the input as zero past its end.
+        void flush(std::vector<float>& out);
+
+        // rust ffi
+        inline void process(
+            const rust::Slice<const float> in,
+            rust::Vec<float>& out
+        ) {
+            scratch_.clear();
+            process(std::span<const float>(in.data(), in.size()), scratch_);
+            append(out);
+        }
+
+        // rust ffi
+        inline void flush(rust::Vec<float>& out) {
+            scratch_.clear();
+            flush(scratch_);
+            append(out);
+        }
+
+    private:
+        void emit(const uint64_t n_outputs, std::vector<float>& out);
+
+        void append(rust::Vec<float>& out) const;
+
+        size_t in_rate_;
+        size_t out_rate_;
+        uint64_t up_;
+        uint64_t down_;
+        size_t half_taps_;
+        // up_ phases of 2 * half_taps_ coefficients each
+        std::vector<float> phases_;
+        // input preceded by half_taps_ - 1 zeros; history_[0] is sample start_
+        std::vector<float> history_;
+        uint64_t start_;
+        uint64_t n_in_;
+        uint64_t n_out_;
+        bool flushed_;
+        std::vector<float> scratch_;
+};
+
+// rust ffi
+inline std::unique_ptr<Resampler> resampler(
+    const size_t in_rate,
+    const size_t out_rate
+) {
+    return std::make_unique<Resampler>(in_rate, out_rate);
+}
@@ -0,0 +1,90 @@
+#include "whisper-trtllm-rs/src/sys/ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FeatureRing::FeatureRing(
+    const size_t capacity,
+    const size_t n_mels,
+    const torch::TensorOptions& options
+) : storage_(torch::empty({static_cast<int64_t>(std::max<size_t>(capacity, 1)), static_cast<int64_t>(n_mels)}, options)),
+    head_(0),
+    len_(0),
+    initial_capacity_(storage_.size(0)),
+    bytes_(StorageTier::Active) {
+    bytes_.set(storage_.nbytes());
+}
+
+void FeatureRing::push(const torch::Tensor& frames) {
+    const size_t n = frames.size(0);
+    if (n == 0) {
+        return;
+    }
+    if (len_ + n > capacity()) {
+        reserve(std::max({capacity() * 2, len_ + n, initial_capacity_}));
+    } else if (storage_.storage().use_count() > 1) {
+        // a view from frames() is still held: move the frames to fresh
+        // storage instead of writing under it
+        reserve(capacity());
+    }
+
+    const size_t cap = capacity();
+    const size_t tail = (head_ + len_) % cap;
+    const size_t first = std::min(n, cap - tail);
+
+    storage_.slice(0, tail, tail + first).copy_(frames.slice(0, 0, first), /*non_blocking=*/true);
+    if (first < n) {
+        storage_.slice(0, 0, n - first).copy_(frames.slice(0, first, n), /*non_blocking=*/true);
+    }
+    len_ += n;
+}
+
+void FeatureRing::consume(const size_t n) {
+    const size_t amt = std::min(n, len_);
+    if (amt == 0) {
+        return;
+    }
+    head_ = (head_ + amt) % capacity();
+    len_ -= amt;
+    if (len_ == 0) {
+        head_ = 0;
+    }
+}
+
+torch::Tensor FeatureRing::frames(const size_t start, const size_t end) const {
+    if (start > end || end > len_) {
+        throw std::out_of_range("feature ring range out of bounds");
+    }
+
+    const size_t n = end - start;
+    if (n == 0) {
+        return storage_.slice(0, 0, 0);
+    }
+    const size_t cap = capacity();
+    const size_t begin = (head_ + start) % cap;
+
+    if (begin + n <= cap) {
+        return storage_.slice(0, begin, begin + n);
+    }
+    return torch::cat({
+        storage_.slice(0, begin, cap),
+        storage_.slice(0, 0, begin + n - cap)
+    }, 0);
+}
+
+void FeatureRing::reserve(const size_t capacity) {
+    auto storage = torch::empty({static_cast<int64_t>(capacity), storage_.size(1)}, storage_.options());
+    if (len_ > 0) {
+        storage.slice(0, 0, len_).copy_(frames(0, len_));
+    }
+    storage_ = storage;
+    head_ = 0;
+    bytes_.set(storage_.nbytes());
+}
+
+void FeatureRing::release() {
+    storage_ = torch::empty({0, storage_.size(1)}, storage_.options());
+    head_ = 0;
+    len_ = 0;
+    bytes_.set(0);
+}
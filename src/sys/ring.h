@@ -0,0 +1,60 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/tier.h"
+
+#include <torch/torch.h>
+
+// Circular store of feature frames ([capacity, n_mels], preallocated on the
+// feature device). Appending copies only the new frames and consuming just
+// moves the head, so neither depends on how much history is buffered.
+// Views handed out by frames() alias the storage; while one is held, the next
+// push moves the frames to fresh storage rather than overwriting it, so a
+// view never changes under its holder.
+class FeatureRing {
+    public:
+        FeatureRing(
+            const size_t capacity,
+            const size_t n_mels,
+            const torch::TensorOptions& options
+        );
+
+        size_t len() const {
+            return len_;
+        }
+
+        size_t capacity() const {
+            return storage_.size(0);
+        }
+
+        // Appends [n, n_mels] frames, growing the storage if they do not fit.
+        void push(const torch::Tensor& frames);
+
+        // Drops up to n frames from the front.
+        void consume(const size_t n);
+
+        // Frames [start, end) counted from the front: a view when the range
+        // is contiguous in storage, one gather copy when it wraps around.
+        torch::Tensor frames(const size_t start, const size_t end) const;
+
+        void clear() {
+            head_ = 0;
+            len_ = 0;
+        }
+
+        // Drops all frames and frees the storage; the next push reallocates
+        // at least the initial capacity.
+        void release();
+
+        size_t bytes() const {
+            return bytes_.get();
+        }
+
+    private:
+        void reserve(const size_t capacity);
+
+        torch::Tensor storage_;
+        size_t head_;
+        size_t len_;
+        size_t initial_capacity_;
+        TierBytes bytes_;
+};
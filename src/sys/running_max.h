@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <limits>
+#include <utility>
+
+// Maximum of per-frame values over a window sliding along a queue: the window
+// covers the first `window` values after the front, later values wait behind
+// it and enter as consume() moves the front. A monotonic deque keeps the
+// candidates, so push, consume and max are amortized O(1).
+class RunningMax {
+    public:
+        explicit RunningMax(const size_t window) : window_(window) {}
+
+        size_t len() const {
+            return values_.size();
+        }
+
+        size_t window() const {
+            return window_;
+        }
+
+        void push(const float value) {
+            values_.push_back(value);
+            admit();
+        }
+
+        // Drops up to n values from the front.
+        void consume(size_t n) {
+            n = std::min(n, values_.size());
+            values_.erase(values_.begin(), values_.begin() + n);
+            front_ += n;
+            admitted_ = std::max(admitted_, front_);
+            while (!candidates_.empty() && candidates_.front().first < front_) {
+                candidates_.pop_front();
+            }
+            admit();
+        }
+
+        // Maximum of the first n values; the window itself is answered from
+        // the deque, any other span by scanning.
+        float max(size_t n) const {
+            n = std::min(n, values_.size());
+            if (n == 0) {
+                return -std::numeric_limits<float>::infinity();
+            }
+            if (n == admitted_ - front_) {
+                return candidates_.front().second;
+            }
+            return *std::max_element(values_.begin(), values_.begin() + n);
+        }
+
+        void clear() {
+            values_.clear();
+            candidates_.clear();
+            front_ = 0;
+            admitted_ = 0;
+        }
+
+    private:
+        void admit() {
+            while (admitted_ < front_ + values_.size() && admitted_ < front_ + window_) {
+                auto value = values_[admitted_ - front_];
+                while (!candidates_.empty() && candidates_.back().second <= value) {
+                    candidates_.pop_back();
+                }
+                candidates_.emplace_back(admitted_, value);
+                admitted_++;
+            }
+        }
+
+        size_t window_;
+        // absolute index of values_[0] and one past the last value in the window
+        size_t front_ = 0;
+        size_t admitted_ = 0;
+        std::deque<float> values_;
+        // (absolute index, value), values strictly decreasing front to back
+        std::deque<std::pair<size_t, float>> candidates_;
+};
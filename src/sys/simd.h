@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define WHISPER_SIMD_X86 1
+#endif
+
+// Vector kernels for the CPU feature path. Each kernel has a portable scalar
+// version and AVX2/AVX-512 versions compiled with target attributes, so the
+// crate itself builds without -mavx flags; the widest variant the host
+// supports is picked once at startup.
+namespace simd {
+    // out[i] = re[i]^2 + im[i]^2
+    inline void power_scalar(const float* re, const float* im, float* out, const size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = re[i] * re[i] + im[i] * im[i];
+        }
+    }
+
+    // sum(a[i] * b[i])
+    inline float dot_scalar(const float* a, const float* b, const size_t n) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i++) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+#ifdef WHISPER_SIMD_X86
+    __attribute__((target("avx2,fma")))
+    inline void power_avx2(const float* re, const float* im, float* out, const size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            auto r = _mm256_loadu_ps(re + i);
+            auto m = _mm256_loadu_ps(im + i);
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(r, r, _mm256_mul_ps(m, m)));
+        }
+        power_scalar(re + i, im + i, out + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline float dot_avx2(const float* a, const float* b, const size_t n) {
+        auto acc0 = _mm256_setzero_ps();
+        auto acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        }
+        auto acc = _mm256_add_ps(acc0, acc1);
+        auto lo = _mm256_castps256_ps128(acc);
+        auto hi = _mm256_extractf128_ps(acc, 1);
+        lo = _mm_add_ps(lo, hi);
+        lo = _mm_hadd_ps(lo, lo);
+        lo = _mm_hadd_ps(lo, lo);
+        return _mm_cvtss_f32(lo) + dot_scalar(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    inline void power_avx512(const float* re, const float* im, float* out, const size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            auto r = _mm512_loadu_ps(re + i);
+            auto m = _mm512_loadu_ps(im + i);
+            _mm512_storeu_ps(out + i, _mm512_fmadd_ps(r, r, _mm512_mul_ps(m, m)));
+        }
+        if (i < n) {
+            __mmask16 mask = (1u << (n - i)) - 1;
+            auto r = _mm512_maskz_loadu_ps(mask, re + i);
+            auto m = _mm512_maskz_loadu_ps(mask, im + i);
+            _mm512_mask_storeu_ps(out + i, mask, _mm512_fmadd_ps(r, r, _mm512_mul_ps(m, m)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline float dot_avx512(const float* a, const float* b, const size_t n) {
+        auto acc = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc);
+        }
+        if (i < n) {
+            __mmask16 mask = (1u << (n - i)) - 1;
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc);
+        }
+        return _mm512_reduce_add_ps(acc);
+    }
+#endif
+
+    struct Kernels {
+        void (*power)(const float*, const float*, float*, size_t);
+        float (*dot)(const float*, const float*, size_t);
+    };
+
+    inline Kernels select_kernels() {
+#ifdef WHISPER_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return Kernels{power_avx512, dot_avx512};
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return Kernels{power_avx2, dot_avx2};
+        }
+#endif
+        return Kernels{power_scalar, dot_scalar};
+    }
+
+    inline const Kernels& kernels() {
+        static const Kernels k = select_kernels();
+        return k;
+    }
+}
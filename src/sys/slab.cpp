@@ -0,0 +1,52 @@
+#include "whisper-trtllm-rs/src/sys/slab.h"
+
+#include <algorithm>
+
+namespace {
+    // the pool's handle is the only one to the slab and nothing views it
+    bool is_free(const torch::Tensor& slab) {
+        return slab.use_count() == 1 && slab.storage().use_count() == 1;
+    }
+}
+
+SlabPool::SlabPool(
+    const size_t n_frames,
+    const size_t n_mels,
+    const torch::TensorOptions& options,
+    const size_t max_cached
+) : n_frames_(static_cast<int64_t>(n_frames)),
+    n_mels_(static_cast<int64_t>(n_mels)),
+    options_(options),
+    max_cached_(max_cached),
+    bytes_(StorageTier::Active) {
+}
+
+torch::Tensor SlabPool::acquire() {
+    for (const auto& slab : slabs_) {
+        if (is_free(slab)) {
+            return slab;
+        }
+    }
+
+    auto slab = allocate();
+    if (slabs_.size() < max_cached_) {
+        slabs_.push_back(slab);
+        bytes_.set(bytes_.get() + slab.nbytes());
+    }
+    return slab;
+}
+
+void SlabPool::release() {
+    slabs_.clear();
+    bytes_.set(0);
+}
+
+size_t SlabPool::in_use() const {
+    return std::count_if(slabs_.begin(), slabs_.end(), [](const auto& slab) {
+        return !is_free(slab);
+    });
+}
+
+torch::Tensor SlabPool::allocate() const {
+    return torch::empty({n_frames_, n_mels_}, options_);
+}
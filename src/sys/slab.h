@@ -0,0 +1,48 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/tier.h"
+
+#include <torch/torch.h>
+#include <vector>
+
+// Recycles fixed-shape [n_frames, n_mels] tensors, e.g. encoder inputs. A slab
+// is handed out again once the pool holds the only reference to its storage,
+// which covers views and tensors kept by in-flight requests alike, so
+// steady-state acquisition allocates nothing.
+class SlabPool {
+    public:
+        SlabPool(
+            const size_t n_frames,
+            const size_t n_mels,
+            const torch::TensorOptions& options,
+            const size_t max_cached = 4
+        );
+
+        // A free slab with unspecified contents; a fresh allocation when all
+        // cached ones are still referenced.
+        torch::Tensor acquire();
+
+        size_t cached() const {
+            return slabs_.size();
+        }
+
+        size_t in_use() const;
+
+        // Forgets the cached slabs; ones still referenced are freed by
+        // their last holder.
+        void release();
+
+        size_t bytes() const {
+            return bytes_.get();
+        }
+
+    private:
+        torch::Tensor allocate() const;
+
+        int64_t n_frames_;
+        int64_t n_mels_;
+        torch::TensorOptions options_;
+        size_t max_cached_;
+        std::vector<torch::Tensor> slabs_;
+        TierBytes bytes_;
+};
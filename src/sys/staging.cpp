@@ -0,0 +1,171 @@
+#include "whisper-trtllm-rs/src/sys/staging.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <utility>
+
+namespace {
+    // smallest class holds 4096 floats, enough for a 256 ms chunk at 16 kHz
+    const size_t MIN_CLASS_BITS = 12;
+
+    void* host_allocate(size_t bytes) {
+        return ::operator new(bytes);
+    }
+
+    void host_deallocate(void* ptr) {
+        ::operator delete(ptr);
+    }
+}
+
+StagingAllocator host_staging_allocator() {
+    return StagingAllocator{host_allocate, host_deallocate};
+}
+
+StagingPool::Buffer::Buffer(
+    std::shared_ptr<StagingPool> pool,
+    float* data,
+    size_t capacity,
+    size_t size_class
+) : pool_(std::move(pool)),
+    data_(data),
+    capacity_(capacity),
+    size_class_(size_class) {
+}
+
+StagingPool::Buffer::Buffer(Buffer&& other) noexcept
+    : pool_(std::move(other.pool_)),
+      data_(std::exchange(other.data_, nullptr)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      size_class_(other.size_class_) {
+}
+
+StagingPool::Buffer& StagingPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        retire(nullptr);
+        pool_ = std::move(other.pool_);
+        data_ = std::exchange(other.data_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+        size_class_ = other.size_class_;
+    }
+    return *this;
+}
+
+StagingPool::Buffer::~Buffer() {
+    retire(nullptr);
+}
+
+void StagingPool::Buffer::retire(std::shared_ptr<const StagingFence> fence) {
+    if (data_ != nullptr && pool_) {
+        pool_->release(data_, size_class_, std::move(fence));
+    }
+    data_ = nullptr;
+    capacity_ = 0;
+    pool_.reset();
+}
+
+std::shared_ptr<StagingPool> StagingPool::create(
+    const StagingAllocator& allocator,
+    const size_t max_cached_per_class
+) {
+    return std::shared_ptr<StagingPool>(new StagingPool(allocator, max_cached_per_class));
+}
+
+StagingPool::StagingPool(
+    const StagingAllocator& allocator,
+    const size_t max_cached_per_class
+) : allocator_(allocator),
+    max_cached_per_class_(max_cached_per_class),
+    allocated_bytes_(0) {
+}
+
+StagingPool::~StagingPool() {
+    // buffers hold a reference to the pool, so none are outstanding here
+    for (auto& blocks : free_) {
+        for (auto& block : blocks) {
+            if (block.fence) {
+                block.fence->wait();
+            }
+            allocator_.deallocate(block.data);
+        }
+    }
+}
+
+StagingPool::Buffer StagingPool::acquire(const size_t n_floats) {
+    const size_t cls = size_class(n_floats);
+    const size_t capacity = class_capacity(cls);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cls < free_.size()) {
+            auto& blocks = free_[cls];
+            auto it = std::find_if(blocks.begin(), blocks.end(), [](const Block& block) {
+                return !block.fence || block.fence->is_complete();
+            });
+            if (it != blocks.end()) {
+                auto data = it->data;
+                blocks.erase(it);
+                return Buffer(shared_from_this(), data, capacity, cls);
+            }
+        }
+        allocated_bytes_ += capacity * sizeof(float);
+    }
+
+    auto data = static_cast<float*>(allocator_.allocate(capacity * sizeof(float)));
+    if (data == nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        allocated_bytes_ -= capacity * sizeof(float);
+        throw std::bad_alloc();
+    }
+    return Buffer(shared_from_this(), data, capacity, cls);
+}
+
+StagingPool::Stats StagingPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats{allocated_bytes_, 0, 0};
+    for (const auto& blocks : free_) {
+        for (const auto& block : blocks) {
+            if (block.fence && !block.fence->is_complete()) {
+                stats.in_flight_buffers++;
+            } else {
+                stats.cached_buffers++;
+            }
+        }
+    }
+    return stats;
+}
+
+void StagingPool::release(
+    float* data,
+    const size_t size_class,
+    std::shared_ptr<const StagingFence> fence
+) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_.size() <= size_class) {
+        free_.resize(size_class + 1);
+    }
+
+    auto& blocks = free_[size_class];
+    if (blocks.size() < max_cached_per_class_) {
+        blocks.push_back(Block{data, std::move(fence)});
+        return;
+    }
+    allocated_bytes_ -= class_capacity(size_class) * sizeof(float);
+    lock.unlock();
+
+    // the class is full: drop this buffer once nothing reads it any more
+    if (fence) {
+        fence->wait();
+    }
+    allocator_.deallocate(data);
+}
+
+size_t StagingPool::size_class(const size_t n_floats) {
+    const size_t n = std::max<size_t>(n_floats, 1);
+    const size_t bits = std::bit_width(n - 1);
+    return bits > MIN_CLASS_BITS ? bits - MIN_CLASS_BITS : 0;
+}
+
+size_t StagingPool::class_capacity(const size_t size_class) {
+    return size_t(1) << (size_class + MIN_CLASS_BITS);
+}
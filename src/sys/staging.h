@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Completion marker for work that still reads a staging buffer, e.g. a CUDA
+// event recorded after an async host-to-device copy.
+class StagingFence {
+    public:
+        virtual ~StagingFence() = default;
+
+        virtual bool is_complete() const = 0;
+
+        virtual void wait() const = 0;
+
+        // Calls done once the fence completes, without blocking the caller:
+        // right away if it already has, otherwise from whichever thread sees
+        // it complete.
+        virtual void notify(std::function<void()> done) const = 0;
+};
+
+struct StagingAllocator {
+    void* (*allocate)(size_t bytes);
+    void (*deallocate)(void* ptr);
+};
+
+// Plain heap memory; what the pool uses when features live on the CPU.
+StagingAllocator host_staging_allocator();
+
+// Host buffers for audio uploads, reused across calls. Requests are rounded
+// up to power-of-two size classes and every class keeps a short free list.
+// A buffer handed back with a fence is only reused once the fence completes,
+// so callers never have to block on the copy that reads it.
+class StagingPool : public std::enable_shared_from_this<StagingPool> {
+    public:
+        class Buffer {
+            public:
+                Buffer() = default;
+                Buffer(Buffer&& other) noexcept;
+                Buffer& operator=(Buffer&& other) noexcept;
+                Buffer(const Buffer&) = delete;
+                Buffer& operator=(const Buffer&) = delete;
+                ~Buffer();
+
+                float* data() const {
+                    return data_;
+                }
+
+                size_t capacity() const {
+                    return capacity_;
+                }
+
+                // Returns the buffer to the pool, reusable once fence completes.
+                void retire(std::shared_ptr<const StagingFence> fence);
+
+            private:
+                friend class StagingPool;
+
+                Buffer(std::shared_ptr<StagingPool> pool, float* data, size_t capacity, size_t size_class);
+
+                std::shared_ptr<StagingPool> pool_;
+                float* data_ = nullptr;
+                size_t capacity_ = 0;
+                size_t size_class_ = 0;
+        };
+
+        struct Stats {
+            size_t allocated_bytes;
+            size_t cached_buffers;
+            size_t in_flight_buffers;
+        };
+
+        static std::shared_ptr<StagingPool> create(
+            const StagingAllocator& allocator,
+            const size_t max_cached_per_class = 8
+        );
+
+        ~StagingPool();
+
+        Buffer acquire(const size_t n_floats);
+
+        Stats stats() const;
+
+    private:
+        struct Block {
+            float* data;
+            std::shared_ptr<const StagingFence> fence;
+        };
+
+        StagingPool(const StagingAllocator& allocator, const size_t max_cached_per_class);
+
+        void release(float* data, const size_t size_class, std::shared_ptr<const StagingFence> fence);
+
+        static size_t size_class(const size_t n_floats);
+
+        static size_t class_capacity(const size_t size_class);
+
+        StagingAllocator allocator_;
+        size_t max_cached_per_class_;
+
+        mutable std::mutex mutex_;
+        std::vector<std::vector<Block>> free_;
+        size_t allocated_bytes_;
+};
@@ -0,0 +1,128 @@
+#include "whisper-trtllm-rs/src/sys/stream.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+LogMelStream::LogMelStream(
+    const LogMelSpectrogram& extractor
+) : extractor_(extractor),
+    n_samples_(0),
+    n_frames_(0),
+    started_(false),
+    flushed_(false) {
+    history_.reserve(extractor_.n_fft() * 2);
+}
+
+torch::Tensor LogMelStream::push(
+    const std::span<const float> samples
+) {
+    return emit(ingest(samples));
+}
+
+std::vector<torch::Tensor> LogMelStream::push_batch(
+    const std::vector<LogMelStream*>& streams,
+    const std::vector<std::span<const float>>& samples
+) {
+    if (streams.size() != samples.size()) {
+        throw std::invalid_argument("one sample span per stream is required");
+    }
+    if (streams.empty()) {
+        return {};
+    }
+
+    std::vector<std::pair<std::span<const float>, size_t>> pending;
+    pending.reserve(streams.size());
+    for (size_t i = 0; i < streams.size(); i++) {
+        auto stream = streams[i];
+        auto n = stream->due(stream->ingest(samples[i]));
+        pending.emplace_back(std::span<const float>(stream->history_.data(), stream->history_.size()), n);
+    }
+
+    auto frames = streams.front()->extractor_.log_mel_frames_batch(pending);
+    for (size_t i = 0; i < streams.size(); i++) {
+        streams[i]->advance(pending[i].second);
+    }
+    return frames;
+}
+
+size_t LogMelStream::ingest(
+    const std::span<const float> samples
+) {
+    if (flushed_) {
+        throw std::logic_error("log mel stream already flushed");
+    }
+
+    history_.insert(history_.end(), samples.begin(), samples.end());
+    n_samples_ += samples.size();
+
+    if (!started_) {
+        // the left reflect padding needs samples [1, n_fft / 2]
+        if (n_samples_ <= extractor_.n_fft() / 2) {
+            return n_frames_;
+        }
+        start();
+    }
+
+    return extractor_.n_frames(n_samples_);
+}
+
+torch::Tensor LogMelStream::flush() {
+    if (flushed_ || n_samples_ == 0) {
+        flushed_ = true;
+        return emit(0);
+    }
+    flushed_ = true;
+
+    auto padding = extractor_.padding_size(n_samples_);
+    history_.insert(history_.end(), padding, 0.0f);
+
+    if (!started_) {
+        start();
+    }
+
+    return emit(extractor_.n_frames(n_samples_ + padding));
+}
+
+void LogMelStream::start() {
+    // prepend the reflection of the first n_fft / 2 samples, as torch::stft
+    // does with center = true and pad_mode = "reflect"
+    const int64_t half = extractor_.n_fft() / 2;
+    const int64_t len = history_.size();
+
+    std::vector<float> prefix(half);
+    for (int64_t i = 0; i < half; i++) {
+        int64_t j = half - i;
+        if (j >= len) {
+            j = 2 * (len - 1) - j;
+        }
+        prefix[i] = history_[std::clamp<int64_t>(j, 0, len - 1)];
+    }
+
+    history_.insert(history_.begin(), prefix.begin(), prefix.end());
+    started_ = true;
+}
+
+torch::Tensor LogMelStream::emit(
+    const size_t n_total_frames
+) {
+    auto n = due(n_total_frames);
+
+    auto frames = extractor_.log_mel_frames(
+        std::span<const float>(history_.data(), history_.size()),
+        n
+    );
+    advance(n);
+
+    return frames;
+}
+
+void LogMelStream::advance(
+    const size_t n
+) {
+    if (n == 0) {
+        return;
+    }
+    n_frames_ += n;
+    auto consumed = std::min(n * extractor_.hop_length(), history_.size());
+    history_.erase(history_.begin(), history_.begin() + consumed);
+}
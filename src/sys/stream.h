@@ -0,0 +1,100 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/mel.h"
+#include "whisper-trtllm-rs/src/sys/features.h"
+
+#include "rust/cxx.h"
+
+#include <torch/torch.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Incremental log-mel extraction for one audio stream. Only the samples that
+// still belong to an incomplete window are kept between calls, so each frame
+// is computed exactly once; flush() applies the same tail padding as
+// extract(..., padding = true). The raw log10 frames are identical to a
+// one-shot extraction of the concatenated audio.
+class LogMelStream {
+    public:
+        explicit LogMelStream(
+            const LogMelSpectrogram& extractor
+        );
+
+        // Returns the raw log10 mel frames completed by these samples.
+        torch::Tensor push(
+            const std::span<const float> samples
+        );
+
+        // push() on several streams of the same extractor configuration,
+        // with one batched extraction for all of them.
+        static std::vector<torch::Tensor> push_batch(
+            const std::vector<LogMelStream*>& streams,
+            const std::vector<std::span<const float>>& samples
+        );
+
+        // Pads the tail and returns the remaining raw frames.
+        torch::Tensor flush();
+
+        size_t n_samples() const {
+            return n_samples_;
+        }
+
+        size_t n_frames() const {
+            return n_frames_;
+        }
+
+        bool is_flushed() const {
+            return flushed_;
+        }
+
+        const LogMelSpectrogram& extractor() const {
+            return extractor_;
+        }
+
+        // rust ffi
+        inline std::unique_ptr<Features> append(
+            const rust::Slice<const float> samples
+        ) {
+            auto frames = push(std::span<const float>(samples.data(), samples.size()));
+            return std::make_unique<Features>(extractor_.normalize(frames));
+        }
+
+        // rust ffi
+        inline std::unique_ptr<Features> finish() {
+            return std::make_unique<Features>(extractor_.normalize(flush()));
+        }
+
+    private:
+        void start();
+
+        // buffers the samples and returns the total frame count they complete
+        size_t ingest(const std::span<const float> samples);
+
+        // frames still to be computed to reach n_total_frames
+        size_t due(const size_t n_total_frames) const {
+            return n_total_frames > n_frames_ ? n_total_frames - n_frames_ : 0;
+        }
+
+        // drops the history of n computed frames
+        void advance(const size_t n);
+
+        torch::Tensor emit(const size_t n_total_frames);
+
+        LogMelSpectrogram extractor_;
+
+        // padded signal from the first sample of frame n_frames_ onward, or
+        // the raw samples while fewer than n_fft / 2 + 1 have arrived
+        std::vector<float> history_;
+        size_t n_samples_;
+        size_t n_frames_;
+        bool started_;
+        bool flushed_;
+};
+
+// rust ffi
+inline std::unique_ptr<LogMelStream> log_mel_stream(
+    const LogMelSpectrogram& extractor
+) {
+    return std::make_unique<LogMelStream>(extractor);
+}
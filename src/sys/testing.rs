@@ -0,0 +1,137 @@
+// Bridge to the C++ self-checks in src/sys/testing, which build.rs compiles
+// into their own archive so that only the test binaries link them.
+#[cxx::bridge]
+pub(crate) mod ffi {
+    /// Step time of the rules over a mock batch of in-flight requests, one
+    /// callback per request against one batched pass.
+    #[derive(Copy, Clone, Debug)]
+    struct BatchedRulesBench {
+        batch_size: usize,
+        per_request_micros: f64,
+        batched_micros: f64,
+        /// requests whose logits differ between the two
+        mismatches: usize,
+    }
+
+    /// Wall time per request lifecycle with `threads` threads at once, each
+    /// running its own requests through the registry.
+    #[derive(Copy, Clone, Debug)]
+    struct RegistryBench {
+        threads: usize,
+        mutex_nanos: f64,
+        slot_nanos: f64,
+        /// longest probe sequence the slot table needed
+        max_probe: usize,
+    }
+
+    /// Latency model and batch limit of the CPU mock executor.
+    #[derive(Copy, Clone, Debug)]
+    pub struct MockConfig {
+        pub max_batch_size: usize,
+        /// per request, when it joins the batch
+        pub encoder_micros: u64,
+        pub step_micros: u64,
+        pub step_micros_per_request: u64,
+    }
+
+    /// Per-step time of one static logit rule, applied with slice fills as
+    /// before and with the bias masks.
+    #[derive(Clone, Debug)]
+    struct LogitRuleBench {
+        rule: String,
+        fill_micros: f64,
+        bias_micros: f64,
+        /// both leave the same logits
+        matches: bool,
+    }
+
+    /// Outcome of running the fused timestamp rules and the per-beam
+    /// reference over the same decode steps.
+    #[derive(Copy, Clone, Debug)]
+    struct TimestampRulesBench {
+        steps: usize,
+        beams: usize,
+        /// beams whose logits differ between the two
+        mismatches: usize,
+        reference_micros: f64,
+        fused_micros: f64,
+    }
+
+    unsafe extern "C++" {
+        include!("whisper-trtllm-rs/src/sys/testing/testing.h");
+
+        type Whisper = crate::sys::whisper::ffi::Whisper;
+
+        fn whisper_mock(
+            config: &MockConfig,
+        ) -> UniquePtr<Whisper>;
+
+        fn registered_requests(
+            whisper: &Whisper,
+        ) -> usize;
+
+        fn feature_ring_errors(
+            capacity: usize,
+        ) -> usize;
+
+        fn staging_pool_errors() -> usize;
+
+        fn mel_projection_nanos(
+            device: &str,
+            banded: bool,
+            n_frames: usize,
+            iterations: usize,
+        ) -> f64;
+
+        fn voice_activity_errors() -> usize;
+
+        fn g711_table(
+            alaw: bool,
+        ) -> Vec<f32>;
+
+        fn bench_logit_rules(
+            device: &str,
+            n_beams: usize,
+            iterations: usize,
+        ) -> Result<Vec<LogitRuleBench>>;
+
+        fn bench_request_registry(
+            n_threads: usize,
+            n_requests: usize,
+        ) -> RegistryBench;
+
+        fn request_registry_errors(
+            n_threads: usize,
+            n_requests: usize,
+        ) -> usize;
+
+        fn bench_batched_rules(
+            device: &str,
+            batch_sizes: &[usize],
+            iterations: usize,
+            scattered: bool,
+        ) -> Result<Vec<BatchedRulesBench>>;
+
+        fn decode_state_mismatches(
+            n_steps: usize,
+            beam_width: usize,
+        ) -> usize;
+
+        fn bench_timestamp_rules(
+            path: &str,
+            device: &str,
+            iterations: usize,
+        ) -> Result<TimestampRulesBench>;
+    }
+}
+
+impl Default for ffi::MockConfig {
+    fn default() -> Self {
+        Self {
+            max_batch_size: 64,
+            encoder_micros: 2000,
+            step_micros: 5000,
+            step_micros_per_request: 50,
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#include "whisper-trtllm-rs/src/sys/testing/testing.h"
+#include "whisper-trtllm-rs/src/sys/g711.h"
+
+rust::Vec<float> g711_table(const bool alaw) {
+    const auto& table = alaw ? g711::ALAW : g711::ULAW;
+    rust::Vec<float> out;
+    out.reserve(table.size());
+    for (auto sample : table) {
+        out.push_back(sample);
+    }
+    return out;
+}
@@ -0,0 +1,120 @@
+#include "whisper-trtllm-rs/src/sys/testing.rs.h"
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+#include "whisper-trtllm-rs/src/sys/logits.h"
+
+#include <torch/cuda.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace {
+    // the rules as Logits applied them before the bias masks
+    namespace fill {
+        void suppress_range(torch::Tensor& logits, const int64_t begin, const std::optional<int64_t> end = std::nullopt) {
+            logits.slice(-1, begin, end).fill_(NEG_INF);
+        }
+
+        void suppress_non_languages(torch::Tensor& logits) {
+            suppress_range(logits, 0, token::START_OF_LANGUAGE);
+            suppress_range(logits, token::END_OF_LANGUAGE);
+        }
+
+        void set_transcribe(torch::Tensor& logits) {
+            logits.fill_(NEG_INF);
+            logits.select(-1, token::TRANSCRIBE).fill_(0);
+        }
+
+        void set_eot(torch::Tensor& logits) {
+            logits.fill_(NEG_INF);
+            logits.select(-1, token::END_OF_TEXT).fill_(0);
+        }
+
+        void suppress_timestamps(torch::Tensor& logits) {
+            suppress_range(logits, token::START_OF_TIMESTAMP);
+        }
+
+        void suppress_non_timestamps(torch::Tensor& logits) {
+            suppress_range(logits, 0, token::START_OF_TIMESTAMP);
+        }
+
+        void suppress_blank(torch::Tensor& logits) {
+            torch::Tensor indices = torch::tensor({token::SPACE, token::END_OF_TEXT}, torch::kLong);
+            int64_t n = logits.dim();
+            std::vector<torch::indexing::TensorIndex> idx(n, torch::indexing::Slice());
+            idx[n - 1] = indices;
+            logits.index_put_(idx, NEG_INF);
+        }
+    }
+
+    struct Rule {
+        const char* name;
+        std::function<void(torch::Tensor&)> fill;
+        std::function<void(Logits&)> bias;
+    };
+}
+
+rust::Vec<LogitRuleBench> bench_logit_rules(
+    const rust::Str device,
+    const size_t n_beams,
+    const size_t iterations
+) {
+    const torch::Device target(static_cast<std::string>(device));
+    const int64_t vocab = token::END_OF_TIMESTAMP;
+    auto logits = torch::randn(
+        {1, static_cast<int64_t>(n_beams), vocab},
+        torch::TensorOptions().device(target).dtype(torch::kFloat32)
+    );
+    auto scratch = torch::empty_like(logits);
+
+    BiasMasks masks;
+    const LogitBiases& biases = masks.get(logits);
+
+    const std::vector<Rule> rules = {
+        {"suppress_non_languages", fill::suppress_non_languages, [](Logits& l) { l.suppress_non_languages(); }},
+        {"set_transcribe", fill::set_transcribe, [](Logits& l) { l.set_transcribe(); }},
+        {"set_eot", fill::set_eot, [](Logits& l) { l.set_eot(); }},
+        {"suppress_timestamps", fill::suppress_timestamps, [](Logits& l) { l.suppress_timestamps(); }},
+        {"suppress_non_timestamps", fill::suppress_non_timestamps, [](Logits& l) { l.suppress_non_timestamps(); }},
+        {"suppress_blank", fill::suppress_blank, [](Logits& l) { l.suppress_blank(); }},
+    };
+
+    // each run restores the logits first; that copy is timed on its own and
+    // taken out again
+    auto time = [&](const std::function<void(torch::Tensor&)>& rule) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            scratch.copy_(logits);
+            rule(scratch);
+        }
+        if (target.is_cuda()) {
+            torch::cuda::synchronize();
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / static_cast<double>(std::max<size_t>(iterations, 1));
+    };
+    const double copy_micros = time([](torch::Tensor&) {});
+
+    rust::Vec<LogitRuleBench> results;
+    for (const auto& rule : rules) {
+        auto expected = logits.clone();
+        rule.fill(expected);
+        auto actual = logits.clone();
+        Logits wrapped(actual, biases);
+        rule.bias(wrapped);
+
+        const double fill_micros = time(rule.fill);
+        const double bias_micros = time([&](torch::Tensor& tensor) {
+            Logits wrapped(tensor, biases);
+            rule.bias(wrapped);
+        });
+
+        results.push_back(LogitRuleBench {
+            .rule = rust::String(rule.name),
+            .fill_micros = fill_micros - copy_micros,
+            .bias_micros = bias_micros - copy_micros,
+            .matches = torch::equal(expected, actual)
+        });
+    }
+    return results;
+}
@@ -0,0 +1,75 @@
+#include "whisper-trtllm-rs/src/sys/testing/testing.h"
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+#include "whisper-trtllm-rs/src/sys/mel.h"
+#include "whisper-trtllm-rs/src/sys/simd.h"
+
+#include <torch/torch.h>
+#include <cuda_runtime.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+double mel_projection_nanos(
+    const rust::Str device,
+    const bool banded,
+    const size_t n_frames,
+    const size_t iterations
+) {
+    const auto torch_device = torch::Device(static_cast<std::string>(device));
+    const int64_t n_freqs = N_FFT / 2 + 1;
+    const int64_t frames = n_frames;
+    const size_t n = std::max<size_t>(iterations, 1);
+
+    auto table = mel_filterbank(N_MELS, N_FFT);
+    auto filters = torch::from_blob(
+        const_cast<float*>(table->data()),
+        {static_cast<int64_t>(N_MELS), n_freqs},
+        torch::kFloat32
+    );
+
+    if (torch_device.is_cpu()) {
+        // rows of power spectra, as the FFT emits them, dotted with the bands
+        // the way compute_log_mel does
+        const auto bands = banded ? MelBands::banded(filters) : MelBands::dense(filters);
+        auto power = torch::rand({frames, n_freqs}, torch::kFloat32);
+        std::vector<float> out(n_frames * N_MELS);
+        const auto& kernels = simd::kernels();
+        auto data = power.data_ptr<float>();
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; i++) {
+            for (int64_t r = 0; r < frames; r++) {
+                auto row = out.data() + r * N_MELS;
+                for (size_t m = 0; m < N_MELS; m++) {
+                    row[m] = kernels.dot(
+                        bands.weights.data() + bands.offset[m],
+                        data + r * n_freqs + bands.begin[m],
+                        bands.offset[m + 1] - bands.offset[m]
+                    );
+                }
+            }
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / n;
+    }
+
+    // [n_freqs, n_frames] magnitudes, as the STFT leaves them, through the
+    // sparse or dense product LogMelSpectrogram::project picks
+    auto dense = filters.to(torch_device);
+    auto sparse = banded ? dense.to_sparse_csr() : torch::Tensor();
+    auto power = torch::rand({n_freqs, frames}, torch::TensorOptions().dtype(torch::kFloat32).device(torch_device));
+    auto project = [&] {
+        return banded ? torch::mm(sparse, power) : torch::matmul(dense, power);
+    };
+    project();
+    cudaDeviceSynchronize();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++) {
+        project();
+    }
+    cudaDeviceSynchronize();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / n;
+}
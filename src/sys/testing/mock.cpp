@@ -0,0 +1,230 @@
+#include "whisper-trtllm-rs/src/sys/testing.rs.h"
+#include "whisper-trtllm-rs/src/sys/testing/mock.h"
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+
+#include "tensorrt_llm/executor/tensor.h"
+#include "tensorrt_llm/runtime/torchView.h"
+
+#include <torch/torch.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace tlr = tensorrt_llm::runtime;
+
+MockBackend::MockBackend(
+    const MockConfig& config,
+    tle::LogitsPostProcessorBatched processor
+) : max_batch_size_(std::max<size_t>(config.max_batch_size, 1)),
+    encoder_micros_(config.encoder_micros),
+    step_micros_(config.step_micros),
+    step_micros_per_request_(config.step_micros_per_request),
+    processor_(std::move(processor)),
+    worker_([this] { run(); })
+{}
+
+MockBackend::~MockBackend() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    enqueued_.notify_all();
+    worker_.join();
+}
+
+tle::IdType MockBackend::enqueue(
+    const tle::Request& request
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto id = next_id_++;
+    const auto& prompt = request.getInputTokenIds();
+    queue_.push_back(Sequence {
+        .id = id,
+        .client_id = request.getClientId(),
+        .tokens = tle::BeamTokens{prompt},
+        .prompt_length = prompt.size(),
+        .max_tokens = static_cast<size_t>(request.getMaxTokens()),
+        .return_log_probs = request.getOutputConfig().returnLogProbs
+    });
+    enqueued_.notify_one();
+    return id;
+}
+
+std::vector<tle::Response> MockBackend::await_responses(
+    const std::chrono::milliseconds timeout
+) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    responded_.wait_for(lock, timeout, [this] { return !responses_.empty(); });
+    return std::exchange(responses_, {});
+}
+
+void MockBackend::cancel(
+    const tle::IdType request_id
+) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto queued = std::find_if(queue_.begin(), queue_.end(), [&](const Sequence& sequence) {
+        return sequence.id == request_id;
+    });
+    if (queued == queue_.end()) {
+        // in the batch or done; the worker sorts it out
+        cancelled_.insert(request_id);
+        enqueued_.notify_one();
+        return;
+    }
+
+    auto sequence = std::move(*queued);
+    queue_.erase(queued);
+    lock.unlock();
+    respond(sequence);
+}
+
+tle::TokenIdType MockBackend::scripted(
+    const Sequence& sequence
+) {
+    const size_t generated = sequence.tokens[0].size() - sequence.prompt_length;
+    if (generated == 0) {
+        return token::START_OF_LANGUAGE;
+    }
+    if (generated == 1) {
+        return token::TRANSCRIBE;
+    }
+
+    const size_t position = generated - 2;
+    const size_t n_text = 4 + sequence.id % 8;
+    if (position == 0) {
+        return token::START_OF_TIMESTAMP;
+    }
+    if (position <= n_text) {
+        return static_cast<tle::TokenIdType>(1000 + (sequence.id * 31 + position) % 20000);
+    }
+    if (position == n_text + 1) {
+        return static_cast<tle::TokenIdType>(token::START_OF_TIMESTAMP + 2 * n_text);
+    }
+    return token::END_OF_TEXT;
+}
+
+void MockBackend::run() {
+    std::vector<Sequence> batch;
+    while (true) {
+        size_t admitted = 0;
+        std::vector<Sequence> cancelled;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            enqueued_.wait(lock, [&] {
+                return stopping_ || !queue_.empty() || !batch.empty() || !cancelled_.empty();
+            });
+            if (stopping_) {
+                return;
+            }
+
+            // anything cancelled that isn't in the batch is done already
+            std::vector<Sequence> running;
+            for (auto& sequence : batch) {
+                auto& target = cancelled_.count(sequence.id) > 0 ? cancelled : running;
+                target.push_back(std::move(sequence));
+            }
+            batch = std::move(running);
+            cancelled_.clear();
+
+            while (batch.size() < max_batch_size_ && !queue_.empty()) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+                admitted++;
+            }
+        }
+
+        for (const auto& sequence : cancelled) {
+            respond(sequence);
+        }
+        if (batch.empty()) {
+            continue;
+        }
+
+        const auto latency = encoder_micros_ * admitted
+            + step_micros_ + step_micros_per_request_ * batch.size();
+        std::this_thread::sleep_for(std::chrono::microseconds(latency));
+
+        step(batch);
+    }
+}
+
+void MockBackend::step(
+    std::vector<Sequence>& batch
+) {
+    const int64_t n = static_cast<int64_t>(batch.size());
+    const int64_t vocab = token::END_OF_TIMESTAMP;
+
+    // back to back in one buffer, one [1, 1, vocab] view per request, the
+    // script's token ahead and <|endoftext|> next in case it is suppressed;
+    // the rest low enough that the timestamps together don't outweigh text
+    auto base = torch::full({n, 1, vocab}, -10.0f, torch::kFloat32);
+    auto accessor = base.accessor<float, 3>();
+
+    std::vector<tle::IdType> ids;
+    std::vector<tle::Tensor> logits;
+    std::vector<std::reference_wrapper<tle::BeamTokens const>> tokens;
+    std::vector<std::optional<tle::IdType>> client_ids;
+    for (int64_t i = 0; i < n; i++) {
+        const auto& sequence = batch[i];
+        accessor[i][0][token::END_OF_TEXT] = 0.5f;
+        accessor[i][0][scripted(sequence)] = 1.0f;
+
+        ids.push_back(sequence.id);
+        logits.push_back(tle::detail::ofITensor(tlr::TorchView::of(base.slice(0, i, i + 1))));
+        tokens.push_back(std::cref(sequence.tokens));
+        client_ids.push_back(sequence.client_id);
+    }
+
+    // no stream on the CPU
+    processor_(ids, logits, tokens, nullptr, client_ids);
+
+    const auto next = base.argmax(-1).contiguous();
+    const auto* sampled = next.data_ptr<int64_t>();
+
+    std::vector<Sequence> running;
+    for (int64_t i = 0; i < n; i++) {
+        auto& sequence = batch[i];
+        const auto token = static_cast<tle::TokenIdType>(sampled[i]);
+        if (token != token::END_OF_TEXT) {
+            sequence.tokens[0].push_back(token);
+        }
+
+        const size_t generated = sequence.tokens[0].size() - sequence.prompt_length;
+        if (token == token::END_OF_TEXT || generated >= sequence.max_tokens) {
+            respond(sequence);
+        } else {
+            running.push_back(std::move(sequence));
+        }
+    }
+    batch = std::move(running);
+}
+
+void MockBackend::respond(
+    const Sequence& sequence
+) {
+    tle::Result result;
+    result.isFinal = true;
+    result.isSequenceFinal = true;
+    result.outputTokenIds = sequence.tokens;
+    if (sequence.return_log_probs) {
+        const size_t generated = sequence.tokens[0].size() - sequence.prompt_length;
+        result.cumLogProbs = tle::VecLogProbs{0.0f};
+        result.logProbs = std::vector<tle::VecLogProbs>{tle::VecLogProbs(generated, 0.0f)};
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        responses_.emplace_back(sequence.id, std::move(result), sequence.client_id);
+    }
+    responded_.notify_all();
+}
+
+std::unique_ptr<Whisper> whisper_mock(const MockConfig& config) {
+    return std::make_unique<Whisper>([&](tle::LogitsPostProcessorBatched process_batch) {
+        return std::make_unique<MockBackend>(config, std::move(process_batch));
+    });
+}
+
+size_t registered_requests(const Whisper& whisper) {
+    return whisper.transcribe_logits_processor_.registered();
+}
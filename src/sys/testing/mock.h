@@ -0,0 +1,99 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/backend.h"
+
+#include "tensorrt_llm/executor/executor.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace tle = tensorrt_llm::executor;
+
+struct MockConfig;
+
+// An executor on the CPU for exercising the request, batching and response
+// paths without a GPU or an engine. One worker thread runs in-flight
+// batching: requests wait until one of max_batch_size places is free, pay
+// encoder_micros when admitted, then decode together a step at a time at
+// step_micros plus step_micros_per_request per request in the batch.
+//
+// Every step goes through the batched logits post-processor on CPU tensors
+// laid out as the executor lays them out. The base logits favour a token
+// script, which is a language, <|transcribe|>, then a timestamp, a few text
+// tokens (their number fixed by the request id) and a closing timestamp,
+// then <|endoftext|>; the token taken is the argmax after the processor.
+// Beam width 1 only. A cancelled request gets its final response with the
+// tokens it has so far, before the next step.
+class MockBackend : public ExecutorBackend {
+    public:
+        MockBackend(
+            const MockConfig& config,
+            tle::LogitsPostProcessorBatched processor
+        );
+
+        ~MockBackend() override;
+
+        tle::IdType enqueue(
+            const tle::Request& request
+        ) override;
+
+        std::vector<tle::Response> await_responses(
+            const std::chrono::milliseconds timeout
+        ) override;
+
+        void cancel(
+            const tle::IdType request_id
+        ) override;
+
+    private:
+        struct Sequence {
+            tle::IdType id;
+            std::optional<tle::IdType> client_id;
+            tle::BeamTokens tokens;
+            size_t prompt_length;
+            size_t max_tokens;
+            bool return_log_probs;
+        };
+
+        // the token the script wants next
+        static tle::TokenIdType scripted(
+            const Sequence& sequence
+        );
+
+        void run();
+
+        // one decode step over the batch; finished sequences are responded
+        // to and removed
+        void step(
+            std::vector<Sequence>& batch
+        );
+
+        void respond(
+            const Sequence& sequence
+        );
+
+        size_t max_batch_size_;
+        uint64_t encoder_micros_;
+        uint64_t step_micros_;
+        uint64_t step_micros_per_request_;
+        tle::LogitsPostProcessorBatched processor_;
+
+        std::mutex mutex_;
+        std::condition_variable enqueued_;
+        std::condition_variable responded_;
+        std::deque<Sequence> queue_;
+        // cancelled while in the batch, which only the worker touches
+        std::unordered_set<tle::IdType> cancelled_;
+        std::vector<tle::Response> responses_;
+        tle::IdType next_id_ = 1;
+        bool stopping_ = false;
+
+        // last, so it starts once everything else is set up
+        std::thread worker_;
+};
@@ -0,0 +1,132 @@
+#include "whisper-trtllm-rs/src/sys/testing.rs.h"
+#include "whisper-trtllm-rs/src/sys/registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // stands in for the per-request decode state
+    struct Context {
+        size_t steps = 0;
+    };
+
+    // the steps of a request looked up by the logits processor
+    constexpr size_t LOOKUPS = 4;
+
+    // Ids of thread t: t + 1, t + 1 + n_threads, ..., increasing as the
+    // executor hands them out, and never 0.
+    uint64_t request_id(const size_t thread, const size_t request, const size_t n_threads) {
+        return 1 + thread + request * n_threads;
+    }
+
+    template <typename Lifecycle>
+    double time_threads(const size_t n_threads, const size_t n_requests, Lifecycle lifecycle) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t] {
+                for (size_t r = 0; r < n_requests; r++) {
+                    lifecycle(request_id(t, r, n_threads));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / static_cast<double>(std::max<size_t>(n_requests, 1));
+    }
+}
+
+RegistryBench bench_request_registry(
+    const size_t n_threads,
+    const size_t n_requests
+) {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Context> map;
+    const double mutex_nanos = time_threads(n_threads, n_requests, [&](const uint64_t id) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            map.try_emplace(id);
+        }
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            std::lock_guard<std::mutex> lock(mutex);
+            map.find(id)->second.steps++;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        map.erase(id);
+    });
+
+    SlotTable<Context> table;
+    const double slot_nanos = time_threads(n_threads, n_requests, [&](const uint64_t id) {
+        table.insert(id)->value.steps = 0;
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            table.find(id)->value.steps++;
+        }
+        table.erase(id);
+    });
+
+    return RegistryBench {
+        .threads = n_threads,
+        .mutex_nanos = mutex_nanos,
+        .slot_nanos = slot_nanos,
+        .max_probe = table.max_probe()
+    };
+}
+
+size_t request_registry_errors(
+    const size_t n_threads,
+    const size_t n_requests
+) {
+    // small enough that slots are reused and ids collide on their home slot
+    SlotTable<Context> table(64);
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> done{0};
+
+    // looks up ids the others hold, as the executor thread does, to keep the
+    // slots under contention
+    std::thread reader([&] {
+        for (size_t r = 0; done.load(std::memory_order_acquire) < n_threads; r++) {
+            for (size_t t = 0; t < n_threads; t++) {
+                table.find(request_id(t, r % std::max<size_t>(n_requests, 1), n_threads));
+            }
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t r = 0; r < n_requests; r++) {
+                const uint64_t id = request_id(t, r, n_threads);
+                auto* slot = table.insert(id);
+                if (slot == nullptr) {
+                    errors++;
+                    continue;
+                }
+                // the value is this thread's until the erase
+                slot->value.steps = id;
+                for (size_t i = 0; i < LOOKUPS; i++) {
+                    const auto* found = table.find(id);
+                    if (found != slot || found->value.steps != id) {
+                        errors++;
+                    }
+                }
+                if (!table.erase(id) || table.find(id) != nullptr) {
+                    errors++;
+                }
+            }
+            done++;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    reader.join();
+
+    return errors.load() + table.size();
+}
@@ -0,0 +1,98 @@
+#include "whisper-trtllm-rs/src/sys/testing/testing.h"
+#include "whisper-trtllm-rs/src/sys/ring.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+    // [n, n_mels] frames numbered first, first + 1, ... in every mel bin
+    torch::Tensor numbered(const size_t first, const size_t n, const size_t n_mels) {
+        return torch::arange(static_cast<int64_t>(first), static_cast<int64_t>(first + n), torch::kFloat32)
+            .unsqueeze(1)
+            .expand({static_cast<int64_t>(n), static_cast<int64_t>(n_mels)})
+            .contiguous();
+    }
+
+    // frames not numbered first, first + 1, ...
+    size_t misordered(const torch::Tensor& frames, const size_t first) {
+        auto host = frames.to(torch::kCPU).contiguous();
+        auto data = host.accessor<float, 2>();
+        size_t errors = 0;
+        for (int64_t i = 0; i < host.size(0); i++) {
+            for (int64_t j = 0; j < host.size(1); j++) {
+                if (data[i][j] != static_cast<float>(first + i)) {
+                    errors++;
+                    break;
+                }
+            }
+        }
+        return errors;
+    }
+}
+
+size_t feature_ring_errors(
+    const size_t capacity
+) {
+    const size_t n_mels = 3;
+    FeatureRing ring(capacity, n_mels, torch::TensorOptions().dtype(torch::kFloat32));
+    const size_t initial = ring.capacity();
+
+    // numbers of the first buffered frame and of the next one pushed
+    size_t front = 0;
+    size_t next = 0;
+    size_t errors = 0;
+
+    auto check = [&] {
+        const size_t len = ring.len();
+        errors += len == next - front ? 0 : 1;
+        errors += ring.capacity() >= len ? 0 : 1;
+        errors += misordered(ring.frames(0, len), front);
+
+        // sub-ranges on either side of the wrap and across it
+        const size_t stride = 1 + len / 5;
+        for (size_t start = 0; start < len; start += stride) {
+            for (size_t end = start; end <= len; end += stride) {
+                errors += misordered(ring.frames(start, end), front + start);
+            }
+        }
+    };
+
+    const std::vector<std::pair<size_t, size_t>> steps = {
+        // moves the head in
+        {initial * 3 / 4 + 1, initial / 2},
+        // the tail wraps past the end of the storage
+        {initial / 2 + 1, 1},
+        {1, initial / 4},
+        // outgrows the storage while wrapped
+        {initial + 3, 0},
+        {2 * initial + 1, 2 * initial},
+        {2, 1},
+    };
+    for (const auto& [push, consume] : steps) {
+        ring.push(numbered(next, push, n_mels));
+        next += push;
+        check();
+
+        ring.consume(consume);
+        front = std::min(front + consume, next);
+        check();
+    }
+
+    // it has grown and kept everything in order
+    errors += ring.capacity() > initial ? 0 : 1;
+
+    // consuming everything puts the head back at row 0, so a full push lands
+    // on the rows the held view covers
+    const size_t held = front;
+    const auto view = ring.frames(0, ring.len());
+    ring.consume(ring.len());
+    front = next;
+    const size_t n = ring.capacity();
+    ring.push(numbered(next, n, n_mels));
+    next += n;
+    errors += misordered(view, held);
+    check();
+
+    return errors;
+}
@@ -0,0 +1,132 @@
+#include "whisper-trtllm-rs/src/sys/testing/testing.h"
+#include "whisper-trtllm-rs/src/sys/staging.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    // completes when the test says so
+    class ManualFence : public StagingFence {
+        public:
+            bool is_complete() const override {
+                return complete_.load(std::memory_order_acquire);
+            }
+
+            void wait() const override {
+                while (!is_complete()) {
+                    std::this_thread::yield();
+                }
+            }
+
+            void notify(std::function<void()> done) const override {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!is_complete()) {
+                        waiting_.push_back(std::move(done));
+                        return;
+                    }
+                }
+                done();
+            }
+
+            void complete() {
+                std::vector<std::function<void()>> waiting;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    complete_.store(true, std::memory_order_release);
+                    waiting.swap(waiting_);
+                }
+                for (auto& done : waiting) {
+                    done();
+                }
+            }
+
+        private:
+            std::atomic<bool> complete_{false};
+            mutable std::mutex mutex_;
+            mutable std::vector<std::function<void()>> waiting_;
+    };
+}
+
+size_t staging_pool_errors() {
+    size_t errors = 0;
+    auto expect = [&](const bool ok) {
+        errors += ok ? 0 : 1;
+    };
+    auto pool = StagingPool::create(host_staging_allocator(), 2);
+
+    // a buffer handed back without a fence serves the next request of its
+    // class; the smallest class is whatever a small request gets
+    size_t smallest = 0;
+    float* first = nullptr;
+    {
+        auto buffer = pool->acquire(1000);
+        smallest = buffer.capacity();
+        expect(smallest >= 1000 && (smallest & (smallest - 1)) == 0);
+        first = buffer.data();
+    }
+    {
+        auto buffer = pool->acquire(smallest);
+        expect(buffer.data() == first);
+        expect(pool->stats().allocated_bytes == smallest * sizeof(float));
+    }
+
+    // a larger request grows into the next class
+    {
+        auto buffer = pool->acquire(smallest + 1);
+        expect(buffer.capacity() == 2 * smallest);
+        expect(buffer.data() != first);
+        expect(pool->stats().allocated_bytes == 3 * smallest * sizeof(float));
+    }
+    expect(pool->stats().cached_buffers == 2);
+
+    // retired behind a pending fence: not reused until it completes
+    auto fence = std::make_shared<ManualFence>();
+    {
+        auto buffer = pool->acquire(100);
+        expect(buffer.data() == first);
+        buffer.retire(fence);
+        expect(buffer.data() == nullptr);
+    }
+    auto stats = pool->stats();
+    expect(stats.in_flight_buffers == 1 && stats.cached_buffers == 1);
+    float* second = nullptr;
+    {
+        auto buffer = pool->acquire(100);
+        second = buffer.data();
+        expect(second != first);
+    }
+
+    // waiters hear about the completion once, and only then
+    size_t notified = 0;
+    fence->notify([&] { notified++; });
+    expect(notified == 0);
+    fence->complete();
+    expect(notified == 1);
+    fence->notify([&] { notified++; });
+    expect(notified == 2);
+
+    stats = pool->stats();
+    expect(stats.in_flight_buffers == 0 && stats.cached_buffers == 3);
+    {
+        auto a = pool->acquire(100);
+        auto b = pool->acquire(100);
+        expect((a.data() == first && b.data() == second) || (a.data() == second && b.data() == first));
+    }
+
+    // past max_cached_per_class the extra buffers are freed
+    {
+        std::vector<StagingPool::Buffer> buffers;
+        for (int i = 0; i < 5; i++) {
+            buffers.push_back(pool->acquire(100));
+        }
+        expect(pool->stats().allocated_bytes == 7 * smallest * sizeof(float));
+    }
+    stats = pool->stats();
+    expect(stats.cached_buffers == 3);
+    expect(stats.allocated_bytes == 4 * smallest * sizeof(float));
+
+    return errors;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/whisper.h"
+
+#include "rust/cxx.h"
+
+#include <cstddef>
+#include <memory>
+
+struct BatchedRulesBench;
+
+struct LogitRuleBench;
+
+struct MockConfig;
+
+struct RegistryBench;
+
+struct TimestampRulesBench;
+
+// Self-checks of the C++ side that the Rust tests drive through
+// src/sys/testing.rs. Built into a separate archive that only test binaries
+// reference.
+
+// rust ffi
+//
+// Runs frames numbered 0, 1, ... through a ring of the given initial
+// capacity in uneven pushes and consumes that wrap around the end of the
+// storage and outgrow it, then pushes over the rows of a view that is still
+// held. Counts frames that read back out of order, whole and in sub-ranges,
+// plus lengths or capacities that come out wrong.
+size_t feature_ring_errors(
+    const size_t capacity
+);
+
+// rust ffi
+//
+// Runs a host pool through reuse within a size class, growth into larger
+// classes, fence-gated recycling, completion notifications and the
+// per-class cache limit, and counts the checks that failed.
+size_t staging_pool_errors();
+
+// rust ffi
+//
+// Mean nanoseconds to project the power spectra of n_frames frames onto the
+// built-in mel bands, banded or dense, the way extraction does on the given
+// device, and nothing else.
+double mel_projection_nanos(
+    const rust::Str device,
+    const bool banded,
+    const size_t n_frames,
+    const size_t iterations
+);
+
+// rust ffi: the mu-law or A-law decode table, indexed by code
+rust::Vec<float> g711_table(const bool alaw);
+
+// rust ffi
+//
+// Checks VoiceActivity::statistics() on CPU frames against the same measures
+// taken on the host in double precision, with flux carried across calls, and
+// the span decisions on synthetic statistics. Returns the number of
+// mismatches.
+size_t voice_activity_errors();
+
+// rust ffi
+//
+// Grows random beams with timestamps through a beam search that reorders
+// them every step and counts the steps where the incremental DecodeState
+// differs from a fresh scan.
+size_t decode_state_mismatches(
+    const size_t n_steps,
+    const size_t beam_width
+);
+
+// rust ffi
+//
+// Runs the fused timestamp rules and the per-beam Logits implementation they
+// replaced over the steps recorded in an npz file, or over synthetic steps
+// covering every rule when the path is empty, on the given device. Reports
+// the beams whose logits differ and the time per step.
+TimestampRulesBench bench_timestamp_rules(
+    const rust::Str path,
+    const rust::Str device,
+    const size_t iterations
+);
+
+// rust ffi
+//
+// Per-step time of each static rule on [1, n_beams, vocab] float32 logits,
+// as slice fills and index_put_ like before against the bias masks, less the
+// copy that restores the logits between runs.
+rust::Vec<LogitRuleBench> bench_logit_rules(
+    const rust::Str device,
+    const size_t n_beams,
+    const size_t iterations
+);
+
+// rust ffi
+//
+// Host-side time of one decode step's rules for a mock batch of single-beam
+// in-flight requests, for each batch size: applied request by request, each
+// under the processor lock as the named per-request processors did, against
+// gathered into one apply_batched_rules() pass. Every fourth request detects
+// its language. Scattered requests' logits are not back to back in memory.
+// Mismatches count requests whose logits differ.
+rust::Vec<BatchedRulesBench> bench_batched_rules(
+    const rust::Str device,
+    const rust::Slice<const size_t> batch_sizes,
+    const size_t iterations,
+    const bool scattered
+);
+
+// rust ffi
+//
+// Nanoseconds per request lifecycle (insert, four step lookups, erase) with
+// n_threads threads working at once, on a mutex-guarded unordered_map and on
+// a SlotTable.
+RegistryBench bench_request_registry(
+    const size_t n_threads,
+    const size_t n_requests
+);
+
+// rust ffi
+//
+// Threads insert, look up and erase their own ids while another thread
+// keeps looking up ids of theirs. Counts lookups that missed a live entry
+// and entries left over.
+size_t request_registry_errors(
+    const size_t n_threads,
+    const size_t n_requests
+);
+
+// rust ffi: a Whisper on MockBackend, for the CPU
+std::unique_ptr<Whisper> whisper_mock(const MockConfig& config);
+
+// rust ffi
+//
+// Requests with a context in the whisper's logits processor, none once every
+// enqueued request has had its final response.
+size_t registered_requests(const Whisper& whisper);
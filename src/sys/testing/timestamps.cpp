@@ -0,0 +1,362 @@
+#include "whisper-trtllm-rs/src/sys/testing.rs.h"
+#include "whisper-trtllm-rs/src/sys/timestamps.h"
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+#include "whisper-trtllm-rs/src/sys/logits.h"
+
+#include "cnpy.h"
+
+#include <ATen/CPUGeneratorImpl.h>
+#include <torch/cuda.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+namespace {
+    struct Step {
+        torch::Tensor logits;
+        tle::BeamTokens tokens;
+        bool stop_on_timestamps;
+    };
+
+    std::vector<Step> load_steps(const std::filesystem::path& path) {
+        cnpy::npz_t file = cnpy::npz_load(path.string());
+
+        std::vector<Step> steps;
+        for (size_t i = 0;; i++) {
+            const auto step = std::to_string(i);
+            auto logits = file.find("logits_" + step);
+            auto tokens = file.find("tokens_" + step);
+            auto stop = file.find("stop_" + step);
+            if (logits == file.end() || tokens == file.end() || stop == file.end()) {
+                break;
+            }
+
+            std::vector<int64_t> shape(logits->second.shape.begin(), logits->second.shape.end());
+            // clone, the npz buffer is freed on return
+            auto tensor = torch::from_blob(logits->second.data<void>(), shape, torch::kFloat32).clone();
+
+            const size_t n_beams = tokens->second.shape[0];
+            const size_t n_tokens = tokens->second.shape[1];
+            const int32_t* ids = tokens->second.data<int32_t>();
+            tle::BeamTokens beams(n_beams);
+            for (size_t b = 0; b < n_beams; b++) {
+                for (size_t t = 0; t < n_tokens && ids[b * n_tokens + t] >= 0; t++) {
+                    beams[b].push_back(ids[b * n_tokens + t]);
+                }
+            }
+
+            steps.push_back(Step{tensor, beams, stop->second.data<uint8_t>()[0] != 0});
+        }
+
+        if (steps.empty()) {
+            throw std::invalid_argument("no recorded steps in " + path.string());
+        }
+        return steps;
+    }
+
+    // n_beams beams of n_body tokens behind the task token, text and
+    // monotonic timestamps mixed
+    tle::BeamTokens synthetic_tokens(std::mt19937& rng, const size_t n_beams, const size_t n_body) {
+        tle::BeamTokens beams(n_beams);
+        for (auto& beam : beams) {
+            beam = {token::START_OF_TRANSCRIPT, token::START_OF_LANGUAGE, token::TRANSCRIBE};
+            TokenIdType timestamp = token::START_OF_TIMESTAMP + rng() % 100;
+            for (size_t t = 0; t < n_body; t++) {
+                if (rng() % 5 < 2) {
+                    timestamp = std::min<TokenIdType>(timestamp + rng() % 20, token::END_OF_TIMESTAMP - 1);
+                    beam.push_back(timestamp);
+                } else {
+                    beam.push_back(rng() % token::END_OF_TEXT);
+                }
+            }
+        }
+        return beams;
+    }
+
+    // Random beams behind the task token with monotonic timestamps among the
+    // text, which reach every rule, and logits whose timestamp mass is
+    // shifted so the probability check goes both ways.
+    std::vector<Step> synthetic_steps() {
+        std::mt19937 rng(0);
+        auto generator = at::detail::createCPUGenerator(0);
+        const int64_t vocab = token::END_OF_TIMESTAMP;
+        const size_t beam_widths[] = {1, 1, 2, 5};
+
+        std::vector<Step> steps;
+        for (size_t i = 0; i < 96; i++) {
+            const size_t n_beams = beam_widths[i % 4];
+            auto beams = synthetic_tokens(rng, n_beams, rng() % 12);
+
+            auto logits = 2.0 * torch::randn({static_cast<int64_t>(n_beams), vocab}, generator);
+            const double shift = -6.0 + 8.0 * static_cast<double>(rng() % 1000) / 1000.0;
+            logits.slice(-1, token::START_OF_TIMESTAMP).add_(shift);
+
+            steps.push_back(Step{logits, beams, i % 3 == 0});
+        }
+        return steps;
+    }
+
+    // The rules beam by beam with Logits and Logprobs, as the logits
+    // processor applied them before; two host syncs per beam when the
+    // probability check runs.
+    void apply_timestamp_rules_reference(
+        torch::Tensor tensor,
+        const LogitBiases& biases,
+        const tle::BeamTokens& tokens,
+        const bool stop_on_timestamps
+    ) {
+        Logits logits(tensor, biases);
+
+        auto is_first_text = tokens[0][tokens[0].size() - 2] == token::TRANSCRIBE;
+
+        // suppress notimestamps
+        logits.suppress_notimestamps();
+
+        bool check_timestamps_prob = false;
+
+        for (auto b = 0; b < tokens.size(); b++) {
+            auto beam_logits = logits.beam(b);
+            auto beam_tokens = tokens[b];
+
+            auto n_tokens = beam_tokens.size();
+            bool last_was_timestamp = token::is_timestamp(beam_tokens[n_tokens - 1]);
+            bool penultimate_was_timestamp = is_first_text || token::is_timestamp(beam_tokens[n_tokens - 2]);
+
+            if (last_was_timestamp) {
+                if (penultimate_was_timestamp) {
+                    beam_logits.suppress_timestamps();
+                } else {
+                    if (stop_on_timestamps) {
+                        beam_logits.set_eot();
+                        return;
+                    }
+                    beam_logits.suppress_text();
+                    beam_logits.suppress_timestamps(beam_tokens[n_tokens - 1]);
+                    check_timestamps_prob = true;
+                }
+            } else {
+                for (auto i = n_tokens - 1; beam_tokens[i] != token::TRANSCRIBE; i--) {
+                    auto token = beam_tokens[i];
+                    if (token::is_timestamp(token)) {
+                        beam_logits.suppress_timestamps(token + 1);
+                        break;
+                    }
+                }
+                check_timestamps_prob = true;
+            }
+        }
+
+        if (check_timestamps_prob) {
+            auto logprobs = logits.logprobs();
+            for (auto b = 0; b < tokens.size(); b++) {
+                auto beam_logprobs = logprobs.beam(b);
+                auto timestamps_logprob = beam_logprobs.timestamps().logsumexp();
+
+                auto max_text_logprob = beam_logprobs.non_timestamps().max();
+
+                if (timestamps_logprob > max_text_logprob) {
+                    logits.beam(b).suppress_non_timestamps();
+                }
+            }
+        }
+    }
+}
+
+size_t decode_state_mismatches(
+    const size_t n_steps,
+    const size_t beam_width
+) {
+    std::mt19937 rng(0);
+    auto same = [](const BeamState& a, const BeamState& b) {
+        return a.length == b.length && a.last_token == b.last_token && a.same_rules(b)
+            && a.penultimate_was_timestamp == b.penultimate_was_timestamp;
+    };
+
+    tle::BeamTokens beams(beam_width, {token::START_OF_TRANSCRIPT, token::START_OF_LANGUAGE, token::TRANSCRIBE});
+    DecodeState state;
+    size_t mismatches = 0;
+    for (size_t step = 0; step < n_steps; step++) {
+        // every beam continues a random beam of the last step; the tiny
+        // text vocabulary makes beams share suffixes
+        tle::BeamTokens next;
+        for (size_t b = 0; b < beam_width; b++) {
+            auto beam = beams[rng() % beam_width];
+            if (rng() % 3 == 0) {
+                beam.push_back(token::START_OF_TIMESTAMP + rng() % 4);
+            } else {
+                beam.push_back(rng() % 4);
+            }
+            next.push_back(std::move(beam));
+        }
+        beams = std::move(next);
+
+        state.advance(beams);
+        auto fresh = DecodeState::of(beams);
+        bool matches = state.sample_begin() == fresh.sample_begin()
+            && state.is_first_text() == fresh.is_first_text();
+        for (size_t b = 0; b < beam_width; b++) {
+            matches = matches && same(state.beams()[b], fresh.beams()[b]);
+        }
+        mismatches += matches ? 0 : 1;
+    }
+    return mismatches;
+}
+
+TimestampRulesBench bench_timestamp_rules(
+    const rust::Str path,
+    const rust::Str device,
+    const size_t iterations
+) {
+    const auto location = std::filesystem::path(static_cast<std::string>(path));
+    auto steps = location.empty() ? synthetic_steps() : load_steps(location);
+
+    // [1, n_beams, vocab] in half precision, as the executor hands them over
+    const torch::Device target(static_cast<std::string>(device));
+    for (auto& step : steps) {
+        step.logits = step.logits.to(target, torch::kHalf).unsqueeze(0);
+    }
+
+    BiasMasks masks;
+    const LogitBiases& biases = masks.get(steps[0].logits);
+
+    size_t n_beams = 0;
+    size_t mismatches = 0;
+    for (const auto& step : steps) {
+        auto reference = step.logits.clone();
+        apply_timestamp_rules_reference(reference, biases, step.tokens, step.stop_on_timestamps);
+        auto fused = step.logits.clone();
+        TimestampRules(step.tokens, step.stop_on_timestamps).apply(fused, biases);
+
+        n_beams += step.tokens.size();
+        mismatches += reference.ne(fused).any(-1).sum().item<int64_t>();
+    }
+
+    std::vector<torch::Tensor> scratch;
+    for (const auto& step : steps) {
+        scratch.push_back(torch::empty_like(step.logits));
+    }
+    auto time = [&](auto&& rules) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            for (size_t s = 0; s < steps.size(); s++) {
+                scratch[s].copy_(steps[s].logits);
+                rules(scratch[s], steps[s]);
+            }
+        }
+        if (target.is_cuda()) {
+            torch::cuda::synchronize();
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / static_cast<double>(std::max<size_t>(iterations, 1) * steps.size());
+    };
+
+    const double reference_micros = time([&](torch::Tensor& logits, const Step& step) {
+        apply_timestamp_rules_reference(logits, biases, step.tokens, step.stop_on_timestamps);
+    });
+    const double fused_micros = time([&](torch::Tensor& logits, const Step& step) {
+        TimestampRules(step.tokens, step.stop_on_timestamps).apply(logits, biases);
+    });
+
+    return TimestampRulesBench {
+        .steps = steps.size(),
+        .beams = n_beams,
+        .mismatches = mismatches,
+        .reference_micros = reference_micros,
+        .fused_micros = fused_micros
+    };
+}
+
+rust::Vec<BatchedRulesBench> bench_batched_rules(
+    const rust::Str device,
+    const rust::Slice<const size_t> batch_sizes,
+    const size_t iterations,
+    const bool scattered
+) {
+    const torch::Device target(static_cast<std::string>(device));
+    const int64_t vocab = token::END_OF_TIMESTAMP;
+    std::mt19937 rng(0);
+    auto generator = at::detail::createCPUGenerator(0);
+
+    BiasMasks masks;
+    rust::Vec<BatchedRulesBench> results;
+    for (const size_t batch : batch_sizes) {
+        // one single-beam request per row of a shared buffer, as in flight:
+        // every fourth a language detection, the rest timestamp steps.
+        // Scattered requests take every other row, so no two are back to
+        // back and the rules go through the packed copy instead.
+        const int64_t stride = scattered ? 2 : 1;
+        auto source = 2.0 * torch::randn({static_cast<int64_t>(batch) * stride, 1, vocab}, generator);
+        source = source.to(target, torch::kHalf);
+        auto buffer = torch::empty_like(source);
+        std::vector<torch::Tensor> views;
+        std::vector<tle::BeamTokens> tokens;
+        std::vector<bool> detect;
+        for (size_t r = 0; r < batch; r++) {
+            const int64_t row = static_cast<int64_t>(r) * stride;
+            views.push_back(buffer.slice(0, row, row + 1));
+            tokens.push_back(synthetic_tokens(rng, 1, 1 + rng() % 12));
+            detect.push_back(r % 4 == 0);
+        }
+        const LogitBiases& biases = masks.get(buffer);
+
+        std::mutex mutex;
+        auto per_request = [&]() {
+            for (size_t r = 0; r < batch; r++) {
+                // one callback per request, each taking the processor's lock
+                std::lock_guard<std::mutex> lock(mutex);
+                if (detect[r]) {
+                    Logits logits(views[r], biases);
+                    logits.suppress_non_languages();
+                } else {
+                    TimestampRules(tokens[r], false).apply(views[r], biases);
+                }
+            }
+        };
+        auto batched = [&]() {
+            std::vector<BeamRule> rules;
+            rules.reserve(batch);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t r = 0; r < batch; r++) {
+                    if (detect[r]) {
+                        rules.push_back(BeamRule::languages_only());
+                    } else {
+                        const TimestampRules step(tokens[r], false);
+                        rules.insert(rules.end(), step.beams().begin(), step.beams().end());
+                    }
+                }
+            }
+            apply_batched_rules(views, rules, biases);
+        };
+
+        buffer.copy_(source);
+        per_request();
+        auto expected = buffer.clone();
+        buffer.copy_(source);
+        batched();
+        const size_t mismatches = buffer.ne(expected).flatten(1).any(-1).sum().item<int64_t>();
+
+        auto time = [&](auto&& step) {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; i++) {
+                buffer.copy_(source);
+                step();
+            }
+            if (target.is_cuda()) {
+                torch::cuda::synchronize();
+            }
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / static_cast<double>(std::max<size_t>(iterations, 1));
+        };
+
+        results.push_back(BatchedRulesBench {
+            .batch_size = batch,
+            .per_request_micros = time(per_request),
+            .batched_micros = time(batched),
+            .mismatches = mismatches
+        });
+    }
+    return results;
+}
@@ -0,0 +1,148 @@
+#include "whisper-trtllm-rs/src/sys/testing/testing.h"
+#include "whisper-trtllm-rs/src/sys/vad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace {
+    // the measures VoiceActivity::statistics() takes, see vad.cpp
+    constexpr double DYNAMIC_RANGE = 4.0;
+    constexpr double SPEECH_LO_HZ = 250.0;
+    constexpr double SPEECH_HI_HZ = 4000.0;
+
+    // deterministic frames in [-10, 0), a few loud bins over a low floor
+    std::vector<float> synthetic_frame(uint32_t& seed, const size_t n_mels) {
+        std::vector<float> frame(n_mels);
+        for (auto& value : frame) {
+            seed = seed * 1664525u + 1013904223u;
+            const float unit = static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+            value = unit < 0.1f ? -3.0f * unit * 10.0f : -6.0f - 4.0f * unit;
+        }
+        return frame;
+    }
+
+    // statistics() of one frame after `previous`, the last clamped frame, or
+    // none for the first frame of a stream
+    FrameStatistics host_statistics(
+        const std::vector<float>& frame,
+        std::vector<double>& previous,
+        const size_t lo,
+        const size_t hi
+    ) {
+        const size_t n = frame.size();
+        const double top = *std::max_element(frame.begin(), frame.end());
+        double energy = 0.0, band = 0.0, clamped_sum = 0.0, clamped_power = 0.0;
+        std::vector<double> clamped(n);
+        for (size_t i = 0; i < n; i++) {
+            const double power = std::pow(10.0, frame[i]);
+            energy += power;
+            if (i >= lo && i <= hi) {
+                band += power;
+            }
+            clamped[i] = std::max(static_cast<double>(frame[i]), top - DYNAMIC_RANGE);
+            clamped_sum += clamped[i];
+            clamped_power += std::pow(10.0, clamped[i]);
+        }
+        double flux = 0.0;
+        if (!previous.empty()) {
+            for (size_t i = 0; i < n; i++) {
+                flux += std::abs(clamped[i] - previous[i]);
+            }
+        }
+        previous = clamped;
+        return FrameStatistics{
+            static_cast<float>(std::log10(energy)),
+            static_cast<float>(clamped_sum / n - std::log10(clamped_power / n)),
+            static_cast<float>(flux / n),
+            static_cast<float>(std::log10(band / energy)),
+        };
+    }
+
+    using Spans = std::vector<std::pair<size_t, size_t>>;
+
+    size_t mismatches(const FrameStatistics& a, const FrameStatistics& b) {
+        constexpr float TOLERANCE = 1e-4f;
+        return (std::abs(a.energy - b.energy) > TOLERANCE)
+            + (std::abs(a.flatness - b.flatness) > TOLERANCE)
+            + (std::abs(a.flux - b.flux) > TOLERANCE)
+            + (std::abs(a.band - b.band) > TOLERANCE);
+    }
+}
+
+size_t voice_activity_errors() {
+    const size_t n_mels = 128;
+    const auto lo = mel_bin(SPEECH_LO_HZ, n_mels);
+    const auto hi = mel_bin(SPEECH_HI_HZ, n_mels);
+    size_t errors = 0;
+
+    // uneven calls, so flux has to carry the last frame across each of them
+    VoiceActivity vad(n_mels);
+    std::vector<double> previous;
+    uint32_t seed = 7;
+    for (const size_t n : {1, 5, 2, 17}) {
+        std::vector<float> host;
+        for (size_t i = 0; i < n; i++) {
+            auto frame = synthetic_frame(seed, n_mels);
+            host.insert(host.end(), frame.begin(), frame.end());
+        }
+        auto frames = torch::from_blob(
+            host.data(), {static_cast<int64_t>(n), static_cast<int64_t>(n_mels)}, torch::kFloat32
+        ).clone();
+        auto stats = vad.statistics(frames).contiguous();
+        if (stats.size(0) != static_cast<int64_t>(n) || stats.size(1) != static_cast<int64_t>(VoiceActivity::N_STATISTICS)) {
+            errors++;
+            continue;
+        }
+        auto data = stats.accessor<float, 2>();
+        for (size_t i = 0; i < n; i++) {
+            std::vector<float> frame(host.begin() + i * n_mels, host.begin() + (i + 1) * n_mels);
+            const auto expected = host_statistics(frame, previous, lo, hi);
+            errors += mismatches(FrameStatistics{data[i][0], data[i][1], data[i][2], data[i][3]}, expected);
+        }
+    }
+
+    // a flat frame has zero flatness and a band share of its bin count
+    VoiceActivity flat_vad(n_mels);
+    auto flat = flat_vad.statistics(torch::full({1, static_cast<int64_t>(n_mels)}, -3.0f)).contiguous();
+    auto flat_data = flat.accessor<float, 2>();
+    errors += mismatches(
+        FrameStatistics{flat_data[0][0], flat_data[0][1], flat_data[0][2], flat_data[0][3]},
+        FrameStatistics{
+            static_cast<float>(-3.0 + std::log10(static_cast<double>(n_mels))),
+            0.0f,
+            0.0f,
+            static_cast<float>(std::log10(static_cast<double>(hi - lo + 1) / n_mels)),
+        }
+    );
+
+    // quiet, then 60 frames of changing speech: the flux average crosses
+    // min_flux on the 6th frame, which the run then marks back to, and pad
+    // widens the span on both sides
+    const FrameStatistics quiet{-8.0f, -1.5f, 0.0f, 0.0f};
+    const FrameStatistics speech{-2.0f, -1.5f, 0.5f, -0.1f};
+    VoiceActivity decisions(n_mels);
+    for (size_t i = 0; i < 300; i++) {
+        decisions.push(i >= 40 && i < 100 ? speech : quiet);
+    }
+    errors += decisions.spans() != Spans{{25, 120}};
+    errors += decisions.leading_non_speech(false) != 25;
+    decisions.consume(25);
+    errors += decisions.spans() != Spans{{0, 95}};
+    // the span still pads past the consumed speech
+    decisions.consume(80);
+    errors += decisions.spans() != Spans{{0, 15}};
+
+    // a steady hum is loud and in band but never changes
+    const FrameStatistics hum{-2.0f, -1.5f, 0.0f, -0.1f};
+    VoiceActivity steady(n_mels);
+    for (size_t i = 0; i < 100; i++) {
+        steady.push(hum);
+    }
+    errors += !steady.spans().empty();
+    errors += steady.leading_non_speech(false) != 100 - VadOptions().pad;
+    errors += steady.leading_non_speech(true) != 100;
+
+    return errors;
+}
@@ -0,0 +1,80 @@
+#include "whisper-trtllm-rs/src/sys/tier.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+    std::atomic<size_t> active_bytes{0};
+    std::atomic<size_t> parked_bytes{0};
+
+    std::atomic<size_t>& counter(const StorageTier tier) {
+        return tier == StorageTier::Active ? active_bytes : parked_bytes;
+    }
+
+    const int64_t INT8_LEVELS = 254;
+}
+
+TierUsage tier_usage() {
+    return TierUsage{
+        active_bytes.load(std::memory_order_relaxed),
+        parked_bytes.load(std::memory_order_relaxed),
+    };
+}
+
+void TierBytes::set(const size_t bytes) {
+    auto& total = counter(tier_);
+    if (bytes >= bytes_) {
+        total.fetch_add(bytes - bytes_, std::memory_order_relaxed);
+    } else {
+        total.fetch_sub(bytes_ - bytes, std::memory_order_relaxed);
+    }
+    bytes_ = bytes;
+}
+
+ParkedFrames::ParkedFrames() : bytes_(StorageTier::Parked) {
+}
+
+void ParkedFrames::store(const torch::Tensor& frames, const bool quantize) {
+    clear();
+    if (frames.size(0) == 0) {
+        return;
+    }
+
+    if (quantize) {
+        // quantized where the frames are, so only int8 crosses to the host
+        auto hi = frames.amax(1, /*keepdim=*/true);
+        auto lo = torch::maximum(frames.amin(1, /*keepdim=*/true), hi - 8.0);
+        auto offset = (hi + lo) / 2.0;
+        auto scale = torch::clamp_min((hi - lo) / static_cast<double>(INT8_LEVELS), 1e-8);
+        auto q = torch::round((torch::clamp(frames, lo, hi) - offset) / scale).to(torch::kInt8);
+
+        values_ = q.to(torch::kCPU);
+        scale_ = scale.to(torch::kCPU);
+        offset_ = offset.to(torch::kCPU);
+        bytes_.set(values_.nbytes() + scale_.nbytes() + offset_.nbytes());
+    } else {
+        values_ = frames.to(torch::kCPU, torch::kFloat32, /*non_blocking=*/false, /*copy=*/true).contiguous();
+        bytes_.set(values_.nbytes());
+    }
+}
+
+torch::Tensor ParkedFrames::load(const size_t start, const size_t end, const torch::Device& device) const {
+    if (start > end || end > len()) {
+        throw std::out_of_range("parked frame range out of bounds");
+    }
+
+    auto values = values_.slice(0, start, end).to(device);
+    if (!is_quantized()) {
+        return values;
+    }
+    auto scale = scale_.slice(0, start, end).to(device);
+    auto offset = offset_.slice(0, start, end).to(device);
+    return values.to(torch::kFloat32) * scale + offset;
+}
+
+void ParkedFrames::clear() {
+    values_ = torch::Tensor();
+    scale_ = torch::Tensor();
+    offset_ = torch::Tensor();
+    bytes_.set(0);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <torch/torch.h>
+#include <cstddef>
+
+// Feature storage tiers: active frames live on the extractor device, ready for
+// the encoder; parked frames are host copies of idle sessions.
+enum class StorageTier {
+    Active,
+    Parked,
+};
+
+struct TierUsage {
+    size_t active_bytes;
+    size_t parked_bytes;
+};
+
+// Process-wide bytes held per tier.
+TierUsage tier_usage();
+
+// Bytes one owner holds in a tier, added to the process-wide totals for as
+// long as the owner lives.
+class TierBytes {
+    public:
+        explicit TierBytes(const StorageTier tier) : tier_(tier) {}
+
+        TierBytes(const TierBytes&) = delete;
+        TierBytes& operator=(const TierBytes&) = delete;
+
+        ~TierBytes() {
+            set(0);
+        }
+
+        void set(const size_t bytes);
+
+        size_t get() const {
+            return bytes_;
+        }
+
+    private:
+        StorageTier tier_;
+        size_t bytes_ = 0;
+};
+
+// Frames moved to host memory, either as float32 or quantized to int8 with a
+// scale and offset per frame. Quantization first clamps every frame to its
+// own max - 8, which Whisper's window normalization would clamp anyway, so
+// only the 8 decades that survive normalization are spread over the int8 range.
+class ParkedFrames {
+    public:
+        ParkedFrames();
+
+        size_t len() const {
+            return values_.defined() ? values_.size(0) : 0;
+        }
+
+        bool is_quantized() const {
+            return scale_.defined();
+        }
+
+        size_t bytes() const {
+            return bytes_.get();
+        }
+
+        // Replaces the parked frames with a host copy of [n, n_mels] frames.
+        void store(const torch::Tensor& frames, const bool quantize);
+
+        // float32 frames [start, end) on the given device.
+        torch::Tensor load(const size_t start, const size_t end, const torch::Device& device) const;
+
+        void clear();
+
+    private:
+        torch::Tensor values_;
+        torch::Tensor scale_;
+        torch::Tensor offset_;
+        TierBytes bytes_;
+};
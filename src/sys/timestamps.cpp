@@ -0,0 +1,274 @@
+#include "whisper-trtllm-rs/src/sys/timestamps.h"
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+
+#include "cnpy.h"
+
+#include <algorithm>
+
+namespace {
+    // rows of the rule tensor apply() copies to the device
+    constexpr int64_t N_FIELDS = 5;
+}
+
+BeamState BeamState::extend(const tle::TokenIdType token) const {
+    BeamState next = *this;
+    next.length = length + 1;
+    next.last_token = token;
+    next.penultimate_was_timestamp = last_was_timestamp;
+    next.last_was_timestamp = token::is_timestamp(token);
+    if (next.last_was_timestamp) {
+        next.last_timestamp = token;
+        next.last_timestamp_at = length;
+    }
+    return next;
+}
+
+DecodeState DecodeState::of(const tle::BeamTokens& tokens) {
+    DecodeState state;
+    state.advance(tokens);
+    return state;
+}
+
+void DecodeState::advance(const tle::BeamTokens& tokens) {
+    if (!located_) {
+        const auto& first = tokens[0];
+        for (size_t i = first.size(); i > 0; i--) {
+            if (first[i - 1] == token::TRANSCRIBE) {
+                sample_begin_ = i;
+                break;
+            }
+        }
+        located_ = true;
+    }
+
+    std::swap(previous_, beams_);
+    beams_.clear();
+    parents_.clear();
+
+    for (const auto& beam : tokens) {
+        const size_t n_tokens = beam.size();
+        uint32_t parent = RESCANNED;
+        bool ambiguous = false;
+        for (uint32_t p = 0; n_tokens > 1 && p < previous_.size(); p++) {
+            const auto& candidate = previous_[p];
+            if (candidate.length + 1 != n_tokens || candidate.last_token != beam[n_tokens - 2]) {
+                continue;
+            }
+            if (candidate.last_timestamp >= 0 && beam[candidate.last_timestamp_at] != candidate.last_timestamp) {
+                continue;
+            }
+            if (parent == RESCANNED) {
+                parent = p;
+            } else if (!candidate.same_rules(previous_[parent])) {
+                ambiguous = true;
+                break;
+            }
+        }
+
+        if (parent == RESCANNED || ambiguous) {
+            beams_.push_back(scan(beam));
+            parents_.push_back(RESCANNED);
+        } else {
+            beams_.push_back(previous_[parent].extend(beam[n_tokens - 1]));
+            parents_.push_back(parent);
+        }
+    }
+}
+
+BeamState DecodeState::scan(const tle::VecTokens& tokens) const {
+    const size_t n_tokens = tokens.size();
+
+    BeamState state;
+    state.length = n_tokens;
+    state.last_token = n_tokens > 0 ? tokens[n_tokens - 1] : -1;
+    state.last_was_timestamp = n_tokens > 0 && token::is_timestamp(tokens[n_tokens - 1]);
+    state.penultimate_was_timestamp = n_tokens > 1 && token::is_timestamp(tokens[n_tokens - 2]);
+    for (size_t i = n_tokens; i > sample_begin_; i--) {
+        if (token::is_timestamp(tokens[i - 1])) {
+            state.last_timestamp = tokens[i - 1];
+            state.last_timestamp_at = i - 1;
+            break;
+        }
+    }
+    return state;
+}
+
+TimestampRules::TimestampRules(
+    const DecodeState& state,
+    const bool stop_on_timestamps
+) : check_timestamp_prob_(false) {
+    const BeamRule unconstrained = BeamRule::unconstrained();
+    const auto& beams = state.beams();
+    beams_.reserve(beams.size());
+
+    const bool is_first_text = state.is_first_text();
+
+    for (const auto& beam : beams) {
+        BeamRule rule = unconstrained;
+        if (beam.last_was_timestamp) {
+            if (is_first_text || beam.penultimate_was_timestamp) {
+                rule.timestamp_end = BeamRule::VOCAB_END;
+            } else if (stop_on_timestamps) {
+                // the segment is closed; as before, this ends the step, so
+                // the beams after this one only lose <|notimestamps|>
+                rule.forced_token = token::END_OF_TEXT;
+                beams_.push_back(rule);
+                beams_.resize(beams.size(), unconstrained);
+                check_timestamp_prob_ = false;
+                return;
+            } else {
+                rule.text_end = token::END_OF_TEXT;
+                rule.timestamp_end = beam.last_token;
+                check_timestamp_prob_ = true;
+            }
+        } else {
+            if (beam.last_timestamp >= 0) {
+                rule.timestamp_end = beam.last_timestamp + 1;
+            }
+            check_timestamp_prob_ = true;
+        }
+        beams_.push_back(rule);
+    }
+
+    // the check covers the whole step, as before
+    for (auto& rule : beams_) {
+        rule.check_timestamp_prob = check_timestamp_prob_;
+    }
+}
+
+void apply_beam_rules(
+    torch::Tensor logits,
+    const std::vector<BeamRule>& rules,
+    const LogitBiases& biases
+) {
+    const int64_t n_rows = static_cast<int64_t>(rules.size());
+    const auto device = logits.device();
+    const auto options = torch::TensorOptions().dtype(torch::kLong);
+
+    // pinned, so the copy is queued on the stream instead of waiting
+    auto host = torch::empty({N_FIELDS, n_rows}, options.pinned_memory(device.is_cuda()));
+    auto fields = host.data_ptr<int64_t>();
+    bool forced = false;
+    bool check = false;
+    for (int64_t r = 0; r < n_rows; r++) {
+        const auto& rule = rules[r];
+        fields[r] = rule.text_end;
+        fields[n_rows + r] = rule.timestamp_begin;
+        fields[2 * n_rows + r] = rule.timestamp_end;
+        fields[3 * n_rows + r] = rule.forced_token;
+        fields[4 * n_rows + r] = rule.check_timestamp_prob ? 1 : 0;
+        forced = forced || rule.forced_token >= 0;
+        check = check || rule.check_timestamp_prob;
+    }
+    auto table = host.to(device, torch::kLong, /*non_blocking=*/true).unsqueeze(-1);
+    const auto& ids = biases.ids;
+
+    // [n_rows, vocab]
+    auto suppressed = ids.lt(table[0])
+        .logical_or_(ids.ge(table[1]).logical_and_(ids.lt(table[2])))
+        .logical_or_(ids.eq(token::NO_TIMESTAMPS));
+    if (forced) {
+        suppressed.logical_or_(table[3].ge(0).logical_and(ids.ne(table[3])));
+    }
+    logits.masked_fill_(suppressed, NEG_INF);
+    if (forced) {
+        logits.masked_fill_(ids.eq(table[3]), 0);
+    }
+
+    if (!check) {
+        return;
+    }
+
+    // log_softmax shifts both sides by the same normalizer, so the raw
+    // logits decide the same way
+    auto scores = logits.to(torch::kFloat32);
+    auto timestamp_logprob = scores.slice(-1, token::START_OF_TIMESTAMP).logsumexp(-1);
+    auto max_text_logprob = scores.slice(-1, 0, token::START_OF_TIMESTAMP).amax(-1);
+    auto timestamp_only = timestamp_logprob.gt(max_text_logprob).unsqueeze(-1)
+        .logical_and_(table[4].ne(0));
+    logits.slice(-1, 0, token::START_OF_TIMESTAMP).masked_fill_(timestamp_only, NEG_INF);
+}
+
+void apply_batched_rules(
+    const std::vector<torch::Tensor>& logits,
+    const std::vector<BeamRule>& rules,
+    const LogitBiases& biases
+) {
+    if (logits.empty()) {
+        return;
+    }
+    const auto& first = logits[0];
+    const int64_t vocab = first.size(-1);
+
+    // back to back in one buffer: one view over all of them
+    bool adjacent = true;
+    auto next = static_cast<char*>(first.data_ptr());
+    for (const auto& tensor : logits) {
+        adjacent = adjacent && tensor.is_contiguous()
+            && tensor.scalar_type() == first.scalar_type()
+            && tensor.device() == first.device()
+            && tensor.size(-1) == vocab
+            && static_cast<char*>(tensor.data_ptr()) == next;
+        next = static_cast<char*>(tensor.data_ptr()) + tensor.nbytes();
+    }
+    if (adjacent) {
+        const int64_t n_rows = static_cast<int64_t>(rules.size());
+        apply_beam_rules(torch::from_blob(first.data_ptr(), {n_rows, vocab}, first.options()), rules, biases);
+        return;
+    }
+
+    std::vector<torch::Tensor> rows;
+    rows.reserve(logits.size());
+    for (const auto& tensor : logits) {
+        rows.push_back(tensor.reshape({-1, vocab}));
+    }
+    auto packed = torch::cat(rows, 0);
+    apply_beam_rules(packed, rules, biases);
+
+    int64_t offset = 0;
+    for (const auto& tensor : logits) {
+        const int64_t n = tensor.numel() / vocab;
+        tensor.view({-1, vocab}).copy_(packed.slice(0, offset, offset + n));
+        offset += n;
+    }
+}
+
+LogitsRecorder::LogitsRecorder(
+    std::filesystem::path path,
+    const size_t max_steps
+) : path_(std::move(path)), max_steps_(max_steps) {
+}
+
+void LogitsRecorder::record(
+    const torch::Tensor& logits,
+    const tle::BeamTokens& tokens,
+    const bool stop_on_timestamps
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (n_steps_ >= max_steps_) {
+        return;
+    }
+
+    const size_t n_beams = tokens.size();
+    auto host = logits.reshape({static_cast<int64_t>(n_beams), -1})
+        .to(torch::kCPU, torch::kFloat32)
+        .contiguous();
+
+    size_t n_tokens = 0;
+    for (const auto& beam : tokens) {
+        n_tokens = std::max(n_tokens, beam.size());
+    }
+    std::vector<int32_t> ids(n_beams * n_tokens, -1);
+    for (size_t b = 0; b < n_beams; b++) {
+        std::copy(tokens[b].begin(), tokens[b].end(), ids.begin() + b * n_tokens);
+    }
+    const uint8_t stop = stop_on_timestamps ? 1 : 0;
+
+    const auto file = path_.string();
+    const auto step = std::to_string(n_steps_);
+    cnpy::npz_save(file, "logits_" + step, host.data_ptr<float>(),
+        {n_beams, static_cast<size_t>(host.size(1))}, n_steps_ == 0 ? "w" : "a");
+    cnpy::npz_save(file, "tokens_" + step, ids.data(), {n_beams, n_tokens}, "a");
+    cnpy::npz_save(file, "stop_" + step, &stop, {1}, "a");
+    n_steps_++;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/logits.h"
+#include "whisper-trtllm-rs/src/sys/vocab.h"
+
+#include "tensorrt_llm/executor/executor.h"
+
+#include <torch/torch.h>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace tle = tensorrt_llm::executor;
+
+// What the rules do to one beam at one decode step: suppress the text tokens
+// [0, text_end) and the tokens [timestamp_begin, timestamp_end), or, when
+// forced_token is set, everything but that token, whose logit becomes 0.
+// With check_timestamp_prob the text is suppressed as well when the
+// timestamps together outweigh the best text token.
+struct BeamRule {
+    static constexpr int64_t VOCAB_END = std::numeric_limits<int64_t>::max();
+
+    int64_t text_end;
+    int64_t timestamp_begin;
+    int64_t timestamp_end;
+    int64_t forced_token;
+    bool check_timestamp_prob;
+
+    // only <|notimestamps|> suppressed
+    static BeamRule unconstrained() {
+        return BeamRule{0, token::START_OF_TIMESTAMP, token::START_OF_TIMESTAMP, -1, false};
+    }
+
+    static BeamRule languages_only() {
+        return BeamRule{token::START_OF_LANGUAGE, token::END_OF_LANGUAGE, VOCAB_END, -1, false};
+    }
+
+    static BeamRule forced(const tle::TokenIdType token) {
+        BeamRule rule = unconstrained();
+        rule.forced_token = token;
+        return rule;
+    }
+};
+
+// Applies one rule per row of logits [..., n_rows, vocab] in place, in the
+// same few tensor ops however many rows there are: the rules go to the
+// device as one small table, built in pinned memory so the copy is queued
+// on the stream, and the probability check is decided there, so nothing
+// waits for the device.
+void apply_beam_rules(
+    torch::Tensor logits,
+    const std::vector<BeamRule>& rules,
+    const LogitBiases& biases
+);
+
+// apply_beam_rules() over the logits of several requests, [1, n_beams,
+// vocab] each, with the rules of their beams in order. Logits laid out back
+// to back in one buffer, as the executor hands them over, are processed
+// through a single view; otherwise they are gathered and scattered back.
+void apply_batched_rules(
+    const std::vector<torch::Tensor>& logits,
+    const std::vector<BeamRule>& rules,
+    const LogitBiases& biases
+);
+
+// Where one beam stands in the timestamp rules after a decode step.
+struct BeamState {
+    size_t length = 0;
+    tle::TokenIdType last_token = -1;
+    // the most recent sampled timestamp and its position, -1 if none
+    tle::TokenIdType last_timestamp = -1;
+    size_t last_timestamp_at = 0;
+    bool last_was_timestamp = false;
+    bool penultimate_was_timestamp = false;
+
+    // the state after one more token
+    BeamState extend(const tle::TokenIdType token) const;
+
+    bool same_rules(const BeamState& other) const {
+        return last_timestamp == other.last_timestamp
+            && last_timestamp_at == other.last_timestamp_at
+            && last_was_timestamp == other.last_was_timestamp;
+    }
+};
+
+// Decode state of one request, carried across steps so a step costs
+// O(beam width) instead of a scan of every beam's tokens.
+//
+// Each beam of a step extends some beam of the previous step by one token;
+// beam search may reorder them, so advance() finds the parent of each beam
+// among the previous ones by length, last token and last timestamp. The
+// true parent always matches; when several do and disagree on the state,
+// and on the first step, the beam is scanned back to the task token instead.
+class DecodeState {
+    public:
+        static constexpr uint32_t RESCANNED = std::numeric_limits<uint32_t>::max();
+
+        // sample_begin is a first guess at where sampling starts; the
+        // position after the <|transcribe|> token of the first step wins
+        explicit DecodeState(
+            const size_t sample_begin = 0
+        ) : sample_begin_(sample_begin) {}
+
+        // the state of these beam tokens scanned from scratch
+        static DecodeState of(
+            const tle::BeamTokens& tokens
+        );
+
+        void advance(
+            const tle::BeamTokens& tokens
+        );
+
+        size_t sample_begin() const {
+            return sample_begin_;
+        }
+
+        // exactly one token sampled after the task token, in the first beam
+        bool is_first_text() const {
+            return !beams_.empty() && beams_[0].length == sample_begin_ + 1;
+        }
+
+        const std::vector<BeamState>& beams() const {
+            return beams_;
+        }
+
+        // the previous beam each beam continues, or RESCANNED
+        const std::vector<uint32_t>& parents() const {
+            return parents_;
+        }
+
+    private:
+        BeamState scan(
+            const tle::VecTokens& tokens
+        ) const;
+
+        size_t sample_begin_;
+        bool located_ = false;
+        std::vector<BeamState> beams_;
+        std::vector<BeamState> previous_;
+        std::vector<uint32_t> parents_;
+};
+
+// Whisper's timestamp rules for a decode step past the task token:
+// timestamps come in pairs, never decrease, and a timestamp is forced when
+// the timestamp tokens together outweigh the best text token.
+//
+// The constructor reduces every beam of the request's decode state, which
+// lives on the host, to a BeamRule; apply() runs them through
+// apply_beam_rules(), so unlike the per-beam Logits calls it replaces nothing
+// waits for the device.
+class TimestampRules {
+    public:
+        TimestampRules(
+            const DecodeState& state,
+            const bool stop_on_timestamps
+        );
+
+        TimestampRules(
+            const tle::BeamTokens& tokens,
+            const bool stop_on_timestamps
+        ) : TimestampRules(DecodeState::of(tokens), stop_on_timestamps) {}
+
+        const std::vector<BeamRule>& beams() const {
+            return beams_;
+        }
+
+        bool checks_timestamp_prob() const {
+            return check_timestamp_prob_;
+        }
+
+        // logits [..., n_beams, vocab], modified in place; the biases are
+        // those of the logits' kind
+        void apply(
+            torch::Tensor logits,
+            const LogitBiases& biases
+        ) const {
+            apply_beam_rules(logits, beams_, biases);
+        }
+
+    private:
+        std::vector<BeamRule> beams_;
+        bool check_timestamp_prob_;
+};
+
+// Appends the logits and tokens of every timestamp-rule step to an npz file
+// as logits_<i> (float32 [n_beams, vocab]), tokens_<i> (int32 [n_beams, n],
+// padded with -1) and stop_<i>, which bench_timestamp_rules() replays.
+// Copying the logits to the host syncs, so this is for capturing test data
+// only; whisper() creates one when Config::record_logits names a file.
+class LogitsRecorder {
+    public:
+        explicit LogitsRecorder(
+            std::filesystem::path path,
+            const size_t max_steps = 512
+        );
+
+        void record(
+            const torch::Tensor& logits,
+            const tle::BeamTokens& tokens,
+            const bool stop_on_timestamps
+        );
+
+    private:
+        std::mutex mutex_;
+        std::filesystem::path path_;
+        size_t max_steps_;
+        size_t n_steps_ = 0;
+};
@@ -0,0 +1,66 @@
+// The timestamp rules against a fresh scan, the per-beam reference and the
+// per-request processors, through the self-checks in
+// src/sys/testing/timestamps.cpp.
+
+use super::testing::ffi::{bench_batched_rules, bench_timestamp_rules, decode_state_mismatches};
+
+#[test]
+fn test_incremental_state_matches_scan() {
+    for beam_width in [1, 2, 5] {
+        assert_eq!(decode_state_mismatches(2000, beam_width), 0, "beam width {beam_width}");
+    }
+}
+
+#[test]
+fn test_fused_rules_match_reference() {
+    let bench = bench_timestamp_rules("", "cpu", 1).unwrap();
+    assert!(bench.steps > 0);
+    assert_eq!(bench.mismatches, 0, "{bench:?}");
+}
+
+/// Steps recorded through Config::record_logits when WHISPER_LOGITS
+/// points at the npz file, synthetic ones otherwise.
+#[test]
+#[ignore]
+fn bench_timestamp_rules_per_step() {
+    let path = std::env::var("WHISPER_LOGITS").unwrap_or_default();
+    for device in ["cuda", "cpu"] {
+        let bench = bench_timestamp_rules(&path, device, 20).unwrap();
+        println!(
+            "{device}: {} steps, {} beams, {} mismatching, reference {:.1} us, fused {:.1} us per step",
+            bench.steps, bench.beams, bench.mismatches, bench.reference_micros, bench.fused_micros,
+        );
+        assert_eq!(bench.mismatches, 0);
+    }
+}
+
+#[test]
+fn test_batched_rules_match_per_request() {
+    for bench in bench_batched_rules("cpu", &[1, 3, 8], 1, false).unwrap() {
+        assert_eq!(bench.mismatches, 0, "{bench:?}");
+    }
+}
+
+#[test]
+fn test_scattered_batched_rules_match_per_request() {
+    for bench in bench_batched_rules("cpu", &[2, 3, 8], 1, true).unwrap() {
+        assert_eq!(bench.mismatches, 0, "{bench:?}");
+    }
+}
+
+/// Wall time of one step's rules, launches included and device work waited
+/// for once per run, for 1 to 128 single-beam requests in flight: one locked
+/// call per request against one batched pass. Not the executor's whole step.
+#[test]
+#[ignore]
+fn bench_batched_rules_per_step() {
+    for device in ["cuda", "cpu"] {
+        for bench in bench_batched_rules(device, &[1, 8, 32, 64, 128], 50, false).unwrap() {
+            println!(
+                "{device} batch {}: per request {:.1} us, batched {:.1} us per step",
+                bench.batch_size, bench.per_request_micros, bench.batched_micros,
+            );
+            assert_eq!(bench.mismatches, 0);
+        }
+    }
+}
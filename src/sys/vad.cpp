@@ -0,0 +1,138 @@
+#include "whisper-trtllm-rs/src/sys/vad.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // flatness and flux look at the top 4 decades of each frame, so bins at
+    // the log floor do not drown out the shape of the spectrum
+    constexpr double DYNAMIC_RANGE = 4.0;
+
+    constexpr double SPEECH_LO_HZ = 250.0;
+    constexpr double SPEECH_HI_HZ = 4000.0;
+}
+
+VoiceActivity::VoiceActivity(
+    const size_t n_mels,
+    const size_t sample_rate,
+    const VadOptions& options
+) : options_(options),
+    band_lo_(static_cast<int64_t>(mel_bin(SPEECH_LO_HZ, n_mels, sample_rate))),
+    band_hi_(static_cast<int64_t>(mel_bin(SPEECH_HI_HZ, n_mels, sample_rate))) {
+}
+
+torch::Tensor VoiceActivity::statistics(const torch::Tensor& frames) {
+    const int64_t n = frames.size(0);
+    if (n == 0) {
+        return torch::empty({0, static_cast<int64_t>(N_STATISTICS)}, frames.options());
+    }
+
+    auto power = torch::pow(10.0, frames);
+    auto energy = power.sum(1).log10();
+
+    auto clamped = torch::maximum(frames, frames.amax(1, true) - DYNAMIC_RANGE);
+    // log of the geometric over the arithmetic mean of the power
+    auto flatness = clamped.mean(1) - torch::pow(10.0, clamped).mean(1).log10();
+
+    // the first frame of a stream has no predecessor and gets zero flux
+    auto previous = previous_.defined() ? previous_ : clamped.slice(0, 0, 1);
+    auto shifted = torch::cat({previous, clamped.slice(0, 0, n - 1)}, 0);
+    auto flux = (clamped - shifted).abs().mean(1);
+    previous_ = clamped.slice(0, n - 1, n).clone();
+
+    auto band = power.slice(1, band_lo_, band_hi_ + 1).sum(1).log10() - energy;
+
+    return torch::stack({energy, flatness, flux, band}, 1);
+}
+
+void VoiceActivity::push(const FrameStatistics& stats) {
+    floor_ = has_floor_ ? std::min(stats.energy, floor_ + options_.floor_rise) : stats.energy;
+    has_floor_ = true;
+    flux_ += (stats.flux - flux_) * options_.flux_alpha;
+
+    const bool active = stats.energy > std::max(floor_ + options_.floor_margin, options_.min_energy)
+        && stats.flatness > options_.min_flatness
+        && stats.flatness < options_.max_flatness
+        && flux_ > options_.min_flux
+        && stats.band > options_.min_band;
+
+    if (!active) {
+        run_ = 0;
+        active_.push_back(0);
+        return;
+    }
+
+    // a run counts once it reaches min_run frames, then marks its start too
+    run_++;
+    active_.push_back(run_ >= options_.min_run ? 1 : 0);
+    if (run_ == options_.min_run) {
+        const size_t n = std::min(run_, active_.size());
+        std::fill(active_.end() - n, active_.end(), 1);
+    }
+}
+
+void VoiceActivity::consume(size_t n) {
+    n = std::min(n, active_.size());
+    for (size_t i = n; i > 0; i--) {
+        if (active_[i - 1]) {
+            speech_end_ = front_ + i;
+            break;
+        }
+    }
+    active_.erase(active_.begin(), active_.begin() + n);
+    front_ += n;
+}
+
+std::vector<std::pair<size_t, size_t>> VoiceActivity::spans() const {
+    // absolute frame indices, padded and merged
+    std::vector<std::pair<size_t, size_t>> spans;
+    auto add = [&](const size_t begin, const size_t end) {
+        const size_t padded = begin > options_.pad ? begin - options_.pad : 0;
+        if (!spans.empty() && padded <= spans.back().second + options_.max_gap) {
+            spans.back().second = std::max(spans.back().second, end + options_.pad);
+        } else {
+            spans.emplace_back(padded, end + options_.pad);
+        }
+    };
+
+    // speech consumed just before the front still pads into the queue
+    if (speech_end_ > 0) {
+        add(speech_end_, speech_end_);
+    }
+    for (size_t i = 0; i < active_.size();) {
+        if (!active_[i]) {
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < active_.size() && active_[j]) {
+            j++;
+        }
+        add(front_ + i, front_ + j);
+        i = j;
+    }
+
+    // relative to the front, clipped to the queued frames
+    std::vector<std::pair<size_t, size_t>> out;
+    const size_t back = front_ + active_.size();
+    for (auto [begin, end] : spans) {
+        begin = std::max(begin, front_);
+        end = std::min(end, back);
+        if (begin < end) {
+            out.emplace_back(begin - front_, end - front_);
+        }
+    }
+    return out;
+}
+
+size_t VoiceActivity::leading_non_speech(const bool finished) const {
+    auto speech = spans();
+    if (!speech.empty()) {
+        return speech.front().first;
+    }
+    if (finished) {
+        return active_.size();
+    }
+    // the pending run and frames still to come pad back over this tail
+    return active_.size() - std::min(active_.size(), options_.pad + run_);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "whisper-trtllm-rs/src/sys/filterbank.h"
+
+#include <torch/torch.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+// Thresholds of VoiceActivity, tuned on raw log10 mel frames of 16 kHz audio.
+struct VadOptions {
+    // the energy floor tracks quiet stretches and rises this much per frame
+    float floor_rise = 0.002f;
+    // speech is at least this far above the floor (log10 units) ...
+    float floor_margin = 0.5f;
+    // ... and above this absolute energy, well over digital silence
+    float min_energy = -5.0f;
+    // spectral flatness range: white noise sits near 0, pure tones far below
+    float min_flatness = -2.05f;
+    float max_flatness = -0.9f;
+    // smoothing factor and threshold of the spectral flux average; speech
+    // changes its spectrum every few frames, hum and held notes do not
+    float flux_alpha = 1.0f / 16.0f;
+    float min_flux = 0.15f;
+    // share of the energy between 250 Hz and 4 kHz, log10
+    float min_band = -0.5f;
+    // span shaping in frames: runs shorter than min_run are dropped, the rest
+    // are padded on both sides and merged across gaps up to max_gap
+    size_t min_run = 5;
+    size_t pad = 20;
+    size_t max_gap = 30;
+};
+
+// Per-frame measures VoiceActivity::statistics() derives on the frames' device.
+struct FrameStatistics {
+    float energy;
+    float flatness;
+    float flux;
+    float band;
+};
+
+// Frame-level voice activity over a queue of raw log10 mel frames, mirroring
+// the buffered frames of a FeatureBuffer. The statistics are computed with a
+// few tensor ops next to the ones the buffer already runs on new frames, the
+// decisions on the host: a frame is speech when it is loud against the
+// running floor, neither tonal nor noise-like, changing, and carries most of
+// its energy in the speech band.
+class VoiceActivity {
+    public:
+        static const size_t N_STATISTICS = 4;
+
+        explicit VoiceActivity(
+            const size_t n_mels,
+            const size_t sample_rate = SAMPLE_RATE,
+            const VadOptions& options = VadOptions()
+        );
+
+        size_t len() const {
+            return active_.size();
+        }
+
+        // [n, N_STATISTICS] statistics of the next frames [n, n_mels], in
+        // FrameStatistics order, on the frames' device. Flux is taken against
+        // the last frame of the previous call.
+        torch::Tensor statistics(const torch::Tensor& frames);
+
+        // Classifies the next frame.
+        void push(const FrameStatistics& stats);
+
+        // Drops up to n frames from the front.
+        void consume(size_t n);
+
+        // Speech spans [begin, end) over the queued frames. Unless finished,
+        // the last span may still grow.
+        std::vector<std::pair<size_t, size_t>> spans() const;
+
+        // Frames at the front that no span can reach any more: everything
+        // before the first span, or when there is none, everything except a
+        // tail that later frames could still pad into speech.
+        size_t leading_non_speech(const bool finished) const;
+
+    private:
+        VadOptions options_;
+        // bins of the speech band, inclusive
+        int64_t band_lo_;
+        int64_t band_hi_;
+        // last clamped frame of the previous statistics() call
+        torch::Tensor previous_;
+
+        bool has_floor_ = false;
+        float floor_ = 0.0f;
+        float flux_ = 0.0f;
+        // length of the active run at the back, confirmed from min_run on
+        size_t run_ = 0;
+
+        // absolute index of active_[0] and one past the last speech frame
+        // consumed, 0 if none
+        size_t front_ = 0;
+        size_t speech_end_ = 0;
+        std::deque<uint8_t> active_;
+};
@@ -25,11 +25,11 @@ namespace token {
     const TokenIdType START_OF_TIMESTAMP = 50365;
     const TokenIdType END_OF_TIMESTAMP = 51866;
 
-    bool is_timestamp(TokenIdType token) {
+    inline bool is_timestamp(TokenIdType token) {
         return token >= START_OF_TIMESTAMP && token < END_OF_TIMESTAMP;
     }
 
-    bool is_clause_end(const std::vector<TokenIdType>& tokens) {
+    inline bool is_clause_end(const std::vector<TokenIdType>& tokens) {
         const size_t n = tokens.size();
         return n > 0 && (tokens[n - 1] == 11 || tokens[n - 1] == 13 || tokens[n - 1] == 0 || tokens[n - 1] == 30 || tokens[n - 1] == 1543) || // ,.!?。
             n > 2 && tokens[n - 3] == 171 && tokens[n - 2] == 120 && (tokens[n - 1] == 234 || tokens[n - 1] == 223 || tokens[n - 1] == 253); // ，！？
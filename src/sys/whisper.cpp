@@ -1,6 +1,7 @@
 #include "whisper-trtllm-rs/src/sys/whisper.rs.h"
 #include "whisper-trtllm-rs/src/sys/vocab.h"
 #include "whisper-trtllm-rs/src/sys/logits.h"
+#include "whisper-trtllm-rs/src/sys/timestamps.h"
 
 #include "tensorrt_llm/executor/executor.h"
 #include "tensorrt_llm/executor/tensor.h"
@@ -8,8 +9,10 @@
 #include <ATen/cuda/CUDAContext.h>
 #include <c10/cuda/CUDAGuard.h>
 
+#include <chrono>
 #include <span>
 #include <mutex>
+#include <stdexcept>
 
 #include "rust/cxx.h"
 
@@ -17,8 +20,8 @@ namespace tlr = tensorrt_llm::runtime;
 namespace tle = tensorrt_llm::executor;
 
 tle::ExecutorConfig executor_config(
-    const Config config,
-    TranscribeLogitsProcessor& transcribe_logits_processor
+    const Config& config,
+    tle::LogitsPostProcessorBatched process_batch
 ) {
     tle::ExecutorConfig executor_config = tle::ExecutorConfig(config.max_beam_width);
     executor_config.setBatchingType(tle::BatchingType::kINFLIGHT);
@@ -28,45 +31,8 @@ tle::ExecutorConfig executor_config(
     kv_cache_config.setCrossKvCacheFraction(0.5);
     executor_config.setKvCacheConfig(kv_cache_config);
 
-    auto process_transcribe_logits = [&transcribe_logits_processor](
-        tle::IdType req_id, 
-        tle::Tensor& logits, 
-        tle::BeamTokens const& tokens,
-        tle::StreamPtr const& stream_ptr, 
-        std::optional<tle::IdType> client_id)
-    {
-        transcribe_logits_processor.process(req_id, logits, tokens, stream_ptr, false);
-    };
-
-    auto process_transcribe_segment_logits = [&transcribe_logits_processor](
-        tle::IdType req_id, 
-        tle::Tensor& logits, 
-        tle::BeamTokens const& tokens,
-        tle::StreamPtr const& stream_ptr, 
-        std::optional<tle::IdType> client_id)
-    {
-        transcribe_logits_processor.process(req_id, logits, tokens, stream_ptr, true);
-    };
-
-    auto process_detect_logits = [](
-        tle::IdType req_id, 
-        tle::Tensor& logits,
-        tle::BeamTokens const& tokens,
-        tle::StreamPtr const& stream_ptr, 
-        std::optional<tle::IdType> client_id)
-    {
-        at::cuda::CUDAStreamGuard guard(tlr::TorchUtils::stream(*stream_ptr));
-        Logits lgts(logits);
-        lgts.suppress_non_languages();
-    };
-
     tle::LogitsPostProcessorConfig logits_proc_config;
-    auto logits_proc_map = std::unordered_map<std::string, tensorrt_llm::executor::LogitsPostProcessor>{
-        {"transcribe", process_transcribe_logits},
-        {"transcribe_segment", process_transcribe_segment_logits},
-        {"detect", process_detect_logits}
-    };
-    logits_proc_config.setProcessorMap(logits_proc_map);
+    logits_proc_config.setProcessorBatched(process_batch);
     executor_config.setLogitsPostProcessorConfig(logits_proc_config);
 
     //auto decodingMode = DecodingMode::Auto();
@@ -81,20 +47,24 @@ tle::ExecutorConfig executor_config(
 }
 
 Whisper::Whisper(
-    const std::filesystem::path& model_path, 
-    const Config& config
-) : // mTranscribeLogitsProcessor(),
-    executor_(
-        model_path / "encoder",
-        model_path / "decoder",
-        tle::ModelType::kENCODER_DECODER,
-        executor_config(config, transcribe_logits_processor_)
-) {
+    const BackendFactory& backend,
+    std::unique_ptr<LogitsRecorder> recorder
+) : transcribe_logits_processor_(std::move(recorder)),
+    backend_(backend([this](
+        std::vector<tle::IdType> const& req_ids,
+        std::vector<tle::Tensor>& logits,
+        std::vector<std::reference_wrapper<tle::BeamTokens const>> const& tokens,
+        tle::StreamPtr const& stream_ptr,
+        std::vector<std::optional<tle::IdType>> const& client_ids)
+    {
+        transcribe_logits_processor_.process_batch(req_ids, logits, tokens, stream_ptr, client_ids);
+    }))
+{
 }
 
 tle::IdType Whisper::enqueue_detect_language_request(
     const torch::Tensor& features
-) {
+) const {
     auto mel = features.contiguous();
     auto encoder_output_length = mel.size(0) / 2;
 
@@ -104,17 +74,9 @@ tle::IdType Whisper::enqueue_detect_language_request(
     request.setEncoderOutputLength(encoder_output_length);
     request.setEndId(token::END_OF_TEXT);
     request.setPadId(token::END_OF_TEXT);
-    request.setLogitsPostProcessorName("detect");
+    request.setLogitsPostProcessorName(tle::Request::kBatchedPostProcessorName);
 
-    return executor_.enqueueRequest(request);
-}
-
-uint32_t Whisper::await_detect_language_response(
-    tle::IdType const &request_id
-) {
-    auto response = executor_.awaitResponses(request_id)[0];
-    auto result = response.getResult();
-    return result.outputTokenIds[0].back();
+    return enqueue(request, transcribe_logits_processor_.register_request(1, DecodeMode::DETECT));
 }
 
 tle::IdType Whisper::enqueue_transcribe_request(
@@ -122,7 +84,9 @@ tle::IdType Whisper::enqueue_transcribe_request(
     const tle::VecTokens prompt,
     const TranscribeOptions &options,
     const bool stop_on_timestamps
-) {
+) const {
+    // no copy for encoder input slabs, which are contiguous already; the
+    // request's view keeps the slab out of its pool until it is released
     auto mel = features.contiguous();
 
     int encoder_output_length = mel.size(0) / 2;
@@ -134,11 +98,7 @@ tle::IdType Whisper::enqueue_transcribe_request(
     request.setEndId(token::END_OF_TEXT);
     request.setPadId(token::END_OF_TEXT);
 
-    if (stop_on_timestamps) {
-        request.setLogitsPostProcessorName("transcribe_segment");
-    } else {
-        request.setLogitsPostProcessorName("transcribe");
-    }
+    request.setLogitsPostProcessorName(tle::Request::kBatchedPostProcessorName);
 
     //auto sampling_config = tle::SamplingConfig(options.beam_width, options.top_k);
     //if (options.top_p > 0) {
@@ -157,73 +117,170 @@ tle::IdType Whisper::enqueue_transcribe_request(
     output_config.returnLogProbs = true;
     request.setOutputConfig(output_config);
 
-    auto request_id = executor_.enqueueRequest(request);
-    // transcribe_logits_processor_.register_request(request_id, prompt.size());
+    const auto mode = stop_on_timestamps ? DecodeMode::TRANSCRIBE_SEGMENT : DecodeMode::TRANSCRIBE;
+    return enqueue(request, transcribe_logits_processor_.register_request(prompt.size(), mode));
+}
 
-    return request_id;
+tle::IdType Whisper::enqueue(
+    tle::Request& request,
+    const tle::IdType key
+) const {
+    // registered first, so the executor never steps the request without it
+    request.setClientId(key);
+    try {
+        return backend_->enqueue(request);
+    } catch (...) {
+        transcribe_logits_processor_.unregister_request(key);
+        throw;
+    }
 }
 
-TranscribeResult Whisper::await_transcribe_response(
-    tle::IdType const &request_id        
-) {
-    auto response = executor_.awaitResponses(request_id)[0];
-    auto result = response.getResult();
+rust::Vec<ExecutorResponse> Whisper::await_responses(
+    const uint64_t timeout_millis
+) const {
+    auto responses = backend_->await_responses(std::chrono::milliseconds(timeout_millis));
 
-    if (result.isFinal) {
-        transcribe_logits_processor_.unregister_request(request_id);
-    }
+    rust::Vec<ExecutorResponse> ready;
+    ready.reserve(responses.size());
+    for (const auto& response : responses) {
+        const auto request_id = response.getRequestId();
+        const auto client_id = response.getClientId();
 
-    rust::Vec<uint32_t> tokens;
-    tokens.reserve(result.outputTokenIds[0].size());
-    for (const auto& token : result.outputTokenIds[0]) {
-        tokens.push_back(static_cast<uint32_t>(token));
-    }
+        if (response.hasError()) {
+            if (client_id) {
+                transcribe_logits_processor_.unregister_request(*client_id);
+            }
+            ready.push_back(ExecutorResponse {
+                .request_id = request_id,
+                .error = rust::String(response.getErrorMsg()),
+                .result = TranscribeResult {}
+            });
+            continue;
+        }
 
-    auto avg_logprob = result.cumLogProbs.value()[0] / static_cast<float>(result.logProbs.value()[0].size() + 1);
+        const auto& result = response.getResult();
+        if (result.isFinal && client_id) {
+            transcribe_logits_processor_.unregister_request(*client_id);
+        }
 
-    return TranscribeResult {
-        .is_final = result.isFinal,
-        .is_sequence_final = result.isSequenceFinal,
-        .tokens = tokens,
-        .avg_logprob = avg_logprob
-    };
+        rust::Vec<uint32_t> tokens;
+        tokens.reserve(result.outputTokenIds[0].size());
+        for (const auto& token : result.outputTokenIds[0]) {
+            tokens.push_back(static_cast<uint32_t>(token));
+        }
+
+        // language detection doesn't ask for log probs
+        float avg_logprob = 0;
+        if (result.cumLogProbs && result.logProbs) {
+            avg_logprob = result.cumLogProbs.value()[0] / static_cast<float>(result.logProbs.value()[0].size() + 1);
+        }
+
+        ready.push_back(ExecutorResponse {
+            .request_id = request_id,
+            .error = rust::String(),
+            .result = TranscribeResult {
+                .is_final = result.isFinal,
+                .is_sequence_final = result.isSequenceFinal,
+                .tokens = tokens,
+                .avg_logprob = avg_logprob
+            }
+        });
+    }
+    return ready;
 }
 
-bool Whisper::is_response_ready(
-    tle::IdType const &request_id
+void Whisper::cancel_request(
+    const tle::IdType request_id
 ) const {
-    return executor_.getNumResponsesReady(request_id) > 0;
+    backend_->cancel(request_id);
+}
+
+TranscribeLogitsProcessor::TranscribeLogitsProcessor(
+    std::unique_ptr<LogitsRecorder> recorder
+) : recorder_(std::move(recorder)) {
 }
 
-void TranscribeLogitsProcessor::register_request(
-    const tle::IdType req_id, 
-    const std::size_t sample_begin
+tle::IdType TranscribeLogitsProcessor::register_request(
+    const std::size_t sample_begin,
+    const DecodeMode mode
 ) {
-    std::lock_guard<std::mutex> lock(mutex_); 
-    context_map_.emplace(req_id, TranscribeContext{sample_begin});
+    // the state is reset on the request's first step
+    const auto key = next_key_.fetch_add(1, std::memory_order_relaxed);
+    auto* slot = contexts_.insert(key);
+    if (!slot) {
+        throw std::runtime_error("too many requests in flight for the logits processor");
+    }
+    slot->value.sample_begin.store(sample_begin, std::memory_order_release);
+    slot->value.mode.store(mode, std::memory_order_release);
+    return key;
 }
 
 void TranscribeLogitsProcessor::unregister_request(
-    const tle::IdType req_id
+    const tle::IdType client_id
 ) {
-    std::lock_guard<std::mutex> lock(mutex_); 
-    context_map_.erase(req_id);
+    contexts_.erase(client_id);
 }
 
-void TranscribeLogitsProcessor::process(
-    tle::IdType req_id,
-    tle::Tensor& tle_logits, 
-    tle::BeamTokens const& tokens,
+void TranscribeLogitsProcessor::process_batch(
+    std::vector<tle::IdType> const& req_ids,
+    std::vector<tle::Tensor>& logits,
+    std::vector<std::reference_wrapper<tle::BeamTokens const>> const& tokens,
     tle::StreamPtr const& stream_ptr,
-    const bool stop_on_timestamps
+    std::vector<std::optional<tle::IdType>> const& client_ids
 ) {
-    at::cuda::CUDAStreamGuard guard(tlr::TorchUtils::stream(*stream_ptr));
+    if (req_ids.empty()) {
+        return;
+    }
+
+    // the mock backend runs on the CPU, without a stream
+    std::optional<at::cuda::CUDAStreamGuard> guard;
+    if (stream_ptr) {
+        guard.emplace(tlr::TorchUtils::stream(*stream_ptr));
+    }
 
-    Logits logits(tle_logits);
+    std::vector<torch::Tensor> views;
+    views.reserve(logits.size());
+    for (auto& tensor : logits) {
+        views.push_back(tlr::Torch::tensor(tle::detail::toITensor(tensor)));
+    }
+
+    // every request of the executor shares one kind of logits, so the biases
+    // any registered request resolved serve the whole batch
+    const LogitBiases* biases = nullptr;
+    std::vector<BeamRule> rules;
+    for (size_t i = 0; i < req_ids.size(); i++) {
+        if (auto* resolved = append_rules(client_ids[i], views[i], tokens[i].get(), rules)) {
+            biases = resolved;
+        }
+    }
 
-    // mutex_.lock();
-    // auto sample_begin = context_map_[req_id].sample_begin;
-    // mutex_.unlock();
+    // one pass over every beam of every request, decided on the device
+    apply_batched_rules(views, rules, biases ? *biases : masks_.get(views[0]));
+}
+
+const LogitBiases* TranscribeLogitsProcessor::append_rules(
+    const std::optional<tle::IdType>& client_id,
+    const torch::Tensor& logits,
+    tle::BeamTokens const& tokens,
+    std::vector<BeamRule>& rules
+) {
+    const size_t n_beams = tokens.size();
+
+    RequestContext* context = nullptr;
+    if (auto* slot = client_id ? contexts_.find(*client_id) : nullptr) {
+        context = &slot->value;
+        if (context->initialized_for != *client_id) {
+            // the slot last held another request
+            context->initialized_for = *client_id;
+            context->state = DecodeState(context->sample_begin.load(std::memory_order_acquire));
+            context->biases = &masks_.get(logits);
+        }
+    }
+    const LogitBiases* biases = context ? context->biases : nullptr;
+    // a request without a context (enqueued without a client id) decodes as
+    // a plain transcription; language detection is a single step and told
+    // apart by its prompt either way
+    const auto mode = context ? context->mode.load(std::memory_order_acquire) : DecodeMode::TRANSCRIBE;
 
     // suppress notimestamps
     // logits.suppress_notimestamps();
@@ -235,81 +292,42 @@ void TranscribeLogitsProcessor::process(
     //    return;
     // }
 
-    if (tokens[0].back() == token::START_OF_TRANSCRIPT) {
-        logits.suppress_non_languages();
-        return;
+    if (mode == DecodeMode::DETECT || tokens[0].back() == token::START_OF_TRANSCRIPT) {
+        rules.insert(rules.end(), n_beams, BeamRule::languages_only());
+        return biases;
     }
 
     if (tokens[0].size() > 1 && tokens[0][tokens[0].size() - 2] == token::START_OF_TRANSCRIPT) {
-        logits.set_transcribe();
-        return;
+        rules.insert(rules.end(), n_beams, BeamRule::forced(token::TRANSCRIBE));
+        return biases;
     }
 
-    auto is_first_text = tokens[0][tokens[0].size() - 2] == token::TRANSCRIBE;
-
-    // suppress notimestamps
-    logits.suppress_notimestamps();
-    
-    bool check_timestamps_prob = false;
-
-    for (auto b = 0; b < tokens.size(); b++) {
-        auto beam_logits = logits.beam(b);
-        auto beam_tokens = tokens[b];
-
-        auto n_tokens = beam_tokens.size();
-        bool last_was_timestamp = token::is_timestamp(beam_tokens[n_tokens - 1]);
-        bool penultimate_was_timestamp = is_first_text || token::is_timestamp(beam_tokens[n_tokens - 2]);        
-        //bool last_was_timestamp = n_tokens > sample_begin &&
-        //    token::is_timestamp(beam_tokens[n_tokens - 1]);
-        //bool penultimate_was_timestamp = n_tokens < sample_begin + 2 ||
-        //    n_tokens > sample_begin + 1 && token::is_timestamp(beam_tokens[n_tokens - 2]);
-
-        if (last_was_timestamp) {
-            if (penultimate_was_timestamp) {
-                beam_logits.suppress_timestamps();
-            } else {
-                if (stop_on_timestamps) {
-                    beam_logits.set_eot();
-                    return;
-                }
-                beam_logits.suppress_text();
-                beam_logits.suppress_timestamps(beam_tokens[n_tokens - 1]);
-                check_timestamps_prob = true;
-                // beam_logits.suppress_non_eot();
-            }
-        } else {
-            // for (auto i = n_tokens - 1; i >= sample_begin; i--) {
-            for (auto i = n_tokens - 1; beam_tokens[i] != token::TRANSCRIBE; i--) {
-                auto token = beam_tokens[i];
-                if (token::is_timestamp(token)) {
-                    beam_logits.suppress_timestamps(token + 1);
-                    break;
-                }
-            }
-            check_timestamps_prob = true;
-        }
+    const bool stop_on_timestamps = mode == DecodeMode::TRANSCRIBE_SEGMENT;
+    if (recorder_) {
+        recorder_->record(logits, tokens, stop_on_timestamps);
     }
 
-    if (check_timestamps_prob) {
-        auto logprobs = logits.logprobs();
-        for (auto b = 0; b < tokens.size(); b++) {
-            auto beam_logprobs = logprobs.beam(b);
-            auto timestamps_logprob = beam_logprobs.timestamps().logsumexp();
+    if (context == nullptr) {
+        // not registered: scan the beams instead
+        const TimestampRules step(tokens, stop_on_timestamps);
+        rules.insert(rules.end(), step.beams().begin(), step.beams().end());
+        return biases;
+    }
 
-            auto max_text_logprob = beam_logprobs.non_timestamps().max();
+    context->state.advance(tokens);
 
-            if (timestamps_logprob > max_text_logprob) {
-                logits.beam(b).suppress_non_timestamps();
-                //std::cout << tokens[b] << std::endl;
-            }
-        }
-    }
+    const TimestampRules step(context->state, stop_on_timestamps);
+    rules.insert(rules.end(), step.beams().begin(), step.beams().end());
+    return biases;
 }
 
 std::unique_ptr<Whisper> whisper(const rust::Str model_path, const Config& config) {
     auto path = std::filesystem::path(static_cast<std::string>(model_path));
-    return std::make_unique<Whisper>(
-        path,
-        config
-    );
+    std::unique_ptr<LogitsRecorder> recorder;
+    if (!config.record_logits.empty()) {
+        recorder = std::make_unique<LogitsRecorder>(static_cast<std::string>(config.record_logits));
+    }
+    return std::make_unique<Whisper>([&](tle::LogitsPostProcessorBatched process_batch) {
+        return std::make_unique<TrtllmBackend>(path, executor_config(config, std::move(process_batch)));
+    }, std::move(recorder));
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "whisper-trtllm-rs/src/sys/backend.h"
 #include "whisper-trtllm-rs/src/sys/features.h"
+#include "whisper-trtllm-rs/src/sys/registry.h"
+#include "whisper-trtllm-rs/src/sys/timestamps.h"
 
 #include "tensorrt_llm/plugins/api/tllmPlugin.h"
 #include "tensorrt_llm/executor/executor.h"
@@ -8,6 +11,7 @@
 #include "tensorrt_llm/runtime/torchView.h"
 #include "tensorrt_llm/runtime/torch.h"
 
+#include <functional>
 #include <memory>
 #include <filesystem>
 
@@ -24,69 +28,121 @@ struct TranscribeOptions;
 
 struct TranscribeResult;
 
-struct TranscribeContext {
-    std::size_t sample_begin;
-    //torch::Half prevTimestampLogprob;
+struct ExecutorResponse;
+
+// The rules a request decodes under, kept in its RequestContext.
+enum class DecodeMode : uint8_t {
+    DETECT = 0,
+    TRANSCRIBE = 1,
+    TRANSCRIBE_SEGMENT = 2,
 };
 
+// Applies the decoding rules of all requests as TensorRT-LLM's batched logits
+// post-processor, keeping a context per request from enqueue to its final
+// response. Given a recorder, it also records every timestamp-rule step,
+// which syncs on the logits, so only when capturing test data.
+//
+// The contexts live in a SlotTable keyed by a key of the processor's own,
+// which the request carries as its client id: the enqueueing thread inserts
+// before the executor can see the request, whoever takes the final response
+// erases, and the executor thread looks requests up without a lock and is
+// the only one to touch a state.
 class TranscribeLogitsProcessor {
     public:
-        void register_request(
-            const tle::IdType req_id, 
-            const std::size_t sample_begin
+        explicit TranscribeLogitsProcessor(
+            std::unique_ptr<LogitsRecorder> recorder = nullptr
+        );
+
+        // Registers a request about to be enqueued; returns the key to set
+        // as its client id. Throws when every context is taken, so the
+        // request is refused rather than decoded without its rules.
+        tle::IdType register_request(
+            const std::size_t sample_begin,
+            const DecodeMode mode
         );
 
+        // Releases the context of the client id a final response carries.
         void unregister_request(
-            const tle::IdType req_id
+            const tle::IdType client_id
         );
 
-        void process(
-            tle::IdType req_id,
-            tle::Tensor& logits, 
-            tle::BeamTokens const& tokens,
+        size_t registered() const {
+            return contexts_.size();
+        }
+
+        // Every request of a decode step at once: the rules of all their
+        // beams are gathered on the host and applied in a single
+        // apply_batched_rules() pass.
+        void process_batch(
+            std::vector<tle::IdType> const& req_ids,
+            std::vector<tle::Tensor>& logits,
+            std::vector<std::reference_wrapper<tle::BeamTokens const>> const& tokens,
             tle::StreamPtr const& stream_ptr,
-            const bool stop_on_timestamps
+            std::vector<std::optional<tle::IdType>> const& client_ids
         );
 
     private:
-        std::mutex mutex_;
-        std::unordered_map<tle::IdType, TranscribeContext> context_map_;
+        struct RequestContext {
+            // written on register, possibly while the executor reads it
+            std::atomic<size_t> sample_begin{0};
+            std::atomic<DecodeMode> mode{DecodeMode::TRANSCRIBE};
+            // the request state was last reset for; executor thread only
+            tle::IdType initialized_for = SlotTable<RequestContext>::EMPTY;
+            DecodeState state;
+            // resolved from masks_ when the state is reset; executor thread only
+            const LogitBiases* biases = nullptr;
+        };
+
+        // appends the rules of one request's beams and returns the biases
+        // its context resolved, or nullptr without a context
+        const LogitBiases* append_rules(
+            const std::optional<tle::IdType>& client_id,
+            const torch::Tensor& logits,
+            tle::BeamTokens const& tokens,
+            std::vector<BeamRule>& rules
+        );
+
+        SlotTable<RequestContext> contexts_;
+        std::atomic<tle::IdType> next_key_{SlotTable<RequestContext>::EMPTY + 1};
+        BiasMasks masks_;
+        std::unique_ptr<LogitsRecorder> recorder_;
 };
 
+// A loaded model. Enqueues from many threads run in parallel; responses are
+// drained by one dispatcher thread through await_responses().
 class Whisper {
     public:
-        Whisper(
-            std::filesystem::path const& model_path,
-            Config const& config
+        // builds the executor around the batched logits post-processor
+        using BackendFactory = std::function<std::unique_ptr<ExecutorBackend>(tle::LogitsPostProcessorBatched)>;
+
+        explicit Whisper(
+            const BackendFactory& backend,
+            std::unique_ptr<LogitsRecorder> recorder = nullptr
         );
 
         tle::IdType enqueue_detect_language_request(
             const torch::Tensor& features
-        );
+        ) const;
 
         inline tle::IdType enqueue_detect_language_request(
             const Features& features
-        ) {
+        ) const {
             return enqueue_detect_language_request(features.tensor());
         };
 
-        uint32_t await_detect_language_response(
-            tle::IdType const &request_id
-        );
-
         tle::IdType enqueue_transcribe_request(
             const torch::Tensor& features,
             const tle::VecTokens prompt,
             const TranscribeOptions &options,
             const bool stop_on_timestamps = false
-        );
+        ) const;
 
         tle::IdType enqueue_transcribe_request(
             const Features& features,
             const rust::Slice<const std::uint32_t> prompt,
             const TranscribeOptions &options,
             const bool stop_on_timestamps = false
-        ) {
+        ) const {
 
             return enqueue_transcribe_request(
                 features.tensor(),
@@ -96,17 +152,35 @@ class Whisper {
             );
         }
 
-        TranscribeResult await_transcribe_response(
-            tle::IdType const &request_id
-        );
+        // Every response that is ready, waiting up to timeout_millis for the
+        // first, for a single dispatcher thread to hand out. The decode state
+        // of a transcribe request is released with its final response.
+        rust::Vec<ExecutorResponse> await_responses(
+            const uint64_t timeout_millis
+        ) const;
 
-        bool is_response_ready(
-            tle::IdType const &request_id
+        // Stops decoding the request; its final response still comes through
+        // await_responses() and releases its context.
+        void cancel_request(
+            const tle::IdType request_id
         ) const;
 
     private:
-        tle::Executor executor_;
-        TranscribeLogitsProcessor transcribe_logits_processor_;
+        // counts the processor's contexts for the tests
+        friend size_t registered_requests(const Whisper& whisper);
+
+        // enqueues a request registered under key, unregistering it again
+        // when the backend refuses it
+        tle::IdType enqueue(
+            tle::Request& request,
+            const tle::IdType key
+        ) const;
+
+        // Every method is const and may be called from any thread: the
+        // backend is thread-safe and so is the logits processor's registry.
+        mutable TranscribeLogitsProcessor transcribe_logits_processor_;
+        // after the processor, so decoding stops before the processor goes
+        std::unique_ptr<ExecutorBackend> backend_;
 };
 
 inline bool init() {
@@ -2,16 +2,17 @@ use cxx::UniquePtr;
 
 use std::path::Path;
 use std::sync::Once;
+use std::time::Duration;
 use anyhow::{anyhow, Result};
 
 use super::features::{self, Features};
 
-pub use ffi::{Config, TranscribeOptions, TranscribeResult};
+pub use ffi::{Config, ExecutorResponse, TranscribeOptions, TranscribeResult};
 
 static INIT: Once = Once::new();
 
 #[cxx::bridge]
-mod ffi {
+pub(crate) mod ffi {
     /*
     #[derive(Copy, Clone, Debug)]
     #[repr(i32)]
@@ -21,10 +22,14 @@ mod ffi {
     }
     */
 
-    #[derive(Copy, Clone, Debug)]
+    #[derive(Clone, Debug)]
     pub struct Config {
         pub max_beam_width: u32,
         // batching_type: BatchingType,
+        /// npz file to capture every timestamp-rule step in, as test data
+        /// for the rule benchmarks; empty for none. Each step then waits
+        /// for its logits to reach the host, so leave it empty in service.
+        pub record_logits: String,
     }
 
     #[derive(Copy, Clone, Debug)]
@@ -43,6 +48,15 @@ mod ffi {
         avg_logprob: f32,
     }
 
+    /// A response of any request, as drained by the dispatcher. The result
+    /// is empty when error is set.
+    #[derive(Clone, Debug)]
+    struct ExecutorResponse {
+        request_id: u64,
+        error: String,
+        result: TranscribeResult,
+    }
+
     unsafe extern "C++" {
         type Features = super::features::ffi::Features;
 
@@ -55,32 +69,27 @@ mod ffi {
         fn whisper(model_path: &str, config: &Config) -> UniquePtr<Whisper>;
 
         fn enqueue_detect_language_request(
-            self: Pin<&mut Whisper>,
+            self: &Whisper,
             features: &Features,
         ) -> Result<u64>;
 
-        fn await_detect_language_response(
-            self: Pin<&mut Whisper>,
-            request_id: &u64,
-        ) -> Result<u32>;
-
         fn enqueue_transcribe_request(
-            self: Pin<&mut Whisper>,
+            self: &Whisper,
             features: &Features,
             prompt: &[u32],
             option: &TranscribeOptions,
             stop_on_timestamp: bool,
         ) -> Result<u64>;
 
-        fn await_transcribe_response(
-            self: Pin<&mut Whisper>,
-            request_id: &u64,
-        ) -> Result<TranscribeResult>;
+        fn await_responses(
+            self: &Whisper,
+            timeout_millis: u64,
+        ) -> Result<Vec<ExecutorResponse>>;
 
-        fn is_response_ready(
+        fn cancel_request(
             self: &Whisper,
-            request_id: &u64,
-        ) -> Result<bool>;
+            request_id: u64,
+        ) -> Result<()>;
     }
 }
 
@@ -92,6 +101,7 @@ impl Default for Config {
         Self {
             max_beam_width: 1,
             // batching_type: BatchingType::default().to_ffi(),
+            record_logits: String::new(),
         }
     }
 }
@@ -124,23 +134,24 @@ impl Whisper {
         Ok(Self { ptr })
     }
 
-    pub fn enqueue_detect_language_request(&mut self, features: &Features) -> Result<u64> {
-        self.ptr.pin_mut().enqueue_detect_language_request(features)
-            .map_err(|e| anyhow!("failed to enqueue transcribe request: {e}"))
+    /// A Whisper on the CPU mock executor; no engine or GPU needed.
+    #[cfg(test)]
+    pub fn mock(config: super::MockConfig) -> Self {
+        Self { ptr: super::testing::ffi::whisper_mock(&config) }
     }
 
-    pub fn await_detect_language_response(&mut self, request_id: &u64) -> Result<u32> {
-        self.ptr.pin_mut().await_detect_language_response(request_id)
-            .map_err(|e| anyhow!("failed to get transcribe response: {e}"))
+    pub fn enqueue_detect_language_request(&self, features: &Features) -> Result<u64> {
+        self.ptr.enqueue_detect_language_request(features)
+            .map_err(|e| anyhow!("failed to enqueue transcribe request: {e}"))
     }
 
-    pub fn enqueue_transcribe_request(&mut self, 
+    pub fn enqueue_transcribe_request(&self, 
         features: &Features,
         prompt: &[u32], 
         options: &TranscribeOptions,
         stop_on_timestamp: bool,
     ) -> Result<u64> {
-        self.ptr.pin_mut().enqueue_transcribe_request(
+        self.ptr.enqueue_transcribe_request(
             features, 
             prompt, 
             &options, 
@@ -148,14 +159,194 @@ impl Whisper {
         ).map_err(|e| anyhow!("failed to enqueue transcribe request: {e}"))
     }
 
-    pub fn await_transcribe_response(&mut self, request_id: &u64) -> Result<TranscribeResult> {
-        let result = self.ptr.pin_mut().await_transcribe_response(request_id)
-            .map_err(|e| anyhow!("failed to get transcribe response: {e}"))?;
-        Ok(result)
+    /// Every response that is ready, waiting up to timeout for the first;
+    /// empty on timeout.
+    pub fn await_responses(&self, timeout: Duration) -> Result<Vec<ExecutorResponse>> {
+        self.ptr.await_responses(timeout.as_millis() as u64)
+            .map_err(|e| anyhow!("failed to await responses: {e}"))
+    }
+
+    /// Stops decoding a request; its final response still comes through
+    /// `await_responses`.
+    pub fn cancel_request(&self, request_id: u64) -> Result<()> {
+        self.ptr.cancel_request(request_id)
+            .map_err(|e| anyhow!("failed to cancel request {request_id}: {e}"))
     }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::sys::LogMelSpectrogram;
+    use crate::sys::testing::ffi::{registered_requests, MockConfig};
+    use std::sync::Mutex;
+    use std::time::Instant;
+
+    /// Enqueues n_threads * n_requests requests from n_threads threads at
+    /// once, through a shared &Whisper or serialized behind a lock as when
+    /// every call took &mut, and drains their responses afterwards.
+    /// Returns enqueues per second.
+    fn enqueue_rate(whisper: &Whisper, features: &Features, n_threads: usize, n_requests: usize, serialized: bool) -> f64 {
+        let lock = Mutex::new(());
+
+        let start = Instant::now();
+        std::thread::scope(|scope| {
+            for _ in 0..n_threads {
+                scope.spawn(|| {
+                    for _ in 0..n_requests {
+                        let _guard = serialized.then(|| lock.lock().unwrap());
+                        whisper.enqueue_detect_language_request(features).unwrap();
+                    }
+                });
+            }
+        });
+        let elapsed = start.elapsed();
+
+        let mut remaining = n_threads * n_requests;
+        while remaining > 0 {
+            remaining -= whisper.await_responses(Duration::from_millis(100)).unwrap().iter()
+                .filter(|response| !response.error.is_empty() || response.result.is_final)
+                .count();
+        }
 
-    pub fn is_response_ready(&self, request_id: &u64) -> Result<bool> {
-        self.ptr.is_response_ready(request_id)
-            .map_err(|e| anyhow!("failed to query if response is ready: {e}"))
+        (n_threads * n_requests) as f64 / elapsed.as_secs_f64()
     }
-}
\ No newline at end of file
+
+    /// How long a test waits for the mock's responses before it fails.
+    const DRAIN_TIMEOUT: Duration = Duration::from_secs(60);
+
+    /// The final responses of n requests.
+    fn drain_final(whisper: &Whisper, n: usize) -> Vec<ExecutorResponse> {
+        let deadline = Instant::now() + DRAIN_TIMEOUT;
+        let mut responses = vec![];
+        while responses.len() < n {
+            assert!(Instant::now() < deadline, "{} of {n} responses in time", responses.len());
+            responses.extend(whisper.await_responses(Duration::from_millis(100)).unwrap().into_iter()
+                .filter(|response| !response.error.is_empty() || response.result.is_final));
+        }
+        responses
+    }
+
+    fn drain(whisper: &Whisper, n: usize) -> Vec<ExecutorResponse> {
+        let deadline = Instant::now() + DRAIN_TIMEOUT;
+        let mut responses = vec![];
+        while responses.len() < n {
+            assert!(Instant::now() < deadline, "{} of {n} responses in time", responses.len());
+            responses.extend(whisper.await_responses(Duration::from_millis(100)).unwrap());
+        }
+        responses
+    }
+
+    #[test]
+    fn test_mock_runs_the_decoding_rules() {
+        let whisper = Whisper::mock(MockConfig { encoder_micros: 0, step_micros: 0, step_micros_per_request: 0, ..Default::default() });
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+
+        let detect = whisper.enqueue_detect_language_request(&features).unwrap();
+        let transcribe = whisper.enqueue_transcribe_request(&features, &[50258], &TranscribeOptions::default(), true).unwrap();
+
+        for response in drain(&whisper, 2) {
+            assert!(response.error.is_empty(), "{}", response.error);
+            let tokens = &response.result.tokens;
+            if response.request_id == detect {
+                assert_eq!(tokens[..], [50258, 50259]);
+            } else {
+                assert_eq!(response.request_id, transcribe);
+                // language, <|transcribe|>, an opening timestamp, text and a
+                // closing timestamp
+                assert_eq!(tokens[..4], [50258, 50259, 50360, 50365]);
+                assert!(tokens[4..tokens.len() - 1].iter().all(|&token| token < 50257));
+                assert!(*tokens.last().unwrap() > 50365);
+            }
+        }
+    }
+
+    /// Requests finishing as soon as they are enqueued, from several
+    /// threads: each request's context is registered before the executor
+    /// sees it and released with its final response, so none is left over.
+    #[test]
+    fn test_mock_releases_every_context() {
+        let whisper = Whisper::mock(MockConfig { encoder_micros: 0, step_micros: 0, step_micros_per_request: 0, ..Default::default() });
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+
+        let (n_threads, n_requests) = (8, 64);
+        std::thread::scope(|scope| {
+            for thread in 0..n_threads {
+                let (whisper, features) = (&whisper, &features);
+                scope.spawn(move || {
+                    for i in 0..n_requests {
+                        if (thread + i) % 2 == 0 {
+                            whisper.enqueue_detect_language_request(features).unwrap();
+                        } else {
+                            whisper.enqueue_transcribe_request(features, &[50258], &TranscribeOptions::default(), true).unwrap();
+                        }
+                    }
+                });
+            }
+        });
+        for response in drain_final(&whisper, n_threads * n_requests) {
+            assert!(response.error.is_empty(), "{}", response.error);
+        }
+        assert_eq!(registered_requests(&whisper.ptr), 0);
+    }
+
+    #[test]
+    fn test_mock_cancels_requests() {
+        let whisper = Whisper::mock(MockConfig { max_batch_size: 1, step_micros: 20_000, ..Default::default() });
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+
+        // one decoding, one queued behind it
+        let running = whisper.enqueue_transcribe_request(&features, &[50258], &TranscribeOptions::default(), true).unwrap();
+        let queued = whisper.enqueue_transcribe_request(&features, &[50258], &TranscribeOptions::default(), true).unwrap();
+        std::thread::sleep(Duration::from_millis(50));
+        whisper.cancel_request(queued).unwrap();
+        whisper.cancel_request(running).unwrap();
+
+        let start = Instant::now();
+        for response in drain(&whisper, 2) {
+            assert!(response.result.is_final);
+            if response.request_id == queued {
+                assert_eq!(response.result.tokens[..], [50258]);
+            }
+        }
+        // well before the running one could have finished its script
+        assert!(start.elapsed() < Duration::from_millis(100));
+    }
+
+    #[test]
+    #[ignore]
+    fn bench_mock_batching() {
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cpu").unwrap();
+        let features = extractor.extract(&vec![0.0; 16000], &[]).unwrap();
+
+        for max_batch_size in [1, 8, 64] {
+            let whisper = Whisper::mock(MockConfig { max_batch_size, ..Default::default() });
+            let n = 128;
+            let start = Instant::now();
+            for _ in 0..n {
+                whisper.enqueue_transcribe_request(&features, &[50258], &TranscribeOptions::default(), true).unwrap();
+            }
+            drain(&whisper, n);
+            println!("max batch {max_batch_size}: {n} requests in {:?}", start.elapsed());
+        }
+    }
+
+    /// Needs an engine at WHISPER_MODEL.
+    #[test]
+    #[ignore]
+    fn bench_enqueue_throughput() {
+        let model_path = std::env::var("WHISPER_MODEL").expect("WHISPER_MODEL is not set");
+        let whisper = Whisper::load(&model_path, Config::default()).unwrap();
+        let extractor = LogMelSpectrogram::new(128, 400, 160, "cuda").unwrap();
+        let features = extractor.extract(&vec![0.0; 30 * 16000], &[]).unwrap();
+
+        for n_threads in [1, 2, 4, 8, 16] {
+            let serialized = enqueue_rate(&whisper, &features, n_threads, 64, true);
+            let parallel = enqueue_rate(&whisper, &features, n_threads, 64, false);
+            println!("{n_threads} threads: serialized {serialized:.0}/s, parallel {parallel:.0}/s enqueues");
+        }
+    }
+}
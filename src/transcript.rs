@@ -1,5 +1,4 @@
 use serde::Serialize;
-use super::tokenizer::Tokenizer;
 
 /*
 pub struct SegmentIterator<'a> {
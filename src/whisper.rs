@@ -5,26 +5,28 @@ use crate::sys::TranscribeResult;
 use super::tokenizer::Tokenizer;
 use super::sys::{self};
 use super::model::Model;
+use super::admission::{AdmissionConfig, Priority, Scheduling};
 use tokio::sync::Mutex;
 //use super::audio::Audio;
 use tokio::io::AsyncRead;
 use tokio::time::{sleep, Duration};
+use std::time::Instant;
 //use super::transcript::{Transcript, Segment};
 use futures::stream::{Stream, StreamExt};
-use super::features::Audio;
+use super::features::{ChannelFeatures, FeatureBuffer};
 use super::sys::LogMelSpectrogram;
-//use super::transcript::{Segment};
-use async_stream::stream;
+use super::transcript::Segment;
+use async_stream::{stream, try_stream};
 
 pub use sys::Config;
 
-const MEL_FILTER_FILENAME: &str = "mel_filters.npz";
 const TOKENIZER_FILENAME: &str = "tokenizer.json";
 
 pub struct Whisper {
     extractor: LogMelSpectrogram,
     tokenizer: Tokenizer,
     model: Model,
+    request_timeout: Option<Duration>,
 }
 
 impl Whisper {
@@ -32,38 +34,74 @@ impl Whisper {
     const N_MEL: usize = 128;
     const N_FFT: usize = 400;
     const HOP_LENGTH: usize = 160;
+    const DEVICE: &'static str = "cuda";
 
     const DELTA: usize = 100;
 
+    /// Loads the model with every request going straight to the executor;
+    /// `load_with_admission` puts limits in front of it.
     pub fn load<T: AsRef<Path>>(model_path: T, config: Config) -> Result<Self> {
-        let extractor = LogMelSpectrogram::open(
-            model_path.as_ref().join(MEL_FILTER_FILENAME),
+        Self::load_with_admission(model_path, config, AdmissionConfig::unlimited())
+    }
+
+    /// Loads the model behind an admission queue with the given limits and
+    /// tenant weights.
+    pub fn load_with_admission<T: AsRef<Path>>(model_path: T, config: Config, admission: AdmissionConfig) -> Result<Self> {
+        let extractor = LogMelSpectrogram::new(
             Self::N_MEL,
             Self::N_FFT,
             Self::HOP_LENGTH,
+            Self::DEVICE,
         )?;
 
         let tokenizer = Tokenizer::from_file(model_path.as_ref().join(TOKENIZER_FILENAME))?;
 
-        let model = Model::load(&model_path, config)?;
+        let model = Model::load(&model_path, config, admission)?;
 
         Ok(Self { 
             extractor,
             tokenizer,
             model,
+            request_timeout: None,
         })
     }
 
+    /// Cancels and fails any request still decoding this long after it was
+    /// enqueued, freeing the executor for live callers. No limit by default.
+    pub fn set_request_timeout(&mut self, timeout: Option<Duration>) {
+        self.request_timeout = timeout;
+    }
+
+    // the timeout also bounds the wait for admission
+    fn scheduling(&self, priority: Priority, tenant: &str) -> Scheduling {
+        Scheduling {
+            priority,
+            tenant: tenant.to_string(),
+            deadline: self.request_timeout.map(|timeout| Instant::now() + timeout),
+        }
+    }
+
     pub async fn detect_language<S>(&self, stream: S) -> Result<String> 
     where 
         S: Stream<Item = Vec<f32>> + Unpin,
     {
-        let mut audio = Audio::new(&self.extractor, stream);
+        self.detect_language_for(stream, Priority::Interactive, "").await
+    }
+
+    /// Detects the language with the given priority, sharing its class with
+    /// other tenants by their weights.
+    pub async fn detect_language_for<S>(&self, stream: S, priority: Priority, tenant: &str) -> Result<String>
+    where
+        S: Stream<Item = Vec<f32>> + Unpin,
+    {
+        let mut audio = FeatureBuffer::new(&self.extractor, stream)?;
+        audio.skip_non_speech().await?;
 
-        let features = audio.features(Self::CHUNK_SIZE).await?
+        let features = audio.encoder_input().await?
             .ok_or_else(|| anyhow!("No audio data"))?;
 
-        let language_token = self.model.detect_language(&features).await?;
+        let scheduling = self.scheduling(priority, tenant);
+        let language_token = self.model.detect_language(&features, &scheduling).await?;
 
         let language = self.tokenizer.language(language_token)?;
         Ok(language)
@@ -119,6 +157,101 @@ impl Whisper {
     }
     */
 
+    /// Transcribes an interleaved multi-channel stream, e.g. the agent and
+    /// customer sides of a stereo call, as one job. Each round takes the
+    /// next window of every channel that still has speech and decodes them
+    /// as sibling requests. Segments come out channel-tagged, in start order
+    /// within a round, with times in millis from the start of the stream.
+    pub fn transcribe_channels<'a, S>(&'a self,
+        stream: S,
+        channels: usize,
+    ) -> impl Stream<Item = Result<(usize, String, Segment)>> + 'a
+    where
+        S: Stream<Item = Vec<f32>> + Unpin + 'a,
+    {
+        self.transcribe_channels_for(stream, channels, Priority::Interactive, "")
+    }
+
+    /// Like `transcribe_channels`, with every window admitted at the given
+    /// priority and counted against the tenant's share of its class.
+    pub fn transcribe_channels_for<'a, S>(&'a self,
+        stream: S,
+        channels: usize,
+        priority: Priority,
+        tenant: &'a str,
+    ) -> impl Stream<Item = Result<(usize, String, Segment)>> + 'a
+    where
+        S: Stream<Item = Vec<f32>> + Unpin + 'a,
+    {
+        try_stream! {
+            let mut audio = ChannelFeatures::new(&self.extractor, channels, stream)?;
+            let input = vec![self.tokenizer.start_of_transcript()];
+            let mut done = vec![false; channels];
+
+            loop {
+                let mut siblings = vec![];
+                let mut windows = vec![];
+                for channel in 0..channels {
+                    if done[channel] {
+                        continue;
+                    }
+                    audio.skip_non_speech(channel).await?;
+                    match audio.encoder_input(channel).await? {
+                        Some(features) => {
+                            siblings.push(channel);
+                            windows.push(features);
+                        }
+                        None => done[channel] = true,
+                    }
+                }
+                if windows.is_empty() {
+                    break;
+                }
+
+                let scheduling = self.scheduling(priority, tenant);
+                let results = self.model.transcribe_segments(windows, &input, &scheduling).await?;
+
+                let mut segments = vec![];
+                for (channel, tokens) in siblings.into_iter().zip(results) {
+                    let offset = audio.offset(channel);
+                    let (segment, consumed) = self.parse_segment(&tokens, input.len(), offset)?;
+                    audio.consume_millis(channel, consumed)?;
+                    if let Some((language, segment)) = segment {
+                        segments.push((channel, language, segment));
+                    }
+                }
+
+                segments.sort_by_key(|(channel, _, segment)| (segment.start(), *channel));
+                for segment in segments {
+                    yield segment;
+                }
+            }
+        }
+    }
+
+    // Reads <|lang|><|transcribe|><|start|> text [<|end|>] after the prompt.
+    // Returns the segment, if any, and the millis of audio it accounts for.
+    fn parse_segment(&self, tokens: &[u32], prompt: usize, offset: usize) -> Result<(Option<(String, Segment)>, usize)> {
+        const WINDOW_MILLIS: usize = 30000;
+
+        if tokens.len() <= prompt + 2 {
+            return Ok((None, WINDOW_MILLIS));
+        }
+        let language = self.tokenizer.language(tokens[prompt])?;
+        let start = self.tokenizer.timestamp_to_millis(tokens[prompt + 2]).unwrap_or(0);
+
+        let last = tokens.len() - 1;
+        let (end, text) = match self.tokenizer.timestamp_to_millis(tokens[last]) {
+            Some(millis) if last > prompt + 2 && millis > start => {
+                (millis, self.tokenizer.decode(&tokens[prompt + 3..last], false)?)
+            }
+            _ => (WINDOW_MILLIS, self.tokenizer.decode(&tokens[prompt + 3..], false)?),
+        };
+
+        let segment = Segment::new(offset + start, offset + end, text);
+        Ok((Some((language, segment)), end))
+    }
+
     pub fn log_mel(&self) {
         let first = vec![0.0; 30 * 16000 + 1];
         let second = vec![0.0; 30 * 16000];